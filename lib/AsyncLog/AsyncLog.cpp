@@ -0,0 +1,237 @@
+#include "AsyncLog.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+namespace {
+
+// Matched as a key suffix, so "wifi_pass" and "mqttPassword" are caught
+// but "passed" is not.
+const char *const kSecretKeys[] = {"pass", "password", "passwd", "psk", "token", "secret"};
+
+bool keyIsSecret(const char *key, size_t len) {
+    for (const char *secret : kSecretKeys) {
+        size_t n = strlen(secret);
+        if (n <= len && strncasecmp(key + len - n, secret, n) == 0) return true;
+    }
+    return false;
+}
+
+bool isKeyChar(char c) { return isalnum((unsigned char)c) || c == '_' || c == '-'; }
+
+} // namespace
+
+size_t redactSecrets(char *text, size_t len) {
+    size_t masked = 0;
+    size_t i = 0;
+    while (i < len) {
+        if (!isKeyChar(text[i])) {
+            i++;
+            continue;
+        }
+        size_t keyStart = i;
+        while (i < len && isKeyChar(text[i])) i++;
+        size_t keyLen = i - keyStart;
+        // key, optional closing quote, spaces, then ':' or '='
+        size_t j = i;
+        if (j < len && text[j] == '"') j++;
+        while (j < len && text[j] == ' ') j++;
+        if (j >= len || (text[j] != ':' && text[j] != '=')) continue;
+        j++;
+        while (j < len && text[j] == ' ') j++;
+        if (!keyIsSecret(text + keyStart, keyLen)) continue;
+        bool quoted = j < len && text[j] == '"';
+        if (quoted) j++;
+        while (j < len) {
+            char c = text[j];
+            if (quoted ? c == '"' : (c == ',' || c == '}' || c == '&' || c == ' ' || c == '\n')) break;
+            text[j++] = '*';
+            masked++;
+        }
+        i = j;
+    }
+    return masked;
+}
+
+AsyncLog &AsyncLog::instance() {
+    static AsyncLog log;
+    return log;
+}
+
+void AsyncLog::begin(Sink sink, Clock clock, Wake wake) {
+    sink_ = sink;
+    clock_ = clock;
+    wake_ = wake;
+}
+
+bool AsyncLog::reserve(size_t len, uint32_t &at) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t used = head - tail_.load(std::memory_order_acquire);
+    if (len > kRingBytes - used) {
+        dropped_++; // never block the caller
+        return false;
+    }
+    if (used + len > highWater_) highWater_ = used + len;
+    at = head;
+    return true;
+}
+
+void AsyncLog::commit(uint32_t end) {
+    head_.store(end, std::memory_order_release);
+    written_++;
+    if (wake_) wake_();
+}
+
+void AsyncLog::put(uint32_t &at, const void *src, size_t n) {
+    const uint8_t *p = (const uint8_t *)src;
+    for (size_t i = 0; i < n; i++) {
+        ring_[(at + i) & (kRingBytes - 1)] = p[i];
+    }
+    at += n;
+}
+
+void AsyncLog::putTagged(uint32_t &at, ArgType type, const void *src, size_t n) {
+    uint8_t tag = type;
+    put(at, &tag, 1);
+    put(at, src, n);
+}
+
+void AsyncLog::encodeArg(uint32_t &at, const char *s) {
+    char copy[kMaxString];
+    uint8_t n;
+    if (s) {
+        n = (uint8_t)strnlen(s, kMaxString);
+        memcpy(copy, s, n);
+        redactSecrets(copy, n);
+    } else {
+        n = 6;
+        memcpy(copy, "(null)", n);
+    }
+    putTagged(at, kString, &n, 1);
+    put(at, copy, n);
+}
+
+void AsyncLog::print(const char *text) {
+    char copy[kMaxText];
+    const uint8_t n = (uint8_t)strnlen(text, kMaxText);
+    const size_t len = sizeof(Header) + 2 + n;
+    uint32_t at;
+    if (!reserve(len, at)) return;
+    memcpy(copy, text, n);
+    redactSecrets(copy, n);
+    Header h = {(uint16_t)len, ASYNC_LOG_NONE, 1, clock_ ? clock_() : 0, "%s"};
+    put(at, &h, sizeof(h));
+    putTagged(at, kString, &n, 1);
+    put(at, copy, n);
+    commit(at);
+}
+
+void AsyncLog::get(uint32_t &at, void *dst, size_t n) const {
+    uint8_t *p = (uint8_t *)dst;
+    for (size_t i = 0; i < n; i++) {
+        p[i] = ring_[(at + i) & (kRingBytes - 1)];
+    }
+    at += n;
+}
+
+// Minimal printf: each conversion in the format is re-run through snprintf
+// with the stored argument, widened to long long / double as tagged.
+size_t AsyncLog::format(uint32_t at, const Header &h, char *out, size_t cap) const {
+    static const char kLevels[] = "?EWID";
+    int n = 0;
+    if (h.level != ASYNC_LOG_NONE) { // console output goes out bare
+        n = snprintf(out, cap, "[%6lu.%03lu] %c ", (unsigned long)(h.ms / 1000), (unsigned long)(h.ms % 1000),
+                     kLevels[h.level < 5 ? h.level : 0]);
+    }
+    size_t len = n > 0 ? (size_t)n : 0;
+    uint8_t argsLeft = h.nargs;
+
+    for (const char *f = h.fmt; *f && len + 1 < cap; f++) {
+        if (*f != '%') {
+            out[len++] = *f;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[len++] = '%';
+            f++;
+            continue;
+        }
+        // Copy flags/width/precision, drop length modifiers.
+        char spec[16] = "%";
+        size_t s = 1;
+        const char *p = f + 1;
+        while (*p && strchr("-+ #0123456789.", *p) && s < sizeof(spec) - 4) spec[s++] = *p++;
+        while (*p && strchr("hlLqjzt", *p)) p++;
+        char conv = *p;
+        if (!conv) break;
+        f = p;
+        if (argsLeft == 0) continue;
+        argsLeft--;
+
+        uint8_t tag;
+        get(at, &tag, 1);
+        char str[kMaxText + 1]; // print() text is the longest string
+        long long i64 = 0;
+        unsigned long long u64 = 0;
+        double d = 0;
+        switch (tag) {
+        case kInt: { int32_t v; get(at, &v, 4); i64 = v; u64 = (uint32_t)v; d = v; break; }
+        case kUInt: { uint32_t v; get(at, &v, 4); i64 = v; u64 = v; d = v; break; }
+        case kInt64: get(at, &i64, 8); u64 = i64; d = (double)i64; break;
+        case kUInt64: get(at, &u64, 8); i64 = u64; d = (double)u64; break;
+        case kDouble: get(at, &d, 8); i64 = (long long)d; u64 = (unsigned long long)d; break;
+        case kString: { uint8_t sl; get(at, &sl, 1); get(at, str, sl); str[sl] = '\0'; break; }
+        case kSecret: strcpy(str, "***"); break;
+        }
+
+        const bool isText = tag == kString || tag == kSecret;
+        if (isText) {
+            spec[s++] = 's';
+            spec[s] = '\0';
+            n = snprintf(out + len, cap - len, spec, str);
+        } else if (strchr("diouxXc", conv)) {
+            if (conv == 'c') {
+                spec[s++] = 'c';
+                spec[s] = '\0';
+                n = snprintf(out + len, cap - len, spec, (int)i64);
+            } else {
+                spec[s++] = 'l';
+                spec[s++] = 'l';
+                spec[s++] = conv;
+                spec[s] = '\0';
+                n = (conv == 'd' || conv == 'i') ? snprintf(out + len, cap - len, spec, i64)
+                                                 : snprintf(out + len, cap - len, spec, u64);
+            }
+        } else if (strchr("fFeEgGaA", conv)) {
+            spec[s++] = conv;
+            spec[s] = '\0';
+            n = snprintf(out + len, cap - len, spec, d);
+        } else {
+            n = snprintf(out + len, cap - len, "%lld", i64);
+        }
+        if (n > 0) len += (size_t)n < cap - len ? (size_t)n : cap - len - 1;
+    }
+
+    // Lines are newline-terminated even if the format didn't ask for it.
+    if (len + 1 >= cap) len = cap - 2;
+    if (len == 0 || out[len - 1] != '\n') out[len++] = '\n';
+    out[len] = '\0';
+    return len;
+}
+
+size_t AsyncLog::drain(size_t maxRecords) {
+    size_t done = 0;
+    char line[kMaxLine];
+    while (done < maxRecords) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) break;
+        uint32_t at = tail;
+        Header h;
+        get(at, &h, sizeof(h));
+        size_t len = format(at, h, line, sizeof(line));
+        tail_.store(tail + h.len, std::memory_order_release);
+        if (sink_) sink_(line, len);
+        done++;
+    }
+    return done;
+}
@@ -0,0 +1,165 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Leveled logger with deferred formatting. A call site only copies its
+// format pointer and type-tagged arguments into a lock-free ring; turning
+// them into text and writing them to the UART happens later on a
+// low-priority task via drain(). Strings are copied (truncated to
+// kMaxString) because the caller's buffer is gone by then.
+//
+// Single producer: log only from the Arduino loop task.
+//
+// Levels above ASYNC_LOG_LEVEL compile to nothing, arguments included.
+#define ASYNC_LOG_NONE 0
+#define ASYNC_LOG_ERROR 1
+#define ASYNC_LOG_WARN 2
+#define ASYNC_LOG_INFO 3
+#define ASYNC_LOG_DEBUG 4
+
+#ifndef ASYNC_LOG_LEVEL
+#define ASYNC_LOG_LEVEL ASYNC_LOG_INFO
+#endif
+
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_ERROR
+#define LOGE(...) AsyncLog::instance().write(ASYNC_LOG_ERROR, __VA_ARGS__)
+#else
+#define LOGE(...) do {} while (0)
+#endif
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_WARN
+#define LOGW(...) AsyncLog::instance().write(ASYNC_LOG_WARN, __VA_ARGS__)
+#else
+#define LOGW(...) do {} while (0)
+#endif
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_INFO
+#define LOGI(...) AsyncLog::instance().write(ASYNC_LOG_INFO, __VA_ARGS__)
+#else
+#define LOGI(...) do {} while (0)
+#endif
+#if ASYNC_LOG_LEVEL >= ASYNC_LOG_DEBUG
+#define LOGD(...) AsyncLog::instance().write(ASYNC_LOG_DEBUG, __VA_ARGS__)
+#else
+#define LOGD(...) do {} while (0)
+#endif
+
+// Console output (dumps, bench results) shares the ring so it doesn't
+// interleave with log records. It is printed without the time/level prefix
+// and never compiled out.
+#define LOGP(...) AsyncLog::instance().write(ASYNC_LOG_NONE, __VA_ARGS__)
+
+// Wrap an argument that must never reach the log; it prints as "***".
+struct LogSecret {
+    const char *value;
+};
+
+// Mask the values of *pass/*password/*psk/*token/*secret keys in JSON or key=value
+// text, in place. Returns the number of characters masked.
+size_t redactSecrets(char *text, size_t len);
+
+class AsyncLog {
+public:
+    typedef void (*Sink)(const char *text, size_t len);
+    typedef void (*Wake)();
+    typedef uint32_t (*Clock)();
+
+    static constexpr size_t kRingBytes = 4096; // power of two
+    static constexpr size_t kMaxString = 96;
+    static constexpr size_t kMaxLine = 256;
+    static constexpr size_t kMaxText = 240; // print(); fits the 1-byte length
+
+    static AsyncLog &instance();
+
+    // sink receives formatted lines; wake (optional) is called after each
+    // record so the drain task can sleep until there is work.
+    void begin(Sink sink, Clock clock, Wake wake = nullptr);
+
+    template <typename... Args>
+    void write(uint8_t level, const char *fmt, const Args &...args) {
+        const size_t len = sizeof(Header) + encodedSize(args...);
+        uint32_t at;
+        if (!reserve(len, at)) return;
+        Header h = {(uint16_t)len, level, (uint8_t)sizeof...(Args), clock_ ? clock_() : 0, fmt};
+        put(at, &h, sizeof(h));
+        encode(at, args...);
+        commit(at);
+    }
+
+    // Queue an already formatted console line (LOGP level), e.g. one built
+    // piece by piece. Copied up to kMaxText and redacted like a string.
+    void print(const char *text);
+
+    // Format and emit up to maxRecords queued records. Consumer side only.
+    size_t drain(size_t maxRecords = SIZE_MAX);
+
+    uint32_t written() const { return written_; }
+    uint32_t dropped() const { return dropped_; }
+    uint32_t highWater() const { return highWater_; }
+
+private:
+    enum ArgType : uint8_t { kInt, kUInt, kInt64, kUInt64, kDouble, kString, kSecret };
+
+    struct Header {
+        uint16_t len;
+        uint8_t level;
+        uint8_t nargs;
+        uint32_t ms;
+        const char *fmt;
+    };
+
+    // Encoded sizes: 1 tag byte plus the value.
+    static size_t argSize(int) { return 1 + 4; }
+    static size_t argSize(long) { return 1 + 4; }
+    static size_t argSize(unsigned) { return 1 + 4; }
+    static size_t argSize(unsigned long) { return 1 + 4; }
+    static size_t argSize(long long) { return 1 + 8; }
+    static size_t argSize(unsigned long long) { return 1 + 8; }
+    static size_t argSize(double) { return 1 + 8; }
+    static size_t argSize(const char *s) { return 1 + 1 + (s ? strnlen(s, kMaxString) : 6); }
+    static size_t argSize(const LogSecret &) { return 1; }
+
+    static size_t encodedSize() { return 0; }
+    template <typename T, typename... Rest>
+    static size_t encodedSize(const T &first, const Rest &...rest) {
+        return argSize(first) + encodedSize(rest...);
+    }
+
+    void encodeArg(uint32_t &at, int v) { putTagged(at, kInt, &v, 4); }
+    void encodeArg(uint32_t &at, long v) { int32_t x = (int32_t)v; putTagged(at, kInt, &x, 4); }
+    void encodeArg(uint32_t &at, unsigned v) { putTagged(at, kUInt, &v, 4); }
+    void encodeArg(uint32_t &at, unsigned long v) { uint32_t x = (uint32_t)v; putTagged(at, kUInt, &x, 4); }
+    void encodeArg(uint32_t &at, long long v) { putTagged(at, kInt64, &v, 8); }
+    void encodeArg(uint32_t &at, unsigned long long v) { putTagged(at, kUInt64, &v, 8); }
+    void encodeArg(uint32_t &at, double v) { putTagged(at, kDouble, &v, 8); }
+    void encodeArg(uint32_t &at, const char *s);
+    void encodeArg(uint32_t &at, const LogSecret &) { putTagged(at, kSecret, nullptr, 0); }
+
+    void encode(uint32_t &) {}
+    template <typename T, typename... Rest>
+    void encode(uint32_t &at, const T &first, const Rest &...rest) {
+        encodeArg(at, first);
+        encode(at, rest...);
+    }
+
+    bool reserve(size_t len, uint32_t &at);
+    void commit(uint32_t end);
+    void put(uint32_t &at, const void *src, size_t n);
+    void putTagged(uint32_t &at, ArgType type, const void *src, size_t n);
+    void get(uint32_t &at, void *dst, size_t n) const;
+    size_t format(uint32_t at, const Header &h, char *out, size_t cap) const;
+
+    uint8_t ring_[kRingBytes];
+    std::atomic<uint32_t> head_{0}; // producer: next free byte
+    std::atomic<uint32_t> tail_{0}; // consumer: next unread byte
+    Sink sink_ = nullptr;
+    Clock clock_ = nullptr;
+    Wake wake_ = nullptr;
+    uint32_t written_ = 0;
+    uint32_t dropped_ = 0;
+    uint32_t highWater_ = 0;
+};
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,200 @@
+#include "AudioEngine.h"
+
+#include <math.h>
+#include <string.h>
+
+AudioEngine::AudioEngine(Play play, void *ctx, uint32_t outputRate)
+    : play_(play), ctx_(ctx), outputRate_(outputRate) {}
+
+void AudioEngine::clearTheme() {
+    eventCount_ = 0;
+    poolUsed_ = 0;
+    cycleCount_ = 0;
+    queued_ = 0;
+    current_ = -1;
+    sounding_ = -1;
+}
+
+bool AudioEngine::waveFromName(const char *name, Wave &wave) {
+    static const struct {
+        const char *name;
+        Wave wave;
+    } kWaves[] = {{"square", kSquare}, {"sine", kSine}, {"triangle", kTriangle}};
+    for (const auto &w : kWaves) {
+        if (strcmp(name, w.name) == 0) {
+            wave = w.wave;
+            return true;
+        }
+    }
+    return false;
+}
+
+int8_t AudioEngine::find(const char *name) const {
+    for (uint8_t i = 0; i < eventCount_; i++) {
+        if (strcmp(events_[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// One period of `wave` in len samples, from the pool or an earlier note.
+const int8_t *AudioEngine::render(Wave wave, uint8_t volume, uint16_t len) {
+    for (uint8_t i = 0; i < cycleCount_; i++) {
+        const Cycle &c = cycles_[i];
+        if (c.wave == wave && c.volume == volume && c.len == len) return c.data;
+    }
+    if (cycleCount_ == kMaxEvents * kMaxNotes || poolUsed_ + len > kPoolBytes) return nullptr;
+    int8_t *out = pool_ + poolUsed_;
+    const float amp = 127.0f * volume / 255.0f;
+    for (uint16_t i = 0; i < len; i++) {
+        const float phase = (float)i / len; // 0..1
+        float v;
+        switch (wave) {
+        case kSine: v = sinf(6.2831853f * phase); break;
+        case kTriangle: v = phase < 0.5f ? 4.0f * phase - 1.0f : 3.0f - 4.0f * phase; break;
+        default: v = i < len / 2 ? 1.0f : -1.0f; break;
+        }
+        out[i] = (int8_t)lrintf(v * amp);
+    }
+    poolUsed_ += len;
+    cycles_[cycleCount_++] = {out, len, wave, volume};
+    return out;
+}
+
+bool AudioEngine::addEvent(const char *name, uint8_t priority, Wave wave, uint8_t volume, const Note *notes,
+                           uint8_t count) {
+    if (!count || count > kMaxNotes || eventCount_ == kMaxEvents || strlen(name) > kMaxName) return false;
+    if (find(name) >= 0) return false;
+    const size_t poolMark = poolUsed_;
+    const uint8_t cycleMark = cycleCount_;
+    Event &e = events_[eventCount_];
+    for (uint8_t i = 0; i < count; i++) {
+        const Note &n = notes[i];
+        Tone &t = e.tones[i];
+        if (!n.ms) {
+            poolUsed_ = poolMark; // cycles rendered for earlier notes
+            cycleCount_ = cycleMark;
+            return false;
+        }
+        if (!n.hz) {
+            t = {rest_, (uint16_t)sizeof(rest_), outputRate_, 0, 0, true};
+            t.repeat = (uint32_t)((uint64_t)outputRate_ * n.ms / 1000 / sizeof(rest_));
+            if (!t.repeat) t.repeat = 1;
+            t.us = (uint32_t)((uint64_t)t.repeat * sizeof(rest_) * 1000000 / outputRate_);
+            continue;
+        }
+        uint32_t len = (outputRate_ + n.hz / 2) / n.hz;
+        if (len < 2) len = 2;
+        if (len > kMaxCycle) len = kMaxCycle;
+        t.cycle = render(wave, volume, (uint16_t)len);
+        if (!t.cycle) {
+            poolUsed_ = poolMark; // leave the pool as it was
+            cycleCount_ = cycleMark;
+            return false;
+        }
+        t.len = (uint16_t)len;
+        t.rate = n.hz * len;
+        t.repeat = ((uint32_t)n.hz * n.ms + 500) / 1000;
+        if (!t.repeat) t.repeat = 1;
+        t.us = (uint32_t)((uint64_t)t.repeat * 1000000 / n.hz);
+        t.rest = false;
+    }
+    strcpy(e.name, name);
+    e.priority = priority;
+    e.count = count;
+    eventCount_++;
+    return true;
+}
+
+void AudioEngine::start(int8_t event, bool stopCurrent) {
+    current_ = event;
+    next_ = 0;
+    stopNext_ = stopCurrent;
+    retryUs_ = 0;
+    started_++;
+}
+
+// Hand the current event's next note to the player.
+bool AudioEngine::submit(uint64_t nowUs) {
+    const Event &e = events_[current_];
+    const Tone &t = e.tones[next_];
+    if (!play_(ctx_, t.cycle, t.len, t.rate, t.repeat, stopNext_)) {
+        retryUs_ = nowUs + kRetryMs * 1000;
+        return false;
+    }
+    if (stopNext_ || endUs_ < nowUs) endUs_ = nowUs; // starts now
+    prevEndUs_ = stopNext_ ? nowUs : endUs_;
+    endUs_ += t.us;
+    stopNext_ = false;
+    sounding_ = current_;
+    if (!t.rest) audibleUs_ += t.us;
+    if (++next_ == e.count) current_ = -1;
+    return true;
+}
+
+bool AudioEngine::enqueue(int8_t event) {
+    const uint8_t priority = events_[event].priority;
+    if (queued_ == kMaxQueued) {
+        // Full: the newcomer displaces the last (lowest) entry if it outranks it.
+        if (events_[queue_[queued_ - 1]].priority >= priority) return false;
+        queued_--;
+        dropped_++;
+    }
+    uint8_t at = queued_;
+    while (at > 0 && events_[queue_[at - 1]].priority < priority) {
+        queue_[at] = queue_[at - 1];
+        at--;
+    }
+    queue_[at] = event;
+    queued_++;
+    return true;
+}
+
+bool AudioEngine::post(const char *name, uint64_t nowUs) {
+    posted_++;
+    const int8_t e = find(name);
+    if (e < 0) return false;
+    const bool audible = current_ >= 0 || nowUs < endUs_;
+    const int8_t playing = current_ >= 0 ? current_ : sounding_;
+
+    if (audible && events_[e].priority > events_[playing].priority) {
+        preempted_++;
+        start(e, true);
+    } else if (!audible && !queued_) {
+        start(e, false);
+    } else {
+        bool waiting = audible && playing == e;
+        for (uint8_t i = 0; i < queued_ && !waiting; i++) waiting = queue_[i] == e;
+        if (waiting) {
+            coalesced_++;
+            return true;
+        }
+        if (!enqueue(e)) {
+            dropped_++;
+            return false;
+        }
+    }
+    service(nowUs);
+    return true;
+}
+
+void AudioEngine::service(uint64_t nowUs) {
+    for (;;) {
+        if (current_ < 0) {
+            if (!queued_) return;
+            const int8_t e = queue_[0];
+            memmove(queue_, queue_ + 1, --queued_);
+            start(e, false);
+        }
+        // The player holds two notes: wait for the first to finish, unless
+        // this one replaces them.
+        if (nowUs < retryUs_ || (!stopNext_ && nowUs < prevEndUs_)) return;
+        if (!submit(nowUs)) return;
+    }
+}
+
+uint32_t AudioEngine::msUntilNext(uint64_t nowUs) const {
+    if (current_ < 0 && !queued_) return kIdle;
+    const uint64_t ready = stopNext_ ? 0 : prevEndUs_;
+    const uint64_t due = retryUs_ > ready ? retryUs_ : ready;
+    return due > nowUs ? (uint32_t)((due - nowUs + 999) / 1000) : 0;
+}
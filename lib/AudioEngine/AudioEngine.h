@@ -0,0 +1,139 @@
+#ifndef AUDIO_ENGINE_H
+#define AUDIO_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sequenced alert sounds from precomputed wavetables, fed to a DMA player a
+// note at a time.
+//
+// A theme maps event names ("success", "failure", "firing", ...) to a short
+// note sequence, a waveform, a volume and a priority. Adding an event
+// renders one period of each of its notes into a fixed pool: len samples,
+// len = outputRate / hz rounded, played back at hz * len samples/s so the
+// pitch is exact. A note is then that one cycle played `repeat` times, with
+// no synthesis and nothing allocated at play time. Identical periods are
+// shared between notes and events.
+//
+// post() only queues; it never waits for audio. The engine keeps at most
+// two notes with the player (one sounding, one queued behind it, the depth
+// of an M5 Speaker channel), and service() hands over the next note when
+// the earlier one has finished. A higher-priority event cuts off the one
+// playing; others wait in a small priority queue. Repeats of an event that
+// is already playing or waiting are folded into it, so a burst of messages
+// plays one sound, not twenty.
+class AudioEngine {
+public:
+    static constexpr uint8_t kMaxEvents = 12;
+    static constexpr uint8_t kMaxNotes = 8;
+    static constexpr uint8_t kMaxQueued = 4;
+    static constexpr uint8_t kMaxName = 15;
+    static constexpr size_t kPoolBytes = 4096;
+    static constexpr uint16_t kMaxCycle = 1024; // longest period kept (~190 Hz at 192 kHz)
+    static constexpr uint32_t kRetryMs = 5; // player queue was full
+    static constexpr uint32_t kIdle = 0xFFFFFFFF;
+
+    enum Wave : uint8_t { kSquare, kSine, kTriangle };
+
+    // hz 0 is a rest.
+    struct Note {
+        uint16_t hz;
+        uint16_t ms;
+    };
+
+    // Play `cycle` (len signed 8-bit samples, one period) `repeat` times at
+    // `rate` samples/s, after whatever the player already holds, or in its
+    // place if stopCurrent. The buffer stays valid until the theme is
+    // cleared. Return false if the player can't take it yet.
+    typedef bool (*Play)(void *ctx, const int8_t *cycle, size_t len, uint32_t rate, uint32_t repeat,
+                         bool stopCurrent);
+
+    AudioEngine(Play play, void *ctx, uint32_t outputRate);
+
+    // Only while nothing is playing: queued notes point into the pool.
+    void clearTheme();
+    // False if the tables or the pool are full, or the notes are empty.
+    bool addEvent(const char *name, uint8_t priority, Wave wave, uint8_t volume, const Note *notes,
+                  uint8_t count);
+    bool hasEvent(const char *name) const { return find(name) >= 0; }
+    uint8_t events() const { return eventCount_; }
+    size_t poolUsed() const { return poolUsed_; }
+    static bool waveFromName(const char *name, Wave &wave);
+
+    // Queue the event's sound and start it if it outranks what is playing.
+    // False if the theme has no such event or the queue dropped it.
+    bool post(const char *name, uint64_t nowUs);
+    // Hand the player whatever is due.
+    void service(uint64_t nowUs);
+    // Until service() has something to do; kIdle when nothing is pending.
+    uint32_t msUntilNext(uint64_t nowUs) const;
+    // Audio handed over that hasn't finished yet.
+    bool busy(uint64_t nowUs) const { return current_ >= 0 || nowUs < endUs_; }
+
+    uint32_t posted() const { return posted_; }
+    uint32_t started() const { return started_; }
+    uint32_t preempted() const { return preempted_; }
+    uint32_t coalesced() const { return coalesced_; }
+    uint32_t dropped() const { return dropped_; }
+    // Total sounding time handed to the player, rests excluded.
+    uint64_t audibleUs() const { return audibleUs_; }
+
+private:
+    struct Tone {
+        const int8_t *cycle;
+        uint16_t len;
+        uint32_t rate;
+        uint32_t repeat;
+        uint32_t us;
+        bool rest;
+    };
+    struct Cycle {
+        const int8_t *data;
+        uint16_t len;
+        Wave wave;
+        uint8_t volume;
+    };
+    struct Event {
+        char name[kMaxName + 1];
+        uint8_t priority;
+        uint8_t count;
+        Tone tones[kMaxNotes];
+    };
+
+    int8_t find(const char *name) const;
+    const int8_t *render(Wave wave, uint8_t volume, uint16_t len);
+    void start(int8_t event, bool stopCurrent);
+    bool submit(uint64_t nowUs);
+    bool enqueue(int8_t event);
+
+    Play play_;
+    void *ctx_;
+    uint32_t outputRate_;
+
+    Event events_[kMaxEvents];
+    uint8_t eventCount_ = 0;
+    int8_t pool_[kPoolBytes];
+    size_t poolUsed_ = 0;
+    Cycle cycles_[kMaxEvents * kMaxNotes];
+    uint8_t cycleCount_ = 0;
+    int8_t rest_[16] = {};
+
+    int8_t queue_[kMaxQueued]; // event ids, highest priority first
+    uint8_t queued_ = 0;
+    int8_t current_ = -1;      // event whose notes are being handed over
+    int8_t sounding_ = -1;     // event of the last note handed over
+    uint8_t next_ = 0;         // its next note
+    bool stopNext_ = false;    // the next hand-over preempts
+    uint64_t prevEndUs_ = 0;   // end of the note before the last handed over
+    uint64_t endUs_ = 0;       // end of the last handed over
+    uint64_t retryUs_ = 0;
+
+    uint32_t posted_ = 0;
+    uint32_t started_ = 0;
+    uint32_t preempted_ = 0;
+    uint32_t coalesced_ = 0;
+    uint32_t dropped_ = 0;
+    uint64_t audibleUs_ = 0;
+};
+
+#endif // AUDIO_ENGINE_H
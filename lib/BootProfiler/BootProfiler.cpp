@@ -0,0 +1,45 @@
+#include "BootProfiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void BootProfiler::mark(const char *name, uint64_t us) {
+    if (count_ >= kMaxPhases || has(name)) return;
+    // Insertion keeps phases_ sorted by time.
+    uint8_t i = count_++;
+    while (i > 0 && phases_[i - 1].us > us) {
+        phases_[i] = phases_[i - 1];
+        i--;
+    }
+    phases_[i].name = name;
+    phases_[i].us = us;
+}
+
+bool BootProfiler::has(const char *name) const {
+    for (uint8_t i = 0; i < count_; i++) {
+        if (strcmp(phases_[i].name, name) == 0) return true;
+    }
+    return false;
+}
+
+uint64_t BootProfiler::endUs() const { return count_ ? phases_[count_ - 1].us : 0; }
+
+size_t BootProfiler::summarize(char *out, size_t cap) const {
+    size_t len = 0;
+    if (cap) out[0] = '\0';
+    uint64_t prev = 0;
+    for (uint8_t i = 0; i < count_; i++) {
+        int n = snprintf(out + len, cap - len, "%s%s %lu", i ? " | " : "", phases_[i].name,
+                         (unsigned long)((phases_[i].us - prev + 500) / 1000));
+        if (n < 0 || (size_t)n >= cap - len) {
+            out[len] = '\0'; // drop the phase that didn't fit
+            return len;
+        }
+        len += n;
+        prev = phases_[i].us;
+    }
+    int n = snprintf(out + len, cap - len, " = %lu ms", (unsigned long)((endUs() + 500) / 1000));
+    if (n > 0 && (size_t)n < cap - len) len += n;
+    else out[len] = '\0';
+    return len;
+}
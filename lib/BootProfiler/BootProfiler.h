@@ -0,0 +1,39 @@
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Boot phase timeline. Each mark records when a named phase ended, in
+// microseconds since the chip started; phases that run in the background
+// (radio association, broker connect) are marked with the timestamp their
+// task captured, so marks can arrive out of order. summarize() sorts them
+// and charges each phase the time since the one before it.
+class BootProfiler {
+public:
+    static constexpr uint8_t kMaxPhases = 16;
+
+    // name must outlive the profiler (a string literal). Repeated names
+    // keep the first mark.
+    void mark(const char *name, uint64_t us);
+    bool has(const char *name) const;
+
+    uint8_t count() const { return count_; }
+    // Time of the latest mark.
+    uint64_t endUs() const;
+
+    // "core 312 | m5 190 | ... = 2772 ms", phases in time order, each with
+    // its own milliseconds and the total at the end. Returns bytes written
+    // (excluding NUL).
+    size_t summarize(char *out, size_t cap) const;
+
+private:
+    struct Phase {
+        const char *name;
+        uint64_t us;
+    };
+    Phase phases_[kMaxPhases] = {};
+    uint8_t count_ = 0;
+};
+
+#endif // BOOT_PROFILER_H
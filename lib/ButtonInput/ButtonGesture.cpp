@@ -0,0 +1,57 @@
+#include "ButtonGesture.h"
+
+ButtonGesture::Event ButtonGesture::edge(bool pressed, uint32_t nowMs) {
+    if (pressed == pressed_) return kNone;
+    // Signed: an edge stamped by the ISR may be newer than the caller's clock.
+    if ((int32_t)(nowMs - lastEdgeMs_) < (int32_t)kDebounceMs) return kNone; // bounce; poll() resyncs
+    lastEdgeMs_ = nowMs;
+    pressed_ = pressed;
+
+    if (pressed) {
+        downAt_ = nowMs;
+        longFired_ = false;
+        return kDown;
+    }
+    if (longFired_) return kNone; // already reported while held
+    if (++clicks_ == 2) {
+        clicks_ = 0;
+        return kDoubleClick;
+    }
+    clickDeadline_ = nowMs + kDoubleMs;
+    return kNone;
+}
+
+ButtonGesture::Event ButtonGesture::poll(bool rawPressed, uint32_t nowMs) {
+    if (rawPressed != pressed_ && (int32_t)(nowMs - lastEdgeMs_) >= (int32_t)kDebounceMs) {
+        Event e = edge(rawPressed, nowMs);
+        if (e != kNone) return e;
+    }
+    if (pressed_ && !longFired_ && (int32_t)(nowMs - downAt_) >= (int32_t)kLongMs) {
+        longFired_ = true;
+        clicks_ = 0;
+        return kLongPress;
+    }
+    if (!pressed_ && clicks_ == 1 && (int32_t)(nowMs - clickDeadline_) >= 0) {
+        clicks_ = 0;
+        return kClick;
+    }
+    return kNone;
+}
+
+uint32_t ButtonGesture::msUntilDeadline(uint32_t nowMs) const {
+    uint32_t best = kNever;
+    // End of the debounce lockout, to resync a level that changed inside it.
+    int32_t sinceEdge = (int32_t)(nowMs - lastEdgeMs_);
+    if (sinceEdge < (int32_t)kDebounceMs) best = sinceEdge < 0 ? kDebounceMs : kDebounceMs - sinceEdge;
+    if (pressed_ && !longFired_) {
+        int32_t held = (int32_t)(nowMs - downAt_);
+        uint32_t left = held >= (int32_t)kLongMs ? 0 : held < 0 ? kLongMs : kLongMs - held;
+        if (left < best) best = left;
+    }
+    if (!pressed_ && clicks_ == 1) {
+        int32_t left = (int32_t)(clickDeadline_ - nowMs);
+        uint32_t l = left > 0 ? (uint32_t)left : 0;
+        if (l < best) best = l;
+    }
+    return best;
+}
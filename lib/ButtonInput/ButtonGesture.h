@@ -0,0 +1,43 @@
+#ifndef BUTTON_GESTURE_H
+#define BUTTON_GESTURE_H
+
+#include <stdint.h>
+
+// Turns raw, bouncy press/release edges of one button into gestures.
+//
+// Debounce is leading-edge: the first edge is acted on at once (so a press
+// wakes the screen without delay) and further edges are ignored for
+// kDebounceMs; after that, poll() resyncs with the pin if it settled on the
+// other level.
+//
+// A press yields kDown immediately. On release it becomes a click, unless
+// a second press follows within kDoubleMs (kDoubleClick) or the button was
+// held for kLongMs (kLongPress, reported while still held). Single clicks
+// are therefore reported kDoubleMs after release.
+class ButtonGesture {
+public:
+    enum Event : uint8_t { kNone, kDown, kClick, kDoubleClick, kLongPress };
+
+    static constexpr uint32_t kDebounceMs = 20;
+    static constexpr uint32_t kLongMs = 600;
+    static constexpr uint32_t kDoubleMs = 300;
+    static constexpr uint32_t kNever = 0xFFFFFFFF;
+
+    Event edge(bool pressed, uint32_t nowMs);
+    // Time-driven events and debounce resync; call until it returns kNone.
+    Event poll(bool rawPressed, uint32_t nowMs);
+    // Milliseconds until poll() has something to do, or kNever.
+    uint32_t msUntilDeadline(uint32_t nowMs) const;
+
+    bool pressed() const { return pressed_; }
+
+private:
+    bool pressed_ = false;
+    bool longFired_ = false;
+    uint8_t clicks_ = 0;
+    uint32_t lastEdgeMs_ = 0;
+    uint32_t downAt_ = 0;
+    uint32_t clickDeadline_ = 0;
+};
+
+#endif // BUTTON_GESTURE_H
@@ -0,0 +1,67 @@
+#include "ButtonInput.h"
+
+#include <esp_timer.h>
+#include <hal/gpio_ll.h>
+#include <unistd.h>
+
+bool ButtonInput::begin(const gpio_num_t *pins, uint8_t count, int wakeFd) {
+    count_ = count > kMaxButtons ? kMaxButtons : count;
+    wakeFd_ = wakeFd;
+    for (uint8_t i = 0; i < count_; i++) {
+        pins_[i] = pins[i];
+        contexts_[i] = {this, i};
+        gpio_set_direction(pins_[i], GPIO_MODE_INPUT); // rawPressed() works even if we bail below
+    }
+
+    // Not ESP_INTR_FLAG_IRAM: the ISR writes the eventfd through the VFS,
+    // which lives in flash, so it must be held off while LittleFS writes.
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return false; // already installed is fine
+
+    for (uint8_t i = 0; i < count_; i++) {
+        // Arm for whichever edge comes next from the current level.
+        gpio_int_type_t next = gpio_get_level(pins_[i]) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+        // The wakeup level shares the interrupt-type field, so this also
+        // replaces any low-level light-sleep wakeup set up for the pin.
+        gpio_set_intr_type(pins_[i], next);
+        gpio_wakeup_enable(pins_[i], next);
+        if (gpio_isr_handler_add(pins_[i], isr, &contexts_[i]) != ESP_OK) return false;
+        gpio_intr_enable(pins_[i]);
+    }
+    return true;
+}
+
+void IRAM_ATTR ButtonInput::isr(void *arg) {
+    PinContext *ctx = static_cast<PinContext *>(arg);
+    ButtonInput *self = ctx->self;
+    gpio_num_t pin = self->pins_[ctx->button];
+
+    // Flip polarity first, or the level interrupt fires again straight away.
+    // A glitch (e.g. the ESP32's GPIO36/39 dip when the ADC powers up) reads
+    // back as the unchanged level and is dropped by the gesture debounce.
+    bool pressed = gpio_ll_get_level(&GPIO, pin) == 0;
+    gpio_ll_set_intr_type(&GPIO, pin, pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+
+    uint8_t head = self->head_.load(std::memory_order_relaxed);
+    if ((uint8_t)(head - self->tail_.load(std::memory_order_acquire)) >= kQueue) {
+        self->overflows_ = self->overflows_ + 1;
+    } else {
+        Edge &e = self->queue_[head & (kQueue - 1)];
+        e.button = ctx->button;
+        e.pressed = pressed;
+        e.ms = (uint32_t)(esp_timer_get_time() / 1000);
+        self->head_.store(head + 1, std::memory_order_release);
+    }
+    if (self->wakeFd_ >= 0) {
+        uint64_t one = 1;
+        write(self->wakeFd_, &one, sizeof(one)); // eventfd created with EFD_SUPPORT_ISR
+    }
+}
+
+bool ButtonInput::pop(Edge &edge) {
+    uint8_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    edge = queue_[tail & (kQueue - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/gpio.h>
+
+// Edge capture for active-low buttons without polling. Each pin gets a
+// level-triggered interrupt that flips polarity on every edge: low while
+// released, high while held. Level triggering is what lets the same pin
+// wake the chip from light sleep. The ISR stamps the edge into a lock-free
+// single-producer ring and pokes wakeFd (an eventfd) so a loop blocked in
+// select() wakes up.
+class ButtonInput {
+public:
+    static constexpr uint8_t kMaxButtons = 3;
+    static constexpr uint8_t kQueue = 32; // power of two
+
+    struct Edge {
+        uint8_t button;
+        bool pressed;
+        uint32_t ms;
+    };
+
+    // wakeFd < 0: no wakeups, the caller polls pop() itself.
+    bool begin(const gpio_num_t *pins, uint8_t count, int wakeFd);
+
+    // Consumer side: oldest queued edge.
+    bool pop(Edge &edge);
+
+    bool rawPressed(uint8_t button) const { return gpio_get_level(pins_[button]) == 0; }
+    uint8_t count() const { return count_; }
+    uint32_t overflows() const { return overflows_; }
+
+private:
+    struct PinContext {
+        ButtonInput *self;
+        uint8_t button;
+    };
+    static void IRAM_ATTR isr(void *arg);
+
+    gpio_num_t pins_[kMaxButtons] = {};
+    PinContext contexts_[kMaxButtons] = {};
+    uint8_t count_ = 0;
+    int wakeFd_ = -1;
+    Edge queue_[kQueue] = {};
+    std::atomic<uint8_t> head_{0};
+    std::atomic<uint8_t> tail_{0};
+    volatile uint32_t overflows_ = 0;
+};
+
+#endif // BUTTON_INPUT_H
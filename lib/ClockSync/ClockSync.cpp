@@ -0,0 +1,37 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+
+void ClockSync::addSample(uint32_t t0, int64_t t1, int64_t t2, uint32_t t3) {
+    int64_t roundTrip = (int64_t)(uint32_t)(t3 - t0) - (t2 - t1);
+    if (roundTrip < 0) roundTrip = 0; // host clock stepped mid-exchange
+    Sample &s = samples_[next_];
+    s.offset = ((t1 - (int64_t)t0) + (t2 - (int64_t)t3)) / 2;
+    s.rtt = (uint32_t)roundTrip;
+    next_ = (next_ + 1) % kSamples;
+    if (count_ < kSamples) count_++;
+}
+
+const ClockSync::Sample &ClockSync::best() const {
+    uint8_t bestIdx = 0;
+    for (uint8_t i = 1; i < count_; i++) {
+        if (samples_[i].rtt < samples_[bestIdx].rtt) bestIdx = i;
+    }
+    return samples_[bestIdx];
+}
+
+void SampleWindow::add(uint32_t v) {
+    values_[next_] = v;
+    next_ = (next_ + 1) % kSize;
+    if (count_ < kSize) count_++;
+}
+
+uint32_t SampleWindow::percentile(uint8_t p) const {
+    if (count_ == 0) return 0;
+    uint32_t sorted[kSize];
+    std::copy(values_, values_ + count_, sorted);
+    std::sort(sorted, sorted + count_);
+    size_t rank = ((size_t)count_ * p + 99) / 100;
+    if (rank == 0) rank = 1;
+    return sorted[rank - 1];
+}
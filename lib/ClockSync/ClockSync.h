@@ -0,0 +1,55 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Estimates the offset between the device's millis() clock and a producer's
+// wall clock (epoch ms) from NTP-style ping/pong exchanges:
+//   t0 device send, t1 host receive, t2 host send, t3 device receive
+//   offset = ((t1 - t0) + (t2 - t3)) / 2,  rtt = (t3 - t0) - (t2 - t1)
+// Only the lowest-RTT sample among the last kSamples is trusted, because
+// queueing delay is what skews an individual exchange.
+class ClockSync {
+public:
+    static constexpr uint8_t kSamples = 8;
+
+    void addSample(uint32_t t0, int64_t t1, int64_t t2, uint32_t t3);
+
+    bool valid() const { return count_ > 0; }
+    int64_t offset() const { return best().offset; }
+    uint32_t rtt() const { return best().rtt; }
+
+    // Device millis() expressed on the producer's clock.
+    int64_t toHost(uint32_t deviceMs) const { return (int64_t)deviceMs + offset(); }
+
+private:
+    struct Sample {
+        int64_t offset;
+        uint32_t rtt;
+    };
+    const Sample &best() const;
+
+    Sample samples_[kSamples] = {};
+    uint8_t next_ = 0;
+    uint8_t count_ = 0;
+};
+
+// Ring of the most recent samples with exact percentiles, for quantities
+// where log2 buckets are too coarse (end-to-end latency in ms).
+class SampleWindow {
+public:
+    static constexpr uint8_t kSize = 64;
+
+    void add(uint32_t v);
+    void reset() { count_ = 0; next_ = 0; }
+    uint8_t count() const { return count_; }
+    uint32_t percentile(uint8_t p) const;
+
+private:
+    uint32_t values_[kSize] = {};
+    uint8_t next_ = 0;
+    uint8_t count_ = 0;
+};
+
+#endif // CLOCK_SYNC_H
@@ -0,0 +1,94 @@
+#include "EnergyModel.h"
+
+namespace {
+constexpr double kUsPerS = 1e6;
+}
+
+void EnergyModel::Integrator::advance(uint64_t nowUs) {
+    if (since_ && nowUs > since_) sum_ += (uint64_t)level_ * (nowUs - since_);
+    since_ = nowUs;
+}
+
+void EnergyModel::Integrator::set(uint32_t level, uint64_t nowUs) {
+    advance(nowUs);
+    level_ = level;
+}
+
+uint64_t EnergyModel::Integrator::take(uint64_t nowUs) {
+    advance(nowUs);
+    uint64_t sum = sum_;
+    sum_ = 0;
+    return sum;
+}
+
+EnergyModel::EnergyModel(const Coefficients &coefficients, float capacityMah)
+    : k_(coefficients), capacityMah_(capacityMah) {}
+
+void EnergyModel::add(const Sample &s) {
+    mas_[kBacklight] += k_.backlightFullMa * (s.backlightLevelUs / 255.0) / kUsPerS;
+    mas_[kCpu] += (k_.cpuHighMa * s.cpuHighUs + k_.cpuLowMa * s.cpuLowUs + k_.cpuIdleMa * s.idleUs +
+                   k_.lightSleepMa * s.sleepUs) / kUsPerS;
+    mas_[kRadio] += (k_.radioUpMa * s.radioUpUs + k_.radioDownMa * s.radioDownUs) / kUsPerS +
+                    k_.radioWakeMas * s.radioWakes;
+    mas_[kPanel] += k_.panelMa * s.panelAwakeUs / kUsPerS + k_.spiMasPerKB * s.spiBytes / 1024.0;
+    mas_[kSpeaker] += k_.speakerMa * s.speakerUs / kUsPerS;
+    mas_[kBase] += k_.baseMa * s.elapsedUs / kUsPerS;
+    elapsedUs_ += s.elapsedUs;
+}
+
+float EnergyModel::totalMah() const {
+    double sum = 0;
+    for (uint8_t i = 0; i < kCount; i++) sum += mas_[i];
+    return (float)(sum / 3600.0);
+}
+
+void EnergyModel::calibrate(int batteryPct, bool charging) {
+    if (charging || batteryPct < 0) {
+        windowPct_ = -1;
+        return;
+    }
+    const float modelled = totalMah();
+    if (windowPct_ < 0 || batteryPct > windowPct_) {
+        // Start (or restart after a rise, e.g. gauge noise or a top-up).
+        windowPct_ = batteryPct;
+        windowMah_ = modelled;
+        return;
+    }
+    const int drop = windowPct_ - batteryPct;
+    if (drop < kCalibrationPct) return;
+
+    const float measured = capacityMah_ * drop / 100.0f;
+    const float predicted = modelled - windowMah_;
+    if (predicted > 0) {
+        float ratio = measured / predicted;
+        if (ratio < kMinScale) ratio = kMinScale;
+        if (ratio > kMaxScale) ratio = kMaxScale;
+        // The gauge is coarse and non-linear, so move halfway each window.
+        scale_ = calibrations_ ? (scale_ + ratio) / 2 : ratio;
+        calibrations_++;
+    }
+    windowPct_ = batteryPct;
+    windowMah_ = modelled;
+}
+
+float EnergyModel::averageMa() const {
+    if (!elapsedUs_) return 0;
+    return (float)(totalMah() * scale_ * 3600.0 / (elapsedUs_ / kUsPerS));
+}
+
+float EnergyModel::lifeHours() const {
+    const float ma = averageMa();
+    return ma > 0 ? capacityMah_ / ma : 0;
+}
+
+const char *EnergyModel::name(uint8_t component) {
+    switch (component) {
+    case kBacklight: return "backlight";
+    case kCpu:       return "cpu";
+    case kRadio:     return "radio";
+    case kPanel:     return "panel";
+    case kSpeaker:   return "speaker";
+    case kBase:      return "base";
+    default:         return "?";
+    }
+}
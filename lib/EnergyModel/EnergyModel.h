@@ -0,0 +1,99 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+
+// Estimates battery charge used per component from activity counters the
+// firmware already keeps (residency times, bytes pushed, tone time), using
+// per-component current figures. The figures are rough datasheet-level
+// numbers, so the model is calibrated against the battery gauge: over each
+// discharge window of kCalibrationPct, the measured drop is compared with
+// the modelled charge and a correction scale is tracked.
+class EnergyModel {
+public:
+    enum Component : uint8_t { kBacklight, kCpu, kRadio, kPanel, kSpeaker, kBase, kCount };
+
+    // Average currents in mA (charges in mA*s) at the battery.
+    struct Coefficients {
+        float backlightFullMa; // backlight at level 255; scales linearly
+        float cpuHighMa;       // running at the high clock
+        float cpuLowMa;        // running at the low clock
+        float cpuIdleMa;       // idle, clock gated
+        float lightSleepMa;    // light sleep
+        float radioUpMa;       // associated, in power save
+        float radioDownMa;     // not associated: scanning / connecting
+        float radioWakeMas;    // each received burst
+        float panelMa;         // LCD controller awake
+        float spiMasPerKB;     // pushing pixels
+        float speakerMa;       // tone playing
+        float baseMa;          // everything else, always on
+    };
+
+    // Activity since the previous add(); times in microseconds.
+    struct Sample {
+        uint64_t backlightLevelUs; // sum of level (0..255) * time
+        uint64_t cpuHighUs;        // awake at the high clock
+        uint64_t cpuLowUs;         // awake at the low clock
+        uint64_t idleUs;           // idle, not sleeping
+        uint64_t sleepUs;          // light sleep
+        uint64_t radioUpUs;
+        uint64_t radioDownUs;
+        uint32_t radioWakes;
+        uint64_t panelAwakeUs;
+        uint32_t spiBytes;
+        uint64_t speakerUs;
+        uint64_t elapsedUs;
+    };
+
+    // Accumulates a time-weighted level, closed off on each change; used
+    // for state that changes on events (backlight, link, panel).
+    class Integrator {
+    public:
+        void set(uint32_t level, uint64_t nowUs);
+        // Integral since the previous take().
+        uint64_t take(uint64_t nowUs);
+
+    private:
+        void advance(uint64_t nowUs);
+
+        uint32_t level_ = 0;
+        uint64_t since_ = 0;
+        uint64_t sum_ = 0;
+    };
+
+    static constexpr uint8_t kCalibrationPct = 5;
+    static constexpr float kMinScale = 0.25f;
+    static constexpr float kMaxScale = 4.0f;
+
+    EnergyModel(const Coefficients &coefficients, float capacityMah);
+
+    void add(const Sample &sample);
+
+    // Feed each battery reading. A charger resets the window; every
+    // kCalibrationPct of uninterrupted discharge updates scale().
+    void calibrate(int batteryPct, bool charging);
+
+    // Modelled charge, uncorrected.
+    float mAh(uint8_t component) const { return (float)(mas_[component] / 3600.0); }
+    float totalMah() const;
+    float scale() const { return scale_; }
+    uint32_t calibrations() const { return calibrations_; }
+    // Calibrated average current and the runtime a full battery would give.
+    float averageMa() const;
+    float lifeHours() const;
+
+    static const char *name(uint8_t component);
+
+private:
+    Coefficients k_;
+    float capacityMah_;
+    double mas_[kCount] = {}; // mA*s; double so small terms survive days of uptime
+    uint64_t elapsedUs_ = 0;
+
+    float scale_ = 1.0f;
+    uint32_t calibrations_ = 0;
+    int windowPct_ = -1;
+    float windowMah_ = 0;
+};
+
+#endif // ENERGY_MODEL_H
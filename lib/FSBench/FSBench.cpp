@@ -0,0 +1,341 @@
+#include "FSBench.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kBlocks[] = {64, 256, 512, 1024, 4096};
+const size_t kFillerBytes = 4096;
+const uint16_t kMaxFillers = 1024;
+
+} // namespace
+
+FSBench::FSBench(const char *root, const char *label, Emit emit, ClockUs clock, Usage usage)
+    : root_(root), label_(label), emit_(emit), clock_(clock), usage_(usage) {
+    for (size_t i = 0; i < kMaxBlock; i++) block_[i] = (uint8_t)(i * 31 + 7);
+}
+
+void FSBench::setFillSteps(const uint8_t *percents, uint8_t count) {
+    memset(fillSteps_, 0, sizeof(fillSteps_));
+    if (count > kMaxFillSteps) count = kMaxFillSteps;
+    memcpy(fillSteps_, percents, count);
+}
+
+void FSBench::path(char *out, size_t cap, const char *name, int index) const {
+    if (index < 0) snprintf(out, cap, "%s/fsb_%s", root_, name);
+    else snprintf(out, cap, "%s/fsb_%s_%d", root_, name, index);
+}
+
+// Unbuffered, so each fwrite/fread is one filesystem call of the block size
+// under test rather than whatever stdio batches it into.
+FILE *FSBench::open(const char *name, const char *mode) {
+    char full[96];
+    path(full, sizeof(full), name);
+    FILE *f = fopen(full, mode);
+    if (f) setvbuf(f, nullptr, _IONBF, 0);
+    return f;
+}
+
+bool FSBench::fail(const char *test, const char *what) {
+    char line[160];
+    snprintf(line, sizeof(line), "{\"fsbench\":\"error\",\"label\":\"%s\",\"test\":\"%s\",\"what\":\"%s\"}",
+             label_, test, what);
+    emit_(line);
+    errors_++;
+    return false;
+}
+
+void FSBench::emitUsage(const char *test) {
+    uint64_t used = 0, total = 0;
+    if (!usage_ || !usage_(used, total)) return;
+    char line[160];
+    snprintf(line, sizeof(line), "{\"fsbench\":\"usage\",\"label\":\"%s\",\"at\":\"%s\",\"used\":%llu,\"total\":%llu}",
+             label_, test, (unsigned long long)used, (unsigned long long)total);
+    emit_(line);
+}
+
+void FSBench::emitLatency(const char *test, size_t bytes, const LatencyHistogram &h, int fillPct) {
+    char fill[24] = "";
+    if (fillPct >= 0) snprintf(fill, sizeof(fill), ",\"fill\":%d", fillPct);
+    char line[192];
+    snprintf(line, sizeof(line),
+             "{\"fsbench\":\"%s\",\"label\":\"%s\"%s,\"bytes\":%u,\"n\":%lu,\"p50\":%lu,\"p99\":%lu,\"max\":%lu,\"mean\":%lu}",
+             test, label_, fill, (unsigned)bytes, (unsigned long)h.count(), (unsigned long)h.percentile(50),
+             (unsigned long)h.percentile(99), (unsigned long)h.max(), (unsigned long)h.mean());
+    emit_(line);
+}
+
+uint32_t FSBench::nextRandom() {
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+}
+
+bool FSBench::writeFile(const char *name, size_t block, size_t bytes, uint64_t &us) {
+    const uint64_t start = clock_();
+    FILE *f = open(name, "wb");
+    if (!f) return false;
+    bool ok = true;
+    for (size_t done = 0; ok && done < bytes; done += block) {
+        ok = fwrite(block_, 1, block, f) == block;
+    }
+    // Durable before the clock stops: LittleFS commits on sync/close.
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    us = clock_() - start;
+    return ok;
+}
+
+bool FSBench::appendRun(size_t recordBytes, LatencyHistogram &h) {
+    char full[96];
+    path(full, sizeof(full), "append");
+    remove(full);
+    bool ok = true;
+    for (uint16_t i = 0; ok && i < ops_; i++) {
+        const uint64_t start = clock_();
+        FILE *f = open("append", "ab");
+        ok = f && fwrite(block_, 1, recordBytes, f) == recordBytes;
+        if (f) ok = fclose(f) == 0 && ok;
+        h.record((uint32_t)(clock_() - start));
+    }
+    remove(full);
+    return ok;
+}
+
+bool FSBench::sequential(size_t block) {
+    if (block > kMaxBlock) block = kMaxBlock;
+    const size_t bytes = fileBytes_ / block * block;
+    char line[192];
+
+    uint64_t us;
+    if (!writeFile("seq", block, bytes, us)) return fail("seq_write", "write");
+    snprintf(line, sizeof(line),
+             "{\"fsbench\":\"seq_write\",\"label\":\"%s\",\"block\":%u,\"bytes\":%u,\"us\":%llu,\"kBps\":%.1f}",
+             label_, (unsigned)block, (unsigned)bytes, (unsigned long long)us, us ? bytes * 1e6 / 1024.0 / us : 0.0);
+    emit_(line);
+
+    const uint64_t start = clock_();
+    FILE *f = open("seq", "rb");
+    if (!f) return fail("seq_read", "open");
+    size_t got = 0, n;
+    while ((n = fread(block_, 1, block, f)) > 0) got += n;
+    fclose(f);
+    us = clock_() - start;
+    char full[96];
+    path(full, sizeof(full), "seq");
+    remove(full);
+    if (got != bytes) return fail("seq_read", "short read");
+    snprintf(line, sizeof(line),
+             "{\"fsbench\":\"seq_read\",\"label\":\"%s\",\"block\":%u,\"bytes\":%u,\"us\":%llu,\"kBps\":%.1f}",
+             label_, (unsigned)block, (unsigned)bytes, (unsigned long long)us, us ? bytes * 1e6 / 1024.0 / us : 0.0);
+    emit_(line);
+    return true;
+}
+
+// Open, write one record, close: what KvStore does per change.
+bool FSBench::appendLatency(size_t recordBytes) {
+    LatencyHistogram h;
+    if (!appendRun(recordBytes, h)) return fail("append", "write");
+    emitLatency("append", recordBytes, h);
+    return true;
+}
+
+// Commit cost on its own: fflush+fsync on a file kept open, then fclose
+// right after a write.
+bool FSBench::syncCost(size_t recordBytes) {
+    char full[96];
+    path(full, sizeof(full), "sync");
+    remove(full);
+    LatencyHistogram fsyncs, closes;
+
+    FILE *f = open("sync", "ab");
+    if (!f) return fail("fsync", "open");
+    bool ok = true;
+    for (uint16_t i = 0; ok && i < ops_; i++) {
+        ok = fwrite(block_, 1, recordBytes, f) == recordBytes;
+        const uint64_t start = clock_();
+        ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+        fsyncs.record((uint32_t)(clock_() - start));
+    }
+    fclose(f);
+
+    for (uint16_t i = 0; ok && i < ops_; i++) {
+        f = open("sync", "ab");
+        if (!f) {
+            ok = false;
+            break;
+        }
+        ok = fwrite(block_, 1, recordBytes, f) == recordBytes;
+        const uint64_t start = clock_();
+        ok = fclose(f) == 0 && ok;
+        closes.record((uint32_t)(clock_() - start));
+    }
+    remove(full);
+    if (!ok) return fail("fsync", "write");
+    emitLatency("fsync", recordBytes, fsyncs);
+    emitLatency("close", recordBytes, closes);
+    return true;
+}
+
+bool FSBench::randomReads(size_t readBytes) {
+    if (readBytes > kMaxBlock || fileBytes_ / kMaxBlock * kMaxBlock <= readBytes) return fail("random_read", "size");
+    uint64_t us;
+    if (!writeFile("rand", kMaxBlock, fileBytes_, us)) return fail("random_read", "write");
+    const size_t span = fileBytes_ / kMaxBlock * kMaxBlock - readBytes;
+
+    LatencyHistogram h;
+    FILE *f = open("rand", "rb");
+    bool ok = f != nullptr;
+    for (uint16_t i = 0; ok && i < ops_; i++) {
+        const long offset = (long)(nextRandom() % span);
+        const uint64_t start = clock_();
+        ok = fseek(f, offset, SEEK_SET) == 0 && fread(block_, 1, readBytes, f) == readBytes;
+        h.record((uint32_t)(clock_() - start));
+    }
+    if (f) fclose(f);
+    char full[96];
+    path(full, sizeof(full), "rand");
+    remove(full);
+    if (!ok) return fail("random_read", "read");
+    emitLatency("random_read", readBytes, h);
+    return true;
+}
+
+// Write a temporary file and rename it over the target, as KvStore
+// compaction does.
+bool FSBench::atomicReplace(size_t bytes) {
+    if (bytes > kMaxBlock) bytes = kMaxBlock;
+    char tmp[96], target[96];
+    path(tmp, sizeof(tmp), "replace.tmp");
+    path(target, sizeof(target), "replace");
+    LatencyHistogram h;
+    bool ok = true;
+    for (uint16_t i = 0; ok && i < ops_; i++) {
+        const uint64_t start = clock_();
+        FILE *f = open("replace.tmp", "wb");
+        ok = f && fwrite(block_, 1, bytes, f) == bytes;
+        if (f) ok = fclose(f) == 0 && ok;
+        ok = ok && rename(tmp, target) == 0;
+        h.record((uint32_t)(clock_() - start));
+    }
+    remove(tmp);
+    remove(target);
+    if (!ok) return fail("replace", "write");
+    emitLatency("replace", bytes, h);
+    return true;
+}
+
+void FSBench::removeFillers() {
+    char full[96];
+    for (uint16_t i = 0; i < fillers_; i++) {
+        path(full, sizeof(full), "fill", i);
+        remove(full);
+    }
+    fillers_ = 0;
+}
+
+uint16_t FSBench::removeLeftovers(const char *root) {
+    DIR *dir = opendir(root);
+    if (!dir) return 0;
+    char full[96];
+    uint16_t removed = 0;
+    // Collect before deleting: removing entries mid-readdir() isn't portable.
+    for (;;) {
+        uint16_t batch = 0;
+        char names[8][48];
+        struct dirent *e;
+        while (batch < 8 && (e = readdir(dir)) != nullptr) {
+            const size_t len = strlen(e->d_name);
+            if (strncmp(e->d_name, "fsb_", 4) != 0 || len >= sizeof(names[0])) continue;
+            memcpy(names[batch++], e->d_name, len + 1);
+        }
+        uint16_t gone = 0;
+        for (uint16_t i = 0; i < batch; i++) {
+            // Skip a path that doesn't fit rather than remove a truncated one.
+            const int n = snprintf(full, sizeof(full), "%s/%s", root, names[i]);
+            if (n > 0 && (size_t)n < sizeof(full) && remove(full) == 0) gone++;
+        }
+        removed += gone;
+        if (batch < 8 || gone == 0) break;
+        rewinddir(dir);
+    }
+    closedir(dir);
+    return removed;
+}
+
+bool FSBench::fillSweep() {
+    if (!usage_) return fail("fill", "no usage callback");
+    bool ok = true;
+    for (uint8_t s = 0; ok && s < kMaxFillSteps && fillSteps_[s]; s++) {
+        const uint8_t pct = fillSteps_[s];
+        uint64_t used = 0, total = 0;
+        if (!usage_(used, total) || total == 0) return fail("fill", "usage");
+
+        // Top up in one go (usage can be slow to compute), every third
+        // new filler deleted again to leave holes.
+        const uint64_t want = total * pct / 100;
+        const uint16_t first = fillers_;
+        while (used < want && fillers_ < kMaxFillers) {
+            char name[16];
+            snprintf(name, sizeof(name), "fill_%u", (unsigned)fillers_);
+            uint64_t us;
+            if (!writeFile(name, kMaxBlock, kFillerBytes, us)) break; // full
+            fillers_++;
+            used += kFillerBytes;
+        }
+        for (uint16_t i = first + 2; i < fillers_; i += 3) {
+            char full[96];
+            path(full, sizeof(full), "fill", i);
+            remove(full);
+        }
+        emitUsage("fill");
+
+        uint64_t us;
+        size_t bytes = fileBytes_ / 4 / kMaxBlock * kMaxBlock;
+        if (bytes < kMaxBlock) bytes = kMaxBlock;
+        if (!writeFile("seq", kMaxBlock, bytes, us)) {
+            ok = fail("fill_write", "write");
+        } else {
+            char line[192];
+            snprintf(line, sizeof(line),
+                     "{\"fsbench\":\"fill_write\",\"label\":\"%s\",\"fill\":%u,\"block\":%u,\"bytes\":%u,\"us\":%llu,\"kBps\":%.1f}",
+                     label_, (unsigned)pct, (unsigned)kMaxBlock, (unsigned)bytes, (unsigned long long)us,
+                     us ? bytes * 1e6 / 1024.0 / us : 0.0);
+            emit_(line);
+        }
+        char full[96];
+        path(full, sizeof(full), "seq");
+        remove(full);
+
+        LatencyHistogram h;
+        if (appendRun(32, h)) emitLatency("fill_append", 32, h, pct);
+        else ok = fail("fill_append", "write");
+    }
+    removeFillers();
+    return ok;
+}
+
+bool FSBench::run() {
+    errors_ = 0;
+    const uint64_t start = clock_();
+    char line[192];
+    snprintf(line, sizeof(line), "{\"fsbench\":\"start\",\"label\":\"%s\",\"root\":\"%s\",\"fileBytes\":%u,\"ops\":%u}",
+             label_, root_, (unsigned)fileBytes_, (unsigned)ops_);
+    emit_(line);
+    emitUsage("start");
+
+    for (size_t block : kBlocks) sequential(block);
+    appendLatency(32);
+    syncCost(32);
+    randomReads(64);
+    atomicReplace(1024);
+    fillSweep();
+
+    snprintf(line, sizeof(line), "{\"fsbench\":\"done\",\"label\":\"%s\",\"errors\":%lu,\"us\":%llu}", label_,
+             (unsigned long)errors_, (unsigned long long)(clock_() - start));
+    emit_(line);
+    return errors_ == 0;
+}
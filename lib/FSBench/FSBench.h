@@ -0,0 +1,83 @@
+#ifndef FS_BENCH_H
+#define FS_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "StageProfiler.h"
+
+// Filesystem benchmark suite for the access patterns the firmware has:
+// sequential files at several block sizes, small appends with a close per
+// record (KvStore), flush/fsync/close cost, small random reads, write-temp-
+// and-rename replace, and all of those again as the filesystem fills up and
+// fragments.
+//
+// Everything goes through POSIX stdio under a root directory, so the same
+// code runs on the device (LittleFS mounted at /littlefs by the VFS) and on
+// a host directory standing in for it. Each result is one JSON line:
+//   {"fsbench":"seq_write","label":"littlefs","block":512,"bytes":65536,"us":81234,"kBps":788.2}
+// Latency tests report microseconds as n/p50/p99/max/mean, where the
+// percentiles are log2-bucket upper bounds (see LatencyHistogram).
+class FSBench {
+public:
+    typedef void (*Emit)(const char *line);
+    typedef uint64_t (*ClockUs)();
+    // Bytes in use and total capacity of the filesystem under test.
+    typedef bool (*Usage)(uint64_t &used, uint64_t &total);
+
+    static constexpr size_t kMaxBlock = 4096;
+    static constexpr uint8_t kMaxFillSteps = 4;
+
+    FSBench(const char *root, const char *label, Emit emit, ClockUs clock, Usage usage);
+
+    // Size of the sequential and random-read files.
+    void setFileBytes(size_t bytes) { fileBytes_ = bytes; }
+    // Samples per latency test.
+    void setOps(uint16_t ops) { ops_ = ops; }
+    // Used-space levels (percent) for the fill sweep, ascending; 0 ends.
+    void setFillSteps(const uint8_t *percents, uint8_t count);
+
+    // Every test in order. Returns false if any of them hit an I/O error.
+    bool run();
+
+    bool sequential(size_t block);
+    bool appendLatency(size_t recordBytes);
+    bool syncCost(size_t recordBytes);
+    bool randomReads(size_t readBytes);
+    bool atomicReplace(size_t bytes);
+    // Fills to each step with 4 KB files, deletes every third one to leave
+    // holes, then reruns a 4 KB-block write and the append test.
+    bool fillSweep();
+
+    uint32_t errors() const { return errors_; }
+
+    // Delete the suite's files (fsb_*) from root, e.g. after a reset cut a
+    // run short. Returns how many were removed.
+    static uint16_t removeLeftovers(const char *root);
+
+private:
+    FILE *open(const char *name, const char *mode);
+    void path(char *out, size_t cap, const char *name, int index = -1) const;
+    bool writeFile(const char *name, size_t block, size_t bytes, uint64_t &us);
+    bool appendRun(size_t recordBytes, LatencyHistogram &h);
+    bool fail(const char *test, const char *what);
+    void emitUsage(const char *test);
+    void emitLatency(const char *test, size_t bytes, const LatencyHistogram &h, int fillPct = -1);
+    uint32_t nextRandom();
+    void removeFillers();
+
+    const char *root_;
+    const char *label_;
+    Emit emit_;
+    ClockUs clock_;
+    Usage usage_;
+    size_t fileBytes_ = 64 * 1024;
+    uint16_t ops_ = 100;
+    uint8_t fillSteps_[kMaxFillSteps] = {50, 75, 90, 0};
+    uint16_t fillers_ = 0;
+    uint32_t rng_ = 0x2545F491;
+    uint32_t errors_ = 0;
+    uint8_t block_[kMaxBlock];
+};
+
+#endif // FS_BENCH_H
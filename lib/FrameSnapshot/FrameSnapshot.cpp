@@ -0,0 +1,184 @@
+#include "FrameSnapshot.h"
+
+#include <string.h>
+
+namespace {
+
+const uint8_t kMagic[4] = {'R', 'L', 'E', '8'};
+
+void put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+void put32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Collects output into a stack buffer and hands it to the sink in chunks.
+class Output {
+public:
+    Output(FrameSnapshot::Write write, void *ctx) : write_(write), ctx_(ctx) {}
+
+    void put(uint8_t b) {
+        if (len_ == sizeof(buf_)) flush();
+        buf_[len_++] = b;
+        total_++;
+    }
+    void put(const uint8_t *p, size_t n) {
+        while (n--) put(*p++);
+    }
+    bool flush() {
+        if (len_ && write_ && ok_) ok_ = write_(ctx_, buf_, len_);
+        len_ = 0;
+        return ok_;
+    }
+    size_t total() const { return ok_ ? total_ : 0; }
+
+private:
+    FrameSnapshot::Write write_;
+    void *ctx_;
+    uint8_t buf_[256];
+    size_t len_ = 0;
+    size_t total_ = 0;
+    bool ok_ = true;
+};
+
+void putLiterals(Output &out, const uint8_t *p, size_t n) {
+    while (n) {
+        size_t take = n < FrameSnapshot::kMaxLiteral ? n : FrameSnapshot::kMaxLiteral;
+        out.put((uint8_t)(take - 1));
+        out.put(p, take);
+        p += take;
+        n -= take;
+    }
+}
+
+// Pulls input through a stack buffer, counting what it consumed.
+class Input {
+public:
+    Input(FrameSnapshot::Read read, void *ctx, size_t limit) : read_(read), ctx_(ctx), left_(limit) {}
+
+    int get() {
+        if (pos_ == len_) {
+            if (!left_) return -1;
+            len_ = read_(ctx_, buf_, left_ < sizeof(buf_) ? left_ : sizeof(buf_));
+            pos_ = 0;
+            if (!len_) return -1;
+            left_ -= len_;
+        }
+        return buf_[pos_++];
+    }
+    bool exhausted() const { return pos_ == len_ && left_ == 0; }
+
+private:
+    FrameSnapshot::Read read_;
+    void *ctx_;
+    size_t left_;
+    uint8_t buf_[256];
+    size_t pos_ = 0;
+    size_t len_ = 0;
+};
+
+} // namespace
+
+void FrameSnapshot::packHeader(const Header &h, uint8_t out[kHeaderBytes]) {
+    memcpy(out, kMagic, 4);
+    put16(out + 4, h.width);
+    put16(out + 6, h.height);
+    put32(out + 8, h.rawBytes);
+    put32(out + 12, h.encodedBytes);
+    put32(out + 16, h.encodeUs);
+    put32(out + 20, h.lastWriteUs);
+}
+
+bool FrameSnapshot::unpackHeader(const uint8_t in[kHeaderBytes], Header &h) {
+    if (memcmp(in, kMagic, 4) != 0) return false;
+    h.width = get16(in + 4);
+    h.height = get16(in + 6);
+    h.rawBytes = get32(in + 8);
+    h.encodedBytes = get32(in + 12);
+    h.encodeUs = get32(in + 16);
+    h.lastWriteUs = get32(in + 20);
+    return h.rawBytes == (uint32_t)h.width * h.height && h.encodedBytes > 0 &&
+           h.encodedBytes <= maxEncoded(h.rawBytes);
+}
+
+size_t FrameSnapshot::encode(const uint8_t *src, size_t n, Write write, void *ctx) {
+    Output out(write, ctx);
+    size_t i = 0, literalStart = 0;
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && run < kMaxRun && src[i + run] == src[i]) run++;
+        if (run >= kMinRun) {
+            putLiterals(out, src + literalStart, i - literalStart);
+            out.put((uint8_t)(0x80 + run - kMinRun));
+            out.put(src[i]);
+            i += run;
+            literalStart = i;
+        } else {
+            i += run;
+        }
+    }
+    putLiterals(out, src + literalStart, n - literalStart);
+    out.flush();
+    return out.total();
+}
+
+bool FrameSnapshot::decode(Read read, void *ctx, size_t encodedBytes, uint8_t *dst, size_t n) {
+    Input in(read, ctx, encodedBytes);
+    size_t done = 0;
+    while (done < n) {
+        int c = in.get();
+        if (c < 0) return false;
+        if (c < 0x80) {
+            size_t count = (size_t)c + 1;
+            if (count > n - done) return false;
+            for (size_t k = 0; k < count; k++) {
+                int b = in.get();
+                if (b < 0) return false;
+                dst[done++] = (uint8_t)b;
+            }
+        } else {
+            size_t count = (size_t)c - 0x80 + kMinRun;
+            int b = in.get();
+            if (b < 0 || count > n - done) return false;
+            memset(dst + done, b, count);
+            done += count;
+        }
+    }
+    return in.exhausted();
+}
+
+bool FrameSnapshot::Reader::read(uint8_t *dst, size_t n) {
+    while (n) {
+        if (!pending_) {
+            if (p_ == end_) return false;
+            const uint8_t c = *p_++;
+            literal_ = c < 0x80;
+            pending_ = literal_ ? (size_t)c + 1 : (size_t)c - 0x80 + kMinRun;
+            if (!literal_) {
+                if (p_ == end_) return false;
+                value_ = *p_++;
+            }
+        }
+        size_t take = pending_ < n ? pending_ : n;
+        if (literal_) {
+            if ((size_t)(end_ - p_) < take) return false;
+            memcpy(dst, p_, take);
+            p_ += take;
+        } else {
+            memset(dst, value_, take);
+        }
+        dst += take;
+        n -= take;
+        pending_ -= take;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef FRAME_SNAPSHOT_H
+#define FRAME_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Run-length coded copy of an 8-bit framebuffer, for restoring the screen
+// after a reset. A text screen is mostly runs of background, so it codes
+// to a fraction of the raw canvas.
+//
+// Stream: a control byte c, then
+//   c < 0x80:  c + 1 literal bytes follow
+//   c >= 0x80: one byte follows, repeated c - 0x80 + kMinRun times
+// Encoding and decoding go through small stack buffers and callbacks, so
+// neither side needs a second framebuffer-sized allocation.
+class FrameSnapshot {
+public:
+    static constexpr uint8_t kMinRun = 3;
+    static constexpr uint16_t kMaxRun = 0x7F + kMinRun;
+    static constexpr uint8_t kMaxLiteral = 0x80;
+    static constexpr size_t kHeaderBytes = 24;
+
+    // Return false to abort.
+    typedef bool (*Write)(void *ctx, const uint8_t *data, size_t len);
+    // Up to len bytes; 0 at end of input.
+    typedef size_t (*Read)(void *ctx, uint8_t *data, size_t len);
+
+    struct Header {
+        uint16_t width;
+        uint16_t height;
+        uint32_t rawBytes;
+        uint32_t encodedBytes;
+        uint32_t encodeUs;   // time to code this snapshot
+        uint32_t lastWriteUs; // cost of the previous snapshot write
+    };
+
+    static void packHeader(const Header &h, uint8_t out[kHeaderBytes]);
+    // False unless the magic matches and the sizes are consistent.
+    static bool unpackHeader(const uint8_t in[kHeaderBytes], Header &h);
+
+    // Returns the coded size; 0 if write failed. write may be null to just
+    // measure.
+    static size_t encode(const uint8_t *src, size_t n, Write write, void *ctx);
+    // Decodes exactly encodedBytes into exactly n bytes; anything else is
+    // a corrupt snapshot and returns false.
+    static bool decode(Read read, void *ctx, size_t encodedBytes, uint8_t *dst, size_t n);
+
+    static size_t maxEncoded(size_t n) { return n + (n + kMaxLiteral - 1) / kMaxLiteral; }
+
+    // Decodes an in-memory stream a piece at a time, carrying runs and
+    // literals across calls, e.g. one image row per read().
+    class Reader {
+    public:
+        Reader(const uint8_t *src, size_t len) : p_(src), end_(src + len) {}
+        // Exactly n bytes into dst; false if the stream is short or corrupt.
+        bool read(uint8_t *dst, size_t n);
+        // All input consumed with nothing left over.
+        bool done() const { return p_ == end_ && !pending_; }
+
+    private:
+        const uint8_t *p_;
+        const uint8_t *end_;
+        size_t pending_ = 0; // bytes left in the current run or literal
+        bool literal_ = false;
+        uint8_t value_ = 0;
+    };
+};
+
+#endif // FRAME_SNAPSHOT_H
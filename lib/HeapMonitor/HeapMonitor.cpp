@@ -0,0 +1,50 @@
+#include "HeapMonitor.h"
+
+void HeapMonitor::addSample(const HeapSample &s) {
+    ring_[next_] = s;
+    next_ = (next_ + 1) % kWindow;
+    if (count_ < kWindow) count_++;
+}
+
+void HeapMonitor::account(uint8_t handler, uint32_t freeBefore, uint32_t freeAfter) {
+    if (handler >= kMaxHandlers) return;
+    HandlerAlloc &h = handlers_[handler];
+    int32_t retained = (int32_t)(freeBefore - freeAfter);
+    h.calls++;
+    h.netBytes += retained;
+    if (retained > h.maxRetained) h.maxRetained = retained;
+}
+
+uint8_t HeapMonitor::fragmentation(const HeapSample &s) {
+    if (s.freeBytes == 0) return 0;
+    return (uint8_t)(100 - (uint64_t)s.largestBlock * 100 / s.freeBytes);
+}
+
+int32_t HeapMonitor::slope(uint32_t HeapSample::*field) const {
+    if (count_ < 2) return 0;
+    // x = 0..n-1 in chronological order.
+    const uint8_t first = (next_ + kWindow - count_) % kWindow;
+    int64_t sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
+    for (uint8_t i = 0; i < count_; i++) {
+        int64_t y = ring_[(first + i) % kWindow].*field;
+        sumX += i;
+        sumY += y;
+        sumXY += i * y;
+        sumXX += i * i;
+    }
+    int64_t den = (int64_t)count_ * sumXX - sumX * sumX;
+    return (int32_t)(((int64_t)count_ * sumXY - sumX * sumY) / den);
+}
+
+int32_t HeapMonitor::freeSlope() const { return slope(&HeapSample::freeBytes); }
+int32_t HeapMonitor::largestSlope() const { return slope(&HeapSample::largestBlock); }
+
+uint8_t HeapMonitor::flags() const {
+    if (count_ == 0) return 0;
+    uint8_t f = 0;
+    if (last().largestBlock < kLowBlockBytes) f |= kFlagLowBlock;
+    if (count_ < kMinTrendSamples) return f;
+    if (fragmentation(last()) >= kFragWarnPct && largestSlope() <= -kShrinkWarnBytes) f |= kFlagFragmenting;
+    if (freeSlope() <= -kShrinkWarnBytes) f |= kFlagLeaking;
+    return f;
+}
@@ -0,0 +1,68 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One reading of the 8-bit-capable heap (heap_caps_get_info on the device).
+struct HeapSample {
+    uint32_t freeBytes;
+    uint32_t largestBlock;
+    uint32_t minFree;     // low-water mark since boot
+    uint32_t allocBlocks; // live allocations
+};
+
+// Long-uptime memory health. Periodic samples go into a ring; the trend over
+// the ring is what matters, since a single reading can't tell steady churn
+// from a slow leak or a heap that is splintering into small holes.
+// Per-handler accounting records what each message handler leaves behind:
+// heap that is still allocated once the handler has returned.
+class HeapMonitor {
+public:
+    static constexpr uint8_t kWindow = 16;
+    static constexpr uint8_t kMaxHandlers = 8;
+    static constexpr uint8_t kMinTrendSamples = 6;
+    static constexpr uint8_t kFragWarnPct = 40;        // 1 - largest/free
+    static constexpr int32_t kShrinkWarnBytes = 256;   // per sample
+    static constexpr uint32_t kLowBlockBytes = 16384;  // JSON docs + MQTT buffer
+
+    enum Flag : uint8_t {
+        kFlagFragmenting = 1 << 0, // largest block shrinking while fragmented
+        kFlagLeaking = 1 << 1,     // free heap shrinking sample over sample
+        kFlagLowBlock = 1 << 2,    // largest block below kLowBlockBytes
+    };
+
+    struct HandlerAlloc {
+        uint32_t calls;
+        int32_t netBytes; // heap still held after the handler returned
+        int32_t maxRetained;
+    };
+
+    void addSample(const HeapSample &s);
+    // Free bytes before and after one call; only the free size is needed,
+    // so callers needn't walk the heap per message.
+    void account(uint8_t handler, uint32_t freeBefore, uint32_t freeAfter);
+
+    uint8_t count() const { return count_; }
+    const HeapSample &last() const { return ring_[(next_ + kWindow - 1) % kWindow]; }
+    static uint8_t fragmentation(const HeapSample &s);
+
+    // Least-squares slope over the window in bytes per sample.
+    int32_t freeSlope() const;
+    int32_t largestSlope() const;
+
+    // Combination of Flag bits for the current window; 0 when healthy.
+    uint8_t flags() const;
+
+    const HandlerAlloc &handler(uint8_t i) const { return handlers_[i]; }
+
+private:
+    int32_t slope(uint32_t HeapSample::*field) const;
+
+    HeapSample ring_[kWindow] = {};
+    uint8_t next_ = 0;
+    uint8_t count_ = 0;
+    HandlerAlloc handlers_[kMaxHandlers] = {};
+};
+
+#endif // HEAP_MONITOR_H
@@ -0,0 +1,107 @@
+#include "IconImage.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const uint8_t kMagic[4] = {'M', '5', 'I', 'C'};
+
+uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+} // namespace
+
+bool IconImage::isImage(const uint8_t *data, size_t len) {
+    return len >= kHeaderBytes && memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+uint32_t IconImage::fnv1a(const uint8_t *data, size_t len, uint32_t h) {
+    while (len--) {
+        h ^= *data++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool IconImage::begin(const uint8_t *data, size_t len) {
+    if (!isImage(data, len)) return false;
+    width_ = get16(data + 4);
+    height_ = get16(data + 6);
+    const size_t colors = (size_t)data[8] + 1;
+    const size_t dataBytes = get16(data + 10);
+    if (!width_ || !height_ || width_ > kMaxWidth || height_ > kMaxHeight || data[9] != 0) return false;
+    const size_t paletteBytes = colors * 3;
+    if (len < kHeaderBytes + paletteBytes + dataBytes) return false;
+
+    const uint8_t *palette = data + kHeaderBytes;
+    memset(lut_, 0, sizeof(lut_)); // out-of-range indices draw black
+    for (size_t i = 0; i < colors; i++) {
+        lut_[i] = rgb332(palette[3 * i], palette[3 * i + 1], palette[3 * i + 2]);
+    }
+    const uint8_t *pixels = palette + paletteBytes;
+    hash_ = fnv1a(data + 4, kHeaderBytes - 4 + paletteBytes + dataBytes);
+    reader_ = FrameSnapshot::Reader(pixels, dataBytes);
+    caption_ = (const char *)(pixels + dataBytes);
+    captionLen_ = len - (kHeaderBytes + paletteBytes + dataBytes);
+    row_ = 0;
+    return true;
+}
+
+bool IconImage::nextRow(uint8_t *out) {
+    if (row_ == height_ || !reader_.read(out, width_)) return false;
+    for (uint16_t x = 0; x < width_; x++) out[x] = lut_[out[x]];
+    row_++;
+    return true;
+}
+
+const uint8_t *IconCache::find(uint32_t hash, uint16_t &width, uint16_t &height) {
+    for (uint8_t i = 0; i < count_; i++) {
+        Entry &e = entries_[i];
+        if (e.hash != hash) continue;
+        e.lastUse = ++clock_;
+        width = e.width;
+        height = e.height;
+        hits_++;
+        return e.pixels;
+    }
+    misses_++;
+    return nullptr;
+}
+
+uint8_t *IconCache::insert(uint32_t hash, uint16_t width, uint16_t height) {
+    const size_t need = (size_t)width * height;
+    if (!need || need > budget_) return nullptr;
+    remove(hash);
+    while (count_ && (count_ == kMaxIcons || bytes_ + need > budget_)) {
+        uint8_t oldest = 0;
+        for (uint8_t i = 1; i < count_; i++) {
+            if (entries_[i].lastUse < entries_[oldest].lastUse) oldest = i;
+        }
+        drop(oldest);
+        evictions_++;
+    }
+    uint8_t *pixels = (uint8_t *)malloc(need);
+    if (!pixels) return nullptr;
+    entries_[count_++] = {hash, width, height, ++clock_, pixels};
+    bytes_ += need;
+    return pixels;
+}
+
+void IconCache::remove(uint32_t hash) {
+    for (uint8_t i = 0; i < count_; i++) {
+        if (entries_[i].hash == hash) {
+            drop(i);
+            return;
+        }
+    }
+}
+
+void IconCache::clear() {
+    while (count_) drop(count_ - 1);
+}
+
+void IconCache::drop(uint8_t i) {
+    bytes_ -= (size_t)entries_[i].width * entries_[i].height;
+    free(entries_[i].pixels);
+    entries_[i] = entries_[--count_];
+}
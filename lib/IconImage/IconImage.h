@@ -0,0 +1,106 @@
+#ifndef ICON_IMAGE_H
+#define ICON_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FrameSnapshot.h"
+
+// Compact image message: a small palette image, decoded one row at a time
+// into the 8-bit (RGB332) canvas, with an optional caption.
+//
+//   "M5IC"                magic
+//   u16 width, u16 height (little-endian, at most kMaxWidth x kMaxHeight)
+//   u8  colors - 1        palette entries (1..256)
+//   u8  flags             0; reserved
+//   u16 dataBytes         length of the pixel stream
+//   colors x RGB888       palette
+//   dataBytes             palette indices, row-major, coded as FrameSnapshot
+//                         runs and literals
+//   rest                  UTF-8 caption (may be empty)
+//
+// begin() only checks the header and converts the palette; nextRow()
+// decodes straight out of the payload, so no bitmap is ever built.
+class IconImage {
+public:
+    static constexpr size_t kHeaderBytes = 12;
+    static constexpr uint16_t kMaxWidth = 128;
+    static constexpr uint16_t kMaxHeight = 128;
+
+    static bool isImage(const uint8_t *data, size_t len);
+
+    // False if the header is malformed or the payload is short.
+    bool begin(const uint8_t *data, size_t len);
+
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+    // FNV-1a over size, palette and pixel stream: equal images, equal hash.
+    uint32_t hash() const { return hash_; }
+    const char *caption() const { return caption_; }
+    size_t captionLen() const { return captionLen_; }
+
+    // The next row as width() RGB332 pixels. False when the rows are done
+    // or the stream is corrupt.
+    bool nextRow(uint8_t *out);
+    // Every row read and the stream used up exactly.
+    bool complete() const { return row_ == height_ && reader_.done(); }
+
+    static uint8_t rgb332(uint8_t r, uint8_t g, uint8_t b) { return (r & 0xE0) | ((g & 0xE0) >> 3) | (b >> 6); }
+    static uint32_t fnv1a(const uint8_t *data, size_t len, uint32_t h = 2166136261u);
+
+private:
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    uint16_t row_ = 0;
+    uint32_t hash_ = 0;
+    const char *caption_ = nullptr;
+    size_t captionLen_ = 0;
+    uint8_t lut_[256];
+    FrameSnapshot::Reader reader_{nullptr, 0};
+};
+
+// Decoded icons (canvas-native pixels) by content hash, least recently used
+// evicted first, within a byte budget. A repeated icon is one copy into the
+// canvas instead of a decode.
+class IconCache {
+public:
+    static constexpr uint8_t kMaxIcons = 8;
+
+    explicit IconCache(size_t budgetBytes) : budget_(budgetBytes) {}
+    ~IconCache() { clear(); }
+
+    // Pixels for hash, or null. A hit makes it the most recently used.
+    const uint8_t *find(uint32_t hash, uint16_t &width, uint16_t &height);
+    // A width x height slot under hash, evicting to make room; the caller
+    // fills it. Null if it can't fit the budget or the heap.
+    uint8_t *insert(uint32_t hash, uint16_t width, uint16_t height);
+    // Drop an entry, e.g. after a decode failed half way.
+    void remove(uint32_t hash);
+    void clear();
+
+    uint8_t size() const { return count_; }
+    size_t bytes() const { return bytes_; }
+    uint32_t hits() const { return hits_; }
+    uint32_t misses() const { return misses_; }
+    uint32_t evictions() const { return evictions_; }
+
+private:
+    struct Entry {
+        uint32_t hash;
+        uint16_t width;
+        uint16_t height;
+        uint32_t lastUse;
+        uint8_t *pixels;
+    };
+    void drop(uint8_t i);
+
+    size_t budget_;
+    Entry entries_[kMaxIcons] = {};
+    uint8_t count_ = 0;
+    size_t bytes_ = 0;
+    uint32_t clock_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
+};
+
+#endif // ICON_IMAGE_H
@@ -0,0 +1,63 @@
+#include "CpuGovernor.h"
+
+#include <esp_timer.h>
+
+void CpuGovernor::begin(uint16_t lowMhz, uint16_t highMhz, bool usePmLock, bool enabled) {
+    lowMhz_ = lowMhz;
+    highMhz_ = highMhz;
+    enabled_ = enabled;
+    usePmLock_ = usePmLock &&
+                 esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &boostLock_) == ESP_OK;
+    levelSince_ = esp_timer_get_time();
+    // Start boosted: boot work (connect, first render) wants the high clock.
+    level_ = kLow;
+    setLevel(kHigh);
+    switches_ = 0;
+}
+
+void CpuGovernor::setLevel(Level level) {
+    if (level == level_) return;
+    int64_t now = esp_timer_get_time();
+    residencyUs_[level_] += now - levelSince_;
+    levelSince_ = now;
+    level_ = level;
+    switches_++;
+    if (usePmLock_) {
+        if (level == kHigh) esp_pm_lock_acquire(boostLock_);
+        else                esp_pm_lock_release(boostLock_);
+    } else {
+        setCpuFrequencyMhz(level == kHigh ? highMhz_ : lowMhz_);
+    }
+}
+
+void CpuGovernor::boost(Reason reason, uint32_t nowMs) {
+    boosts_[reason]++;
+    holdUntil_ = nowMs + kHoldMs;
+    setLevel(kHigh);
+}
+
+bool CpuGovernor::relax(uint32_t nowMs) {
+    if (!enabled_ || level_ == kLow || (int32_t)(nowMs - holdUntil_) < 0) return false;
+    setLevel(kLow);
+    return true;
+}
+
+uint32_t CpuGovernor::holdRemaining(uint32_t nowMs) const {
+    int32_t left = (int32_t)(holdUntil_ - nowMs);
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+uint64_t CpuGovernor::residencyUs(Level level) const {
+    uint64_t us = residencyUs_[level];
+    if (level == level_) us += esp_timer_get_time() - levelSince_;
+    return us;
+}
+
+const char *CpuGovernor::reasonName(Reason reason) {
+    switch (reason) {
+    case kIngress: return "ingress";
+    case kConnect: return "connect";
+    case kRender:  return "render";
+    default:       return "?";
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CPU_GOVERNOR_H
+#define CPU_GOVERNOR_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include "StageProfiler.h"
+
+// Two-level CPU clock governor. The device idles at the low clock and is
+// boosted to the high clock when work lands: a packet on the socket, a
+// (TLS) connect, or a render. Every boost extends a hold of kHoldMs, so a
+// burst of messages doesn't toggle the clock on each one.
+//
+// With esp_pm active the boost is an ESP_PM_CPU_FREQ_MAX lock and DFS does
+// the switching; otherwise the clock is set directly with
+// setCpuFrequencyMhz().
+class CpuGovernor {
+public:
+    enum Reason : uint8_t { kIngress, kConnect, kRender, kReasonCount };
+    enum Level : uint8_t { kLow, kHigh, kLevelCount };
+
+    static constexpr uint32_t kHoldMs = 250;
+
+    // enabled=false pins the high clock (baseline for comparison).
+    void begin(uint16_t lowMhz, uint16_t highMhz, bool usePmLock, bool enabled);
+
+    // Run at the high clock for at least kHoldMs from nowMs.
+    void boost(Reason reason, uint32_t nowMs);
+    // Drop to the low clock if the hold has expired; true if it dropped.
+    bool relax(uint32_t nowMs);
+
+    bool boosted() const { return level_ == kHigh; }
+    uint32_t holdRemaining(uint32_t nowMs) const;
+
+    // Per-message latency, bucketed by the level it ran at.
+    void recordLatency(uint32_t us) { latency_[level_].record(us); }
+
+    uint16_t mhz(Level level) const { return level == kHigh ? highMhz_ : lowMhz_; }
+    uint64_t residencyUs(Level level) const;
+    uint32_t boosts(Reason reason) const { return boosts_[reason]; }
+    uint32_t switches() const { return switches_; }
+    const LatencyHistogram &latency(Level level) const { return latency_[level]; }
+    static const char *reasonName(Reason reason);
+
+private:
+    void setLevel(Level level);
+
+    uint16_t lowMhz_ = 80;
+    uint16_t highMhz_ = 240;
+    bool usePmLock_ = false;
+    bool enabled_ = true;
+    esp_pm_lock_handle_t boostLock_ = nullptr;
+    Level level_ = kHigh;
+    uint32_t holdUntil_ = 0;
+    int64_t levelSince_ = 0;
+    uint64_t residencyUs_[kLevelCount] = {};
+    uint32_t boosts_[kReasonCount] = {};
+    uint32_t switches_ = 0;
+    LatencyHistogram latency_[kLevelCount];
+};
+
+#endif // CPU_GOVERNOR_H
@@ -0,0 +1,85 @@
+#include "PowerManager.h"
+
+#include <WiFi.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include "AsyncLog.h"
+
+void PowerManager::begin(const Config &config) {
+    config_ = config;
+    mark_ = esp_timer_get_time();
+
+#if CONFIG_PM_ENABLE
+    // Dynamic frequency scaling between min and max, plus light sleep if
+    // requested and the core has tickless idle; retry without it if not.
+    esp_pm_config_esp32_t pm = {};
+    pm.max_freq_mhz = config_.maxFreqMhz;
+    pm.min_freq_mhz = config_.minFreqMhz;
+    pm.light_sleep_enable = config_.lightSleep;
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK && config_.lightSleep) {
+        LOGW("power: light sleep unavailable (%s); modem sleep only", esp_err_to_name(err));
+        pm.light_sleep_enable = false;
+        err = esp_pm_configure(&pm);
+    }
+    pmActive_ = (err == ESP_OK);
+    if (pmActive_ && pm.light_sleep_enable) {
+        lightSleep_ = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "screen", &noSleepLock_) == ESP_OK;
+    }
+#else
+    if (config_.lightSleep) LOGW("power: core built without CONFIG_PM_ENABLE; modem sleep only");
+#endif
+
+    if (lightSleep_) {
+        for (uint8_t i = 0; i < config_.wakePinCount; i++) {
+            gpio_wakeup_enable(config_.wakePins[i], GPIO_INTR_LOW_LEVEL);
+        }
+        esp_sleep_enable_gpio_wakeup();
+        // The screen starts lit.
+        esp_pm_lock_acquire(noSleepLock_);
+        noSleepHeld_ = true;
+    }
+    LOGI("power: %s, listen interval %u", modeName(), config_.listenInterval);
+}
+
+void PowerManager::onWifiConnected() {
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK &&
+        conf.sta.listen_interval != config_.listenInterval) {
+        conf.sta.listen_interval = config_.listenInterval;
+        esp_wifi_set_config(WIFI_IF_STA, &conf);
+    }
+    // MAX_MODEM honours listen_interval; MIN_MODEM would wake every DTIM.
+    WiFi.setSleep(config_.listenInterval > 1 ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+}
+
+void PowerManager::allowLightSleep(bool allow) {
+    if (!lightSleep_ || allow == !noSleepHeld_) return;
+    if (allow) esp_pm_lock_release(noSleepLock_);
+    else       esp_pm_lock_acquire(noSleepLock_);
+    noSleepHeld_ = !allow;
+}
+
+void PowerManager::idleBegin() {
+    int64_t now = esp_timer_get_time();
+    stats_.awakeUs += now - mark_;
+    mark_ = now;
+    idle_ = true;
+}
+
+void PowerManager::idleEnd() {
+    if (!idle_) return;
+    int64_t now = esp_timer_get_time();
+    uint64_t slept = now - mark_;
+    stats_.idleUs += slept;
+    if (lightSleepAllowed()) stats_.darkIdleUs += slept;
+    stats_.wakeups++;
+    mark_ = now;
+    idle_ = false;
+}
+
+const char *PowerManager::modeName() const {
+    if (!lightSleep_) return "modem-sleep";
+    return noSleepHeld_ ? "light-sleep (held)" : "light-sleep";
+}
@@ -0,0 +1,76 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <driver/gpio.h>
+#include "StageProfiler.h"
+
+// Idle power policy:
+//  - Wi-Fi power save with a listen interval, so the radio sleeps through
+//    beacons and wakes on DTIM-aligned intervals to check for buffered data.
+//  - Automatic light sleep via esp_pm when the core was built with PM and
+//    tickless idle. FreeRTOS then light-sleeps whenever every task is
+//    blocked: loop() in select() until socket data or its next timer,
+//    with BtnA/BtnB as GPIO wake sources. Without that support the CPU just
+//    idles in the same select() (modem sleep only).
+//  - Light sleep stops the LEDC backlight PWM, so it is only allowed while
+//    the screen is dark.
+class PowerManager {
+public:
+    static constexpr uint8_t kMaxWakePins = 3;
+
+    struct Config {
+        uint8_t listenInterval; // beacon intervals between radio wakeups
+        bool lightSleep;        // try automatic light sleep
+        uint16_t maxFreqMhz;
+        uint16_t minFreqMhz;
+        gpio_num_t wakePins[kMaxWakePins]; // active-low buttons
+        uint8_t wakePinCount;
+    };
+
+    struct Stats {
+        uint64_t idleUs;     // blocked waiting for work
+        uint64_t darkIdleUs; // ... with light sleep allowed
+        uint64_t awakeUs;    // running loop() work
+        uint32_t wakeups;
+    };
+
+    void begin(const Config &config);
+
+    // Apply Wi-Fi power save. listen_interval is negotiated at association,
+    // so call this once connected; the interval takes effect from the next
+    // (re)association.
+    void onWifiConnected();
+
+    // Gate light sleep on the screen being dark.
+    void allowLightSleep(bool allow);
+
+    // Bracket the loop's idle wait for residency accounting.
+    void idleBegin();
+    void idleEnd();
+
+    // Socket wake to notification on the panel.
+    void recordWakeLatency(uint32_t us) { wakeLatency_.record(us); }
+
+    // esp_pm is managing the clock (DFS between min and max).
+    bool pmActive() const { return pmActive_; }
+    bool lightSleepEnabled() const { return lightSleep_; }
+    bool lightSleepAllowed() const { return lightSleep_ && !noSleepHeld_; }
+    const Stats &stats() const { return stats_; }
+    const LatencyHistogram &wakeLatency() const { return wakeLatency_; }
+    const char *modeName() const;
+
+private:
+    Config config_ = {};
+    bool pmActive_ = false;
+    bool lightSleep_ = false;
+    bool noSleepHeld_ = false;
+    esp_pm_lock_handle_t noSleepLock_ = nullptr;
+    int64_t mark_ = 0;
+    bool idle_ = false;
+    Stats stats_ = {};
+    LatencyHistogram wakeLatency_;
+};
+
+#endif // POWER_MANAGER_H
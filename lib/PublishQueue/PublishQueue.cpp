@@ -0,0 +1,106 @@
+#include "PublishQueue.h"
+
+#include <string.h>
+
+PublishQueue::PublishQueue(PublishFn publish) : publish_(publish) {
+    for (Slot &s : slots_) {
+        s.state = kFree;
+    }
+}
+
+PublishQueue::Slot *PublishQueue::oldest(SlotState state) {
+    Slot *best = nullptr;
+    for (Slot &s : slots_) {
+        if (s.state == state && (!best || (int32_t)(s.order - best->order) < 0)) {
+            best = &s;
+        }
+    }
+    return best;
+}
+
+size_t PublishQueue::count(SlotState state) const {
+    size_t n = 0;
+    for (const Slot &s : slots_) {
+        if (s.state == state) n++;
+    }
+    return n;
+}
+
+size_t PublishQueue::queued() const { return count(kQueued); }
+
+size_t PublishQueue::inFlight() const { return count(kInFlight); }
+
+bool PublishQueue::enqueue(const char *topic, const char *payload, size_t len, bool replace) {
+    if (strlen(topic) >= kMaxTopic || len > kMaxPayload) {
+        stats_.dropped++;
+        return false;
+    }
+
+    Slot *slot = nullptr;
+    if (replace) {
+        for (Slot &s : slots_) {
+            if (s.state == kQueued && strcmp(s.topic, topic) == 0) {
+                slot = &s;
+                stats_.replaced++;
+                break;
+            }
+        }
+    }
+    if (!slot) {
+        for (Slot &s : slots_) {
+            if (s.state == kFree) {
+                slot = &s;
+                break;
+            }
+        }
+    }
+    if (!slot) {
+        slot = oldest(kQueued);
+        if (!slot) {
+            // Everything is in flight; the new message loses.
+            stats_.dropped++;
+            return false;
+        }
+        stats_.dropped++;
+    }
+
+    strcpy(slot->topic, topic);
+    memcpy(slot->payload, payload, len);
+    slot->len = len;
+    slot->state = kQueued;
+    slot->order = nextOrder_++;
+    stats_.enqueued++;
+    return true;
+}
+
+size_t PublishQueue::flush(bool connected, uint32_t nowMs) {
+    if (!connected) return 0;
+
+    for (Slot &s : slots_) {
+        if (s.state == kInFlight && nowMs - s.sentAt >= kSettleMs) {
+            s.state = kFree;
+            stats_.confirmed++;
+        }
+    }
+
+    size_t sent = 0;
+    while (Slot *s = oldest(kQueued)) {
+        if (!publish_(s->topic, s->payload, s->len)) {
+            break; // socket trouble; keep order and retry next flush
+        }
+        s->state = kInFlight;
+        s->sentAt = nowMs;
+        stats_.published++;
+        sent++;
+    }
+    return sent;
+}
+
+void PublishQueue::onDisconnect() {
+    for (Slot &s : slots_) {
+        if (s.state == kInFlight) {
+            s.state = kQueued;
+            stats_.retransmits++;
+        }
+    }
+}
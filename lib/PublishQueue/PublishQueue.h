@@ -0,0 +1,74 @@
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bounded outbound queue in front of mqttClient.publish(). Producers enqueue
+// at any time; flush() sends while the link is already up, so receipts and
+// telemetry ride on radio activity that is happening anyway.
+//
+// PubSubClient only publishes at QoS 0 and never surfaces PUBACKs, so QoS 1
+// semantics are approximated at the application level: a published entry
+// stays "in flight" until the connection has survived kSettleMs after the
+// write. If the connection drops first, onDisconnect() puts it back in the
+// queue and it is sent again. Payloads carry a sequence number so consumers
+// can drop the resulting duplicates.
+class PublishQueue {
+public:
+    typedef bool (*PublishFn)(const char *topic, const uint8_t *payload, size_t len);
+
+    static constexpr size_t kSlots = 4;
+    static constexpr size_t kMaxTopic = 64;
+    static constexpr size_t kMaxPayload = 1024;
+    static constexpr uint32_t kSettleMs = 3000;
+
+    struct Stats {
+        uint32_t enqueued;
+        uint32_t published;
+        uint32_t confirmed;
+        uint32_t retransmits;
+        uint32_t dropped;
+        uint32_t replaced;
+    };
+
+    explicit PublishQueue(PublishFn publish);
+
+    // Copy a message into the queue. With replace=true a still-queued message
+    // on the same topic is overwritten instead (latest telemetry wins). When
+    // full, the oldest queued (not in-flight) entry is dropped.
+    bool enqueue(const char *topic, const char *payload, size_t len, bool replace = false);
+
+    // Send queued entries in FIFO order and retire in-flight ones that have
+    // settled. Does nothing while disconnected. Returns entries sent.
+    size_t flush(bool connected, uint32_t nowMs);
+
+    // Link dropped: anything in flight is re-queued for retransmission.
+    void onDisconnect();
+
+    size_t queued() const;
+    size_t inFlight() const;
+    const Stats &stats() const { return stats_; }
+
+private:
+    enum SlotState : uint8_t { kFree, kQueued, kInFlight };
+
+    struct Slot {
+        SlotState state;
+        uint32_t order;
+        uint32_t sentAt;
+        uint16_t len;
+        char topic[kMaxTopic];
+        uint8_t payload[kMaxPayload];
+    };
+
+    Slot *oldest(SlotState state);
+    size_t count(SlotState state) const;
+
+    PublishFn publish_;
+    Slot slots_[kSlots];
+    uint32_t nextOrder_ = 0;
+    Stats stats_ = {};
+};
+
+#endif // PUBLISH_QUEUE_H
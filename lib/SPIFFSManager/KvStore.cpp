@@ -0,0 +1,192 @@
+#include "KvStore.h"
+#include "AsyncLog.h"
+
+namespace {
+
+// Nibble-wise CRC32 (same polynomial as gzip), 64-byte table.
+const uint32_t kCrcNibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+uint32_t crc32(uint32_t crc, const uint8_t *p, size_t n) {
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ kCrcNibble[crc & 0x0F];
+        crc = (crc >> 4) ^ kCrcNibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+} // namespace
+
+KvStore::KvStore(SPIFFSManager &spiffs, const char *path, const char *tmpPath)
+    : spiffs_(spiffs), path_(path), tmpPath_(tmpPath) {}
+
+size_t KvStore::encode(uint8_t *out, Op op, const char *key, size_t keyLen, const char *value, size_t valueLen) {
+    out[0] = kMagic;
+    // CRC (bytes 1..4) covers op, lengths, key and value.
+    out[5] = op;
+    out[6] = (uint8_t)keyLen;
+    out[7] = (uint8_t)(valueLen & 0xFF);
+    out[8] = (uint8_t)(valueLen >> 8);
+    memcpy(out + kHeader, key, keyLen);
+    memcpy(out + kHeader + keyLen, value, valueLen);
+    const size_t len = recordSize(keyLen, valueLen);
+    uint32_t crc = crc32(0, out + 5, len - 5);
+    memcpy(out + 1, &crc, 4);
+    return len;
+}
+
+bool KvStore::begin() {
+    entries_.clear();
+    fileBytes_ = liveBytes_ = 0;
+    readOnly_ = false;
+    fs::FS &fs = spiffs_.fs();
+    if (spiffs_.fileExists(tmpPath_)) fs.remove(tmpPath_); // compaction that never finished
+
+    if (spiffs_.fileSize(path_) < 0) return true; // empty store
+    File file = fs.open(path_, "r");
+    if (!file) return true;
+    const size_t size = file.size();
+    size_t offset = 0;
+    uint8_t header[kHeader];
+    char key[kMaxKey + 1];
+    char value[kMaxValue + 1];
+    while (offset < size) {
+        if (file.read(header, kHeader) != kHeader || header[0] != kMagic) break;
+        const uint8_t op = header[5];
+        const size_t keyLen = header[6];
+        const size_t valueLen = header[7] | (header[8] << 8);
+        if (keyLen == 0 || keyLen > kMaxKey || valueLen > kMaxValue || (op != kPut && op != kRemove)) break;
+        if (file.read((uint8_t *)key, keyLen) != keyLen) break;
+        if (file.read((uint8_t *)value, valueLen) != valueLen) break;
+        uint32_t stored;
+        memcpy(&stored, header + 1, 4);
+        uint32_t crc = crc32(0, header + 5, kHeader - 5);
+        crc = crc32(crc, (const uint8_t *)key, keyLen);
+        crc = crc32(crc, (const uint8_t *)value, valueLen);
+        if (crc != stored) break;
+        key[keyLen] = '\0';
+        value[valueLen] = '\0';
+        apply((Op)op, key, value);
+        offset += recordSize(keyLen, valueLen);
+    }
+    file.close();
+    fileBytes_ = offset;
+
+    if (offset < size) {
+        badRecords_++;
+        LOGW("kv: %s has %u bad bytes at %u, compacting", path_, (unsigned)(size - offset), (unsigned)offset);
+        // Records appended after the bad bytes would never be replayed.
+        readOnly_ = !compact();
+        return !readOnly_;
+    }
+    LOGI("kv: %u keys, %u of %u bytes live", (unsigned)entries_.size(), (unsigned)liveBytes_, (unsigned)fileBytes_);
+    return true;
+}
+
+int KvStore::find(const char *key) const {
+    for (size_t i = 0; i < entries_.size(); i++) {
+        if (entries_[i].key == key) return (int)i;
+    }
+    return -1;
+}
+
+void KvStore::apply(Op op, const char *key, const char *value) {
+    const int i = find(key);
+    if (i >= 0) {
+        liveBytes_ -= recordSize(entries_[i].key.length(), entries_[i].value.length());
+        if (op == kRemove) {
+            entries_.erase(entries_.begin() + i);
+            return;
+        }
+        entries_[i].value = value;
+    } else {
+        if (op == kRemove) return;
+        entries_.push_back(Entry{String(key), String(value)});
+    }
+    liveBytes_ += recordSize(strlen(key), strlen(value));
+}
+
+bool KvStore::get(const char *key, String &value) const {
+    const int i = find(key);
+    if (i < 0) return false;
+    value = entries_[i].value;
+    return true;
+}
+
+bool KvStore::append(Op op, const char *key, const char *value) {
+    if (readOnly_) {
+        LOGW("kv: %s is read-only until it is compacted", path_);
+        return false;
+    }
+    const size_t keyLen = strlen(key);
+    const size_t valueLen = strlen(value);
+    if (keyLen == 0 || keyLen > kMaxKey || valueLen > kMaxValue) {
+        LOGW("kv: key or value too long");
+        return false;
+    }
+    uint8_t record[kHeader + kMaxKey + kMaxValue];
+    const size_t len = encode(record, op, key, keyLen, value, valueLen);
+
+    File file = spiffs_.fs().open(path_, FILE_APPEND);
+    if (!file) {
+        LOGW("kv: failed to open %s", path_);
+        return false;
+    }
+    const size_t written = file.write(record, len);
+    file.close(); // commit
+    if (written != len) {
+        // A partial record fails its CRC on the next begin() and is dropped.
+        LOGW("kv: append failed");
+        return false;
+    }
+    fileBytes_ += len;
+    appends_++;
+    apply(op, key, value);
+    return true;
+}
+
+bool KvStore::put(const char *key, const char *value) {
+    const int i = find(key);
+    if (i >= 0 && entries_[i].value == value) return true;
+    return append(kPut, key, value);
+}
+
+bool KvStore::remove(const char *key) {
+    if (find(key) < 0) return true;
+    return append(kRemove, key, "");
+}
+
+bool KvStore::compact() {
+    fs::FS &fs = spiffs_.fs();
+    File file = fs.open(tmpPath_, FILE_WRITE);
+    if (!file) {
+        LOGW("kv: failed to open %s", tmpPath_);
+        return false;
+    }
+    uint8_t record[kHeader + kMaxKey + kMaxValue];
+    size_t total = 0;
+    bool ok = true;
+    for (const Entry &e : entries_) {
+        const size_t len = encode(record, kPut, e.key.c_str(), e.key.length(), e.value.c_str(), e.value.length());
+        if (file.write(record, len) != len) {
+            ok = false;
+            break;
+        }
+        total += len;
+    }
+    file.close();
+    if (!ok || !fs.rename(tmpPath_, path_)) {
+        LOGW("kv: compaction failed");
+        fs.remove(tmpPath_);
+        return false;
+    }
+    LOGI("kv: compacted %u -> %u bytes", (unsigned)fileBytes_, (unsigned)total);
+    fileBytes_ = total;
+    liveBytes_ = total;
+    compactions_++;
+    readOnly_ = false;
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "SPIFFSManager.h"
+
+// Small log-structured key-value store on the SPIFFSManager filesystem.
+// Every put/remove appends one CRC-checked record, written in a single
+// write and committed when the file is closed; begin() replays the log into
+// an in-RAM index, so reads never touch flash. Superseded records are
+// dropped by compact(), which writes the live set to a temporary file and
+// renames it over the log (LittleFS rename replaces atomically).
+//
+// Record: magic, op, key length, value length (LE16), CRC32 of everything
+// after the CRC field, key, value.
+class KvStore {
+public:
+    static constexpr uint8_t kMaxKey = 64;
+    static constexpr uint16_t kMaxValue = 512;
+    static constexpr size_t kCompactMinBytes = 4096;
+
+    KvStore(SPIFFSManager &spiffs, const char *path, const char *tmpPath);
+
+    // Replays the log. A corrupt or torn tail is dropped and the log is
+    // compacted straight away so later appends stay readable. If that
+    // compaction fails, returns false and the store is read-only (put and
+    // remove fail) until a compact() succeeds.
+    bool begin();
+
+    bool get(const char *key, String &value) const;
+    bool contains(const char *key) const { return find(key) >= 0; }
+    // No-op (and no write) if the value is unchanged.
+    bool put(const char *key, const char *value);
+    bool remove(const char *key);
+
+    // fn(key, value) for every key starting with prefix.
+    template <typename F>
+    void forEach(const char *prefix, F fn) const {
+        const size_t n = strlen(prefix);
+        for (const Entry &e : entries_) {
+            if (strncmp(e.key.c_str(), prefix, n) == 0) fn(e.key.c_str(), e.value.c_str());
+        }
+    }
+
+    // At least kCompactMinBytes of log, over half of it dead; or a bad tail
+    // still to be cut off.
+    bool needsCompaction() const {
+        return readOnly_ || (fileBytes_ >= kCompactMinBytes && liveBytes_ * 2 < fileBytes_);
+    }
+    bool compact();
+    bool readOnly() const { return readOnly_; }
+
+    size_t size() const { return entries_.size(); }
+    size_t fileBytes() const { return fileBytes_; }
+    size_t liveBytes() const { return liveBytes_; }
+    uint32_t appends() const { return appends_; }
+    uint32_t compactions() const { return compactions_; }
+    uint32_t badRecords() const { return badRecords_; }
+
+private:
+    enum Op : uint8_t { kPut = 1, kRemove = 2 };
+    static constexpr uint8_t kMagic = 0xA5;
+    static constexpr size_t kHeader = 9;
+
+    struct Entry {
+        String key;
+        String value;
+    };
+
+    static size_t recordSize(size_t keyLen, size_t valueLen) { return kHeader + keyLen + valueLen; }
+    static size_t encode(uint8_t *out, Op op, const char *key, size_t keyLen, const char *value, size_t valueLen);
+    int find(const char *key) const;
+    bool append(Op op, const char *key, const char *value);
+    void apply(Op op, const char *key, const char *value);
+
+    SPIFFSManager &spiffs_;
+    const char *path_;
+    const char *tmpPath_;
+    std::vector<Entry> entries_;
+    size_t fileBytes_ = 0;
+    size_t liveBytes_ = 0;
+    uint32_t appends_ = 0;
+    uint32_t compactions_ = 0;
+    uint32_t badRecords_ = 0;
+    bool readOnly_ = false; // log has a bad tail that appends would follow
+};
+
+#endif // KV_STORE_H
@@ -1,239 +1,175 @@
 #include "SPIFFSManager.h"
+#include "AsyncLog.h"
 
-SPIFFSManager::SPIFFSManager(fs::FS &fs) : fs_(fs) {}
+#include <sys/stat.h>
+
+SPIFFSManager::SPIFFSManager(fs::FS &fs, const char *mountPoint) : fs_(fs), mountPoint_(mountPoint) {}
 
 SPIFFSManager::~SPIFFSManager() {}
 
 void SPIFFSManager::listDir(const char *dirname, uint8_t levels) {
-    Serial.printf("Listing directory: %s\r\n", dirname);
+    LOGI("Listing directory: %s", dirname);
 
     File root = fs_.open(dirname);
     if (!root) {
-        Serial.println("- failed to open directory");
+        LOGW("- failed to open directory");
         return;
     }
     if (!root.isDirectory()) {
-        Serial.println(" - not a directory");
+        LOGW(" - not a directory");
         return;
     }
 
     File file = root.openNextFile();
     while (file) {
         if (file.isDirectory()) {
-            Serial.print("  DIR : ");
-            Serial.println(file.name());
+            LOGI("  DIR : %s", file.name());
             if (levels) {
                 listDir(file.path(), levels - 1);
             }
         } else {
-            Serial.print("  FILE: ");
-            Serial.print(file.name());
-            Serial.print("\tSIZE: ");
-            Serial.println(file.size());
+            LOGI("  FILE: %s\tSIZE: %u", file.name(), (unsigned)file.size());
         }
         file = root.openNextFile();
     }
 }
 
 String SPIFFSManager::readFile(const char *path) {
-    Serial.printf("Reading file: %s\r\n", path);
+    LOGD("Reading file: %s", path);
     String fileContent = "";
 
-    // First, check if path exists and is really a file
-    if (!fs_.exists(path)) {
-        Serial.println("- path does not exist");
+    long fileSize = this->fileSize(path);
+    if (fileSize < 0) {
+        LOGW("- path does not exist or is a directory");
         return fileContent;
     }
-
-    File file = fs_.open(path, "r");
-    if (!file) {
-        Serial.println("- failed to open file for reading (file object is null)");
+    if (fileSize == 0) {
+        LOGW("- warning: file is empty");
         return fileContent;
     }
 
-    if (file.isDirectory()) {
-        Serial.println("- failed to open file for reading (path is a directory)");
-        file.close();
+    File file = fs_.open(path, "r");
+    if (!file) {
+        LOGW("- failed to open file for reading (file object is null)");
         return fileContent;
     }
 
-    size_t fileSize = file.size();
-    Serial.printf("- file opened successfully, size: %d bytes\n", fileSize);
-
-    if (fileSize == 0) {
-        Serial.println("- warning: file is empty");
+    // One allocation up front; the chunks below then append in place.
+    if (!fileContent.reserve(fileSize)) {
+        LOGW("- out of memory for %ld bytes", fileSize);
         file.close();
         return fileContent;
     }
-
-    // Read the file in chunks
     uint8_t buf[128];
-    while (file.available()) {
-        size_t bytesRead = file.read(buf, sizeof(buf));
-        if (bytesRead > 0) {
-            fileContent += String((char*)buf, bytesRead);
-        }
+    size_t bytesRead;
+    while ((bytesRead = file.read(buf, sizeof(buf))) > 0) {
+        fileContent.concat((const char *)buf, bytesRead);
     }
 
-    Serial.printf("- read %d bytes from file\n", fileContent.length());
-    Serial.printf("- content: '%s'\n", fileContent.c_str());
-    
+    LOGD("- read %u bytes from file", fileContent.length());
+
     file.close();
     return fileContent;
 }
 
-// String SPIFFSManager::readFile2(const char *path) {
-//     Serial.printf("Reading file: %s\r\n", path);
-//     String fileContent = "";
-
-//     File file = fs_.open(path);
-//     if (!file || file.isDirectory()) {
-//         Serial.println("- failed to open file for reading");
-//         return fileContent;
-//     }
-
-//     Serial.println("- read from file:");
-//     while (file.available()) {
-//         fileContent += (char)file.read();
-//     }
-//     Serial.println(fileContent);
-//     file.close();
-    
-//     return fileContent;
-// }
-
-bool SPIFFSManager::fileExists(const char *path) {
-    Serial.printf("Checking if file exists: %s\r\n", path);
-    
-    if (!fs_.exists(path)) {
-        Serial.println("- path does not exist");
+bool SPIFFSManager::readInto(const char *path, uint8_t *buf, size_t cap, size_t &len) {
+    len = 0;
+    long fileSize = this->fileSize(path);
+    if (fileSize < 0) {
+        LOGD("- %s does not exist", path);
+        return false;
+    }
+    if ((size_t)fileSize > cap) {
+        LOGW("- %s is %ld bytes, buffer holds %u", path, fileSize, (unsigned)cap);
         return false;
     }
-
     File file = fs_.open(path, "r");
     if (!file) {
-        Serial.println("- failed to open file");
+        LOGW("- failed to open %s", path);
         return false;
     }
+    len = file.read(buf, fileSize);
+    file.close();
+    return len == (size_t)fileSize;
+}
 
-    bool isFile = !file.isDirectory();
+DeserializationError SPIFFSManager::readJson(const char *path, JsonDocument &doc) {
+    if (fileSize(path) < 0) return DeserializationError::EmptyInput;
+    File file = fs_.open(path, "r");
+    if (!file) return DeserializationError::EmptyInput;
+    FileJsonReader reader(file);
+    DeserializationError err = deserializeJson(doc, reader);
     file.close();
+    return err;
+}
 
-    if (isFile) {
-        Serial.println("- file exists and is a regular file");
-    } else {
-        Serial.println("- path exists but is a directory");
-    }
+// stat() on the VFS path: no file handle, unlike fs::FS::exists(), which
+// opens the file to find out.
+long SPIFFSManager::fileSize(const char *path) {
+    char full[128];
+    int n = snprintf(full, sizeof(full), "%s%s", mountPoint_, path);
+    if (n < 0 || (size_t)n >= sizeof(full)) return -1;
+    struct stat st;
+    if (stat(full, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+    return (long)st.st_size;
+}
 
+bool SPIFFSManager::fileExists(const char *path) {
+    bool isFile = fileSize(path) >= 0;
+    LOGD("Checking if file exists: %s -> %d", path, (int)isFile);
     return isFile;
 }
 
 void SPIFFSManager::writeFile(const char *path, const char *message) {
-    Serial.printf("Writing file: %s\r\n", path);
+    LOGD("Writing file: %s", path);
 
     File file = fs_.open(path, FILE_WRITE);
     if (!file) {
-        Serial.println("- failed to open file for writing");
+        LOGW("- failed to open file for writing");
         return;
     }
     if (file.print(message)) {
-        Serial.println("- file written");
+        LOGD("- file written");
     } else {
-        Serial.println("- write failed");
+        LOGW("- write failed");
     }
     file.close();
 }
 
 void SPIFFSManager::appendFile(const char *path, const char *message) {
-    Serial.printf("Appending to file: %s\r\n", path);
+    LOGD("Appending to file: %s", path);
 
     File file = fs_.open(path, FILE_APPEND);
     if (!file) {
-        Serial.println("- failed to open file for appending");
+        LOGW("- failed to open file for appending");
         return;
     }
     if (file.print(message)) {
-        Serial.println("- message appended");
+        LOGD("- message appended");
     } else {
-        Serial.println("- append failed");
+        LOGW("- append failed");
     }
     file.close();
 }
 
 void SPIFFSManager::renameFile(const char *path1, const char *path2) {
-    Serial.printf("Renaming file %s to %s\r\n", path1, path2);
+    LOGD("Renaming file %s to %s", path1, path2);
     if (fs_.rename(path1, path2)) {
-        Serial.println("- file renamed");
+        LOGD("- file renamed");
     } else {
-        Serial.println("- rename failed");
+        LOGW("- rename failed");
     }
 }
 
 void SPIFFSManager::deleteFile(const char *path) {
-    Serial.printf("Deleting file: %s\r\n", path);
+    LOGD("Deleting file: %s", path);
     if (fs_.remove(path)) {
-        Serial.println("- file deleted");
+        LOGD("- file deleted");
     } else {
-        Serial.println("- delete failed");
+        LOGW("- delete failed");
     }
 }
 
-void SPIFFSManager::testFileIO(const char *path) {
-    Serial.printf("Testing file I/O with %s\r\n", path);
-
-    static uint8_t buf[512];
-    size_t len = 0;
-    File file = fs_.open(path, FILE_WRITE);
-    if (!file) {
-        Serial.println("- failed to open file for writing");
-        return;
-    }
-
-    size_t i;
-    Serial.print("- writing");
-    uint32_t start = millis();
-    for (i = 0; i < 2048; i++) {
-        if ((i & 0x001F) == 0x001F) {
-            Serial.print(".");
-        }
-        file.write(buf, 512);
-    }
-    Serial.println("");
-    uint32_t end = millis() - start;
-    Serial.printf(" - %u bytes written in %u ms\r\n", 2048 * 512, end);
-    file.close();
-
-    file = fs_.open(path);
-    start = millis();
-    end = start;
-    i = 0;
-    if (file && !file.isDirectory()) {
-        len = file.size();
-        size_t flen = len;
-        start = millis();
-        Serial.print("- reading");
-        while (len) {
-            size_t toRead = len;
-            if (toRead > 512) {
-                toRead = 512;
-            }
-            file.read(buf, toRead);
-            if ((i++ & 0x001F) == 0x001F) {
-                Serial.print(".");
-            }
-            len -= toRead;
-        }
-        Serial.println("");
-        end = millis() - start;
-        Serial.printf("- %u bytes read in %u ms\r\n", flen, end);
-        file.close();
-    } else {
-        Serial.println("- failed to open file for reading");
-    }
-}
-
-
-
   // List directory contents
   // spiffsManager.listDir("/", 0);
 
@@ -255,10 +191,4 @@ void SPIFFSManager::testFileIO(const char *path) {
   // Delete the file
   // spiffsManager.deleteFile("/renamed.txt");
 
-  // Test file I/O performance
-  // spiffsManager.testFileIO("/test.txt");
-
-  // Clean up the test file
-  // spiffsManager.deleteFile("/test.txt");
-
   // Serial.println("All SPIFFS operations completed successfully!");
\ No newline at end of file
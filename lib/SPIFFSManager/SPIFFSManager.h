@@ -4,25 +4,75 @@
 #include <Arduino.h>
 #include "FS.h"
 #include <LittleFS.h>
+#include <ArduinoJson.h>
 
 #define FORMAT_SPIFFS_IF_FAILED true
 
+// ArduinoJson reader over an open File. Refills a small stack buffer with
+// bulk reads, so deserializeJson() parses straight from flash without a
+// RAM copy of the text and without one VFS call per character.
+class FileJsonReader {
+public:
+    explicit FileJsonReader(File &file) : file_(file) {}
+
+    int read() {
+        if (pos_ == len_ && !fill()) return -1;
+        return buf_[pos_++];
+    }
+
+    size_t readBytes(char *out, size_t n) {
+        size_t done = 0;
+        while (done < n) {
+            if (pos_ == len_ && !fill()) break;
+            size_t take = len_ - pos_;
+            if (take > n - done) take = n - done;
+            memcpy(out + done, buf_ + pos_, take);
+            pos_ += take;
+            done += take;
+        }
+        return done;
+    }
+
+private:
+    bool fill() {
+        pos_ = 0;
+        len_ = file_.read(buf_, sizeof(buf_));
+        return len_ > 0;
+    }
+
+    File &file_;
+    uint8_t buf_[64];
+    size_t pos_ = 0;
+    size_t len_ = 0;
+};
+
 class SPIFFSManager {
 public:
-    SPIFFSManager(fs::FS &fs);
+    // mountPoint is the VFS path the filesystem was mounted at, used for
+    // stat() lookups that don't open the file.
+    SPIFFSManager(fs::FS &fs, const char *mountPoint = "/littlefs");
     ~SPIFFSManager();
 
     void listDir(const char *dirname, uint8_t levels);
+    // Whole file as a String, allocated once at the file's size.
     String readFile(const char *path);
+    // Whole file into buf. Fails without reading if it is larger than cap.
+    bool readInto(const char *path, uint8_t *buf, size_t cap, size_t &len);
+    // Parse a JSON file through FileJsonReader. EmptyInput if it is missing.
+    DeserializationError readJson(const char *path, JsonDocument &doc);
     void writeFile(const char *path, const char *message);
     void appendFile(const char *path, const char *message);
     void renameFile(const char *path1, const char *path2);
     void deleteFile(const char *path);
-    void testFileIO(const char *path);
     bool fileExists(const char *path);
+    // Size of a regular file, or -1 if it is missing or a directory.
+    long fileSize(const char *path);
+
+    fs::FS &fs() { return fs_; }
 
 private:
     fs::FS &fs_;
+    const char *mountPoint_;
 };
 
 #endif // SPIFFS_MANAGER_H
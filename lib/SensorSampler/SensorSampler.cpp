@@ -0,0 +1,66 @@
+#include "SensorSampler.h"
+
+#include <stdlib.h>
+
+int8_t SensorSampler::add(ReadFn read, uint32_t periodMs, uint8_t smoothShift, int32_t threshold) {
+    if (count_ >= kMaxChannels || !read) return -1;
+    Channel &c = channels_[count_];
+    c = Channel();
+    c.read = read;
+    c.periodMs = periodMs;
+    c.smoothShift = smoothShift > 7 ? 7 : smoothShift;
+    c.threshold = threshold > 0 ? threshold : 1;
+    invalidate(count_); // first read on the first poll()
+    return (int8_t)count_++;
+}
+
+bool SensorSampler::sample(Channel &c, bool reseed) {
+    const int32_t raw = c.read();
+    c.reads++;
+    if (reseed || !c.valid || c.smoothShift == 0) {
+        c.smoothed = raw * 256;
+    } else {
+        c.smoothed += (raw * 256 - c.smoothed) / (1 << c.smoothShift);
+    }
+    // Round to nearest rather than toward zero so negative values (RSSI)
+    // behave like positive ones.
+    const int32_t v = (c.smoothed + (c.smoothed >= 0 ? 128 : -128)) / 256;
+    if (c.valid && !reseed && abs(v - c.reported) < c.threshold) return false;
+    const bool changed = !c.valid || v != c.reported;
+    c.reported = v;
+    c.valid = true;
+    return changed;
+}
+
+uint32_t SensorSampler::poll(uint32_t nowMs) {
+    const uint32_t forced = invalid_.exchange(0, std::memory_order_relaxed);
+    uint32_t changed = 0;
+    for (uint8_t i = 0; i < count_; i++) {
+        Channel &c = channels_[i];
+        const bool reseed = forced & (1UL << i);
+        const bool due = c.periodMs && c.valid && (int32_t)(nowMs - c.dueMs) >= 0;
+        if (!reseed && !due) continue;
+        if (sample(c, reseed)) changed |= 1UL << i;
+        if (c.periodMs) c.dueMs = nowMs + c.periodMs;
+    }
+    return changed;
+}
+
+uint32_t SensorSampler::msUntilNext(uint32_t nowMs) const {
+    if (pending()) return 0;
+    uint32_t best = kNever;
+    for (uint8_t i = 0; i < count_; i++) {
+        const Channel &c = channels_[i];
+        if (!c.periodMs || !c.valid) continue;
+        int32_t left = (int32_t)(c.dueMs - nowMs);
+        uint32_t l = left > 0 ? (uint32_t)left : 0;
+        if (l < best) best = l;
+    }
+    return best;
+}
+
+uint32_t SensorSampler::totalReads() const {
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < count_; i++) n += channels_[i].reads;
+    return n;
+}
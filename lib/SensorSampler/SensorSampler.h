@@ -0,0 +1,60 @@
+#ifndef SENSOR_SAMPLER_H
+#define SENSOR_SAMPLER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Owns the reads of slow-moving sensors (battery, charger, RSSI) so each is
+// sampled on its own schedule instead of whenever a consumer wants it.
+// Every channel has a read function, a period, optional exponential
+// smoothing and a change threshold; consumers read the cached value and
+// poll() reports which channels moved by at least their threshold.
+//
+// invalidate() forces a fresh, unsmoothed read on the next poll(). It is
+// safe to call from another task (e.g. the Wi-Fi event task).
+class SensorSampler {
+public:
+    typedef int32_t (*ReadFn)();
+
+    static constexpr uint8_t kMaxChannels = 8;
+    static constexpr uint32_t kNever = 0xFFFFFFFF;
+
+    // periodMs 0: read only when invalidated. smoothShift n weights each new
+    // sample by 1/2^n (0 = raw). Returns the channel id, or -1 if full.
+    int8_t add(ReadFn read, uint32_t periodMs, uint8_t smoothShift = 0, int32_t threshold = 1);
+
+    // Read the channels that are due. Returns a bitmask of channels whose
+    // reported value changed (including their first read).
+    uint32_t poll(uint32_t nowMs);
+    uint32_t msUntilNext(uint32_t nowMs) const;
+
+    void invalidate(uint8_t ch) { invalid_.fetch_or(1UL << ch, std::memory_order_relaxed); }
+    bool pending() const { return invalid_.load(std::memory_order_relaxed) != 0; }
+
+    int32_t value(uint8_t ch) const { return channels_[ch].reported; }
+    bool valid(uint8_t ch) const { return channels_[ch].valid; }
+    uint32_t reads(uint8_t ch) const { return channels_[ch].reads; }
+    uint32_t totalReads() const;
+    uint8_t size() const { return count_; }
+
+private:
+    struct Channel {
+        ReadFn read;
+        uint32_t periodMs;
+        uint8_t smoothShift;
+        int32_t threshold;
+        bool valid;
+        uint32_t dueMs;
+        int32_t smoothed; // value << 8
+        int32_t reported;
+        uint32_t reads;
+    };
+
+    bool sample(Channel &c, bool reseed);
+
+    Channel channels_[kMaxChannels] = {};
+    uint8_t count_ = 0;
+    std::atomic<uint32_t> invalid_{0};
+};
+
+#endif // SENSOR_SAMPLER_H
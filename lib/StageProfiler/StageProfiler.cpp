@@ -0,0 +1,119 @@
+#include "StageProfiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void LatencyHistogram::record(uint32_t us) {
+    uint8_t b = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if (b >= kBuckets) b = kBuckets - 1;
+    buckets_[b]++;
+    count_++;
+    sum_ += us;
+    if (us > max_) max_ = us;
+}
+
+void LatencyHistogram::reset() {
+    memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    max_ = 0;
+    sum_ = 0;
+}
+
+uint32_t LatencyHistogram::percentile(uint8_t p) const {
+    if (count_ == 0) return 0;
+    uint32_t rank = ((uint64_t)count_ * p + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < kBuckets; i++) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            uint32_t upper = bucketUpper(i);
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+StageProfiler::StageProfiler(const char *const *names, uint8_t count)
+    : names_(names), count_(count > kMaxStages ? kMaxStages : count) {}
+
+void StageProfiler::reset() {
+    for (uint8_t i = 0; i < count_; i++) {
+        hist_[i].reset();
+    }
+}
+
+size_t StageProfiler::summarize(char *out, size_t cap) const {
+    size_t len = 0;
+    if (cap) out[0] = '\0';
+    for (uint8_t i = 0; i < count_; i++) {
+        const LatencyHistogram &h = hist_[i];
+        if (h.count() == 0) continue;
+        int n = snprintf(out + len, cap - len, "%s%s:%lu/%lu/%lu/%lu",
+                         len ? ";" : "", names_[i],
+                         (unsigned long)h.count(), (unsigned long)h.percentile(50),
+                         (unsigned long)h.percentile(99), (unsigned long)h.max());
+        if (n < 0 || (size_t)n >= cap - len) {
+            out[len] = '\0'; // drop the stage that didn't fit
+            break;
+        }
+        len += n;
+    }
+    return len;
+}
+
+LoopProfiler::LoopProfiler(const char *const *names, uint8_t count, uint32_t budgetUs)
+    : names_(names), count_(count > kMaxSections ? kMaxSections : count), budgetUs_(budgetUs) {}
+
+void LoopProfiler::beginIteration(uint32_t nowUs) {
+    iterStart_ = nowUs;
+    lastMark_ = nowUs;
+    memset(current_, 0, sizeof(current_));
+}
+
+void LoopProfiler::mark(uint8_t section, uint32_t nowUs) {
+    if (section >= count_) return;
+    uint32_t spent = nowUs - lastMark_;
+    lastMark_ = nowUs;
+    current_[section] += spent;
+    if (current_[section] > sectionMax_[section]) sectionMax_[section] = current_[section];
+}
+
+void LoopProfiler::charge(uint8_t section, uint32_t spentUs) {
+    if (section >= count_) return;
+    lastMark_ += spentUs;
+    current_[section] += spentUs;
+    if (current_[section] > sectionMax_[section]) sectionMax_[section] = current_[section];
+}
+
+bool LoopProfiler::endIteration(uint32_t nowUs) {
+    uint32_t total = nowUs - iterStart_;
+    iterations_.record(total);
+    if (total <= budgetUs_) return false;
+
+    uint8_t culprit = 0;
+    for (uint8_t i = 1; i < count_; i++) {
+        if (current_[i] > current_[culprit]) culprit = i;
+    }
+    overruns_++;
+    blamed_[culprit]++;
+    lastCulprit_ = culprit;
+    lastCulpritUs_ = current_[culprit];
+    lastOverrunUs_ = total;
+    return true;
+}
+
+uint8_t LoopProfiler::worstSection() const {
+    uint8_t worst = 0;
+    for (uint8_t i = 1; i < count_; i++) {
+        if (blamed_[i] > blamed_[worst]) worst = i;
+    }
+    return worst;
+}
+
+void LoopProfiler::reset() {
+    iterations_.reset();
+    memset(sectionMax_, 0, sizeof(sectionMax_));
+    memset(blamed_, 0, sizeof(blamed_));
+    overruns_ = 0;
+}
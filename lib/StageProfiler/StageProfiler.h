@@ -0,0 +1,115 @@
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed log2-bucket latency histogram. Bucket 0 holds 0 us, bucket i holds
+// [2^(i-1), 2^i) us; the last bucket absorbs everything above ~4 s.
+// Recording is a count-leading-zeros and three adds, so it is cheap enough
+// to leave enabled in production builds.
+class LatencyHistogram {
+public:
+    static constexpr uint8_t kBuckets = 24;
+
+    void record(uint32_t us);
+    void reset();
+
+    uint32_t count() const { return count_; }
+    uint32_t max() const { return max_; }
+    uint32_t mean() const { return count_ ? (uint32_t)(sum_ / count_) : 0; }
+    uint32_t bucket(uint8_t i) const { return buckets_[i]; }
+    static uint32_t bucketUpper(uint8_t i) { return i == 0 ? 0 : (1UL << i) - 1; }
+
+    // Upper bound of the bucket containing the p-th percentile (0..100),
+    // clamped to the observed max.
+    uint32_t percentile(uint8_t p) const;
+
+private:
+    uint32_t buckets_[kBuckets] = {};
+    uint32_t count_ = 0;
+    uint32_t max_ = 0;
+    uint64_t sum_ = 0;
+};
+
+// A named set of histograms, one per pipeline stage.
+class StageProfiler {
+public:
+    static constexpr uint8_t kMaxStages = 12;
+
+    StageProfiler(const char *const *names, uint8_t count);
+
+    void record(uint8_t stage, uint32_t us) {
+        if (stage < count_) hist_[stage].record(us);
+    }
+    void reset();
+
+    uint8_t size() const { return count_; }
+    const char *name(uint8_t stage) const { return names_[stage]; }
+    const LatencyHistogram &stage(uint8_t stage) const { return hist_[stage]; }
+
+    // Compact one-line summary: name:n/p50/p99/max;... (all in us). Stages
+    // with no samples are skipped. Returns bytes written (excluding NUL).
+    size_t summarize(char *out, size_t cap) const;
+
+private:
+    const char *const *names_;
+    uint8_t count_;
+    LatencyHistogram hist_[kMaxStages];
+};
+
+// Main-loop iteration profiler. The loop calls mark() after each section;
+// the time since the previous mark is charged to that section. An iteration
+// over budget is blamed on the section that took the largest share of it.
+// Work that can run inside any section (a mirror push from wherever the
+// canvas was presented) is timed by its caller and charge()d instead.
+class LoopProfiler {
+public:
+    static constexpr uint8_t kMaxSections = 12;
+
+    LoopProfiler(const char *const *names, uint8_t count, uint32_t budgetUs);
+
+    void beginIteration(uint32_t nowUs);
+    void mark(uint8_t section, uint32_t nowUs);
+    // Move spentUs that just passed to this section, out of whichever
+    // section marks next.
+    void charge(uint8_t section, uint32_t spentUs);
+    // Returns true if this iteration exceeded the budget.
+    bool endIteration(uint32_t nowUs);
+
+    const LatencyHistogram &iterations() const { return iterations_; }
+    uint32_t overruns() const { return overruns_; }
+    uint32_t budgetUs() const { return budgetUs_; }
+    uint8_t size() const { return count_; }
+    const char *name(uint8_t section) const { return names_[section]; }
+    uint32_t sectionMax(uint8_t section) const { return sectionMax_[section]; }
+    uint32_t blamed(uint8_t section) const { return blamed_[section]; }
+
+    // Details of the most recent overrun.
+    uint8_t lastCulprit() const { return lastCulprit_; }
+    uint32_t lastCulpritUs() const { return lastCulpritUs_; }
+    uint32_t lastOverrunUs() const { return lastOverrunUs_; }
+    // Section blamed most often overall.
+    uint8_t worstSection() const;
+
+    void reset();
+
+private:
+    const char *const *names_;
+    uint8_t count_;
+    uint32_t budgetUs_;
+
+    uint32_t iterStart_ = 0;
+    uint32_t lastMark_ = 0;
+    uint32_t current_[kMaxSections] = {};
+
+    LatencyHistogram iterations_;
+    uint32_t sectionMax_[kMaxSections] = {};
+    uint32_t blamed_[kMaxSections] = {};
+    uint32_t overruns_ = 0;
+    uint8_t lastCulprit_ = 0;
+    uint32_t lastCulpritUs_ = 0;
+    uint32_t lastOverrunUs_ = 0;
+};
+
+#endif // STAGE_PROFILER_H
@@ -0,0 +1,56 @@
+#include "StatusCells.h"
+
+uint8_t StatusCells::batteryBucket(int level) {
+    if (level < 0) level = 0;
+    if (level > 100) level = 100;
+    return (uint8_t)((level + 5) / 10);
+}
+
+uint32_t StatusCells::labelKey(const char *text, bool connected) {
+    uint32_t h = 2166136261u;
+    for (uint8_t i = 0; text && text[i] && i < kLabelChars; i++) {
+        h = (h ^ (uint8_t)text[i]) * 16777619u;
+    }
+    return connected ? h : ~h;
+}
+
+// Same geometry the bar has always had, right to left: battery, Wi-Fi bars,
+// MQTT dot, stall marker; label on the left.
+void StatusCells::layout(int16_t barWidth, int16_t barHeight) {
+    barWidth_ = barWidth;
+    barHeight_ = barHeight;
+    valid_ = false;
+    const int16_t batW = 24, batH = 14;
+    const int16_t batX = barWidth - batW - 4;
+    rects_[kBattery] = {batX, (int16_t)((barHeight - batH) / 2), (int16_t)(batW - 1), batH}; // body + nub
+
+    const int16_t wifiW = 20;
+    const int16_t wifiX = batX - wifiW - 6;
+    rects_[kWifi] = {wifiX, 0, wifiW, barHeight};
+
+    const int16_t dot = 8;
+    const int16_t dotX = wifiX - dot - 6;
+    rects_[kMqtt] = {dotX, (int16_t)((barHeight - dot) / 2), (int16_t)(dot + 1), (int16_t)(dot + 1)};
+
+    const int16_t glyphW = 6, glyphH = 8; // Font0
+    rects_[kStall] = {(int16_t)(dotX - 3 - glyphW), (int16_t)((barHeight - glyphH) / 2), glyphW, glyphH};
+    rects_[kLabel] = {4, (int16_t)((barHeight - glyphH) / 2), (int16_t)(glyphW * kLabelChars), glyphH};
+}
+
+uint8_t StatusCells::update(const uint32_t keys[kCount]) {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < kCount; i++) {
+        if (!valid_ || keys[i] != keys_[i]) mask |= 1 << i;
+        keys_[i] = keys[i];
+    }
+    valid_ = true;
+    return mask;
+}
+
+uint32_t StatusCells::bytes(uint8_t mask) const {
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < kCount; i++) {
+        if (mask & (1 << i)) n += (uint32_t)rects_[i].w * rects_[i].h * kPanelBytesPerPixel;
+    }
+    return n;
+}
@@ -0,0 +1,53 @@
+#ifndef STATUS_CELLS_H
+#define STATUS_CELLS_H
+
+#include <stdint.h>
+
+// Status-bar layout split into independent cells, each showing one discrete
+// state identified by a key. update() diffs the keys against the previous
+// ones so only the cells that changed are redrawn and pushed to the panel.
+// Shared with tools/statusbar_bench.cpp, which replays state changes and
+// compares the bytes pushed against whole-bar pushes.
+class StatusCells {
+public:
+    enum Cell : uint8_t { kLabel, kStall, kMqtt, kWifi, kBattery, kCount };
+
+    struct Rect {
+        int16_t x, y, w, h;
+    };
+
+    static constexpr uint8_t kBatteryBuckets = 11; // 0, 10, ... 100 %
+    static constexpr uint8_t kWifiStates = 6;      // 0..4 bars, then offline
+    static constexpr uint8_t kWifiOffline = 5;
+    static constexpr uint8_t kLabelChars = 9;
+    static constexpr uint8_t kPanelBytesPerPixel = 2; // RGB565 on the wire
+
+    static uint8_t batteryBucket(int level);
+    static uint8_t wifiState(bool connected, int bars) { return connected ? (bars < 0 ? 0 : bars > 4 ? 4 : bars) : kWifiOffline; }
+    // FNV-1a of the first kLabelChars of the label plus its style.
+    static uint32_t labelKey(const char *text, bool connected);
+
+    // Cell rectangles for a bar of this size; call before anything else.
+    void layout(int16_t barWidth, int16_t barHeight);
+
+    const Rect &rect(uint8_t cell) const { return rects_[cell]; }
+    int16_t barWidth() const { return barWidth_; }
+    int16_t barHeight() const { return barHeight_; }
+
+    // Returns the mask of cells whose key changed; every cell after
+    // invalidate() or on the first call.
+    uint8_t update(const uint32_t keys[kCount]);
+    void invalidate() { valid_ = false; }
+
+    uint32_t bytes(uint8_t mask) const;
+    uint32_t fullBytes() const { return (uint32_t)barWidth_ * barHeight_ * kPanelBytesPerPixel; }
+
+private:
+    int16_t barWidth_ = 0;
+    int16_t barHeight_ = 0;
+    Rect rects_[kCount] = {};
+    uint32_t keys_[kCount] = {};
+    bool valid_ = false;
+};
+
+#endif // STATUS_CELLS_H
@@ -0,0 +1,375 @@
+#include "StreamInflate.h"
+
+#include <string.h>
+
+namespace {
+
+// Length/distance base values and extra-bit counts (RFC 1951 section 3.2.5).
+const uint16_t kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577};
+const uint8_t kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Order in which code-length code lengths are transmitted.
+const uint8_t kClenOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Nibble-wise CRC32 keeps the table at 64 bytes instead of 1 KB.
+const uint32_t kCrcNibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+inline uint32_t crcUpdate(uint32_t crc, uint8_t b) {
+    crc ^= b;
+    crc = (crc >> 4) ^ kCrcNibble[crc & 0x0F];
+    crc = (crc >> 4) ^ kCrcNibble[crc & 0x0F];
+    return crc;
+}
+
+enum GzipFlag : uint8_t {
+    kFlagHcrc = 0x02,
+    kFlagExtra = 0x04,
+    kFlagName = 0x08,
+    kFlagComment = 0x10,
+};
+
+} // namespace
+
+StreamInflate::StreamInflate(uint8_t *window, uint8_t windowBits)
+    : window_(window), mask_((1UL << windowBits) - 1) {}
+
+bool StreamInflate::isGzip(const uint8_t *data, size_t len) {
+    return len >= 3 && data[0] == 0x1F && data[1] == 0x8B && data[2] == 0x08;
+}
+
+const char *StreamInflate::statusName(Status s) {
+    switch (s) {
+    case kOk: return "ok";
+    case kDone: return "done";
+    case kErrHeader: return "bad header";
+    case kErrData: return "corrupt data";
+    case kErrWindow: return "window too small";
+    case kErrTruncated: return "truncated";
+    case kErrChecksum: return "checksum mismatch";
+    }
+    return "?";
+}
+
+bool StreamInflate::begin(const uint8_t *in, size_t len) {
+    in_ = in;
+    inLen_ = len;
+    pos_ = 0;
+    bitBuf_ = 0;
+    bitCnt_ = 0;
+    wpos_ = 0;
+    produced_ = 0;
+    crc_ = 0xFFFFFFFF;
+    lastBlock_ = false;
+    storedRemain_ = 0;
+    matchLen_ = 0;
+    matchDist_ = 0;
+    state_ = kFinished;
+    status_ = kErrHeader;
+
+    // Fixed 10-byte member header, then optional fields selected by FLG.
+    if (!isGzip(in, len) || len < 18) {
+        return false;
+    }
+    uint8_t flags = in[3];
+    size_t p = 10;
+    if (flags & kFlagExtra) {
+        if (p + 2 > len) return false;
+        p += 2 + (in[p] | (in[p + 1] << 8));
+    }
+    if (flags & kFlagName) {
+        while (p < len && in[p] != 0) p++;
+        p++;
+    }
+    if (flags & kFlagComment) {
+        while (p < len && in[p] != 0) p++;
+        p++;
+    }
+    if (flags & kFlagHcrc) {
+        p += 2;
+    }
+    if (p >= len) {
+        return false;
+    }
+
+    pos_ = p;
+    state_ = kBlockHeader;
+    status_ = kOk;
+    return true;
+}
+
+void StreamInflate::fail(Status s) {
+    if (!failed()) {
+        status_ = s;
+    }
+    state_ = kFinished;
+    matchLen_ = 0;
+}
+
+uint32_t StreamInflate::getBits(uint8_t n) {
+    while (bitCnt_ < n) {
+        if (pos_ >= inLen_) {
+            fail(kErrTruncated);
+            return 0;
+        }
+        bitBuf_ |= (uint32_t)in_[pos_++] << bitCnt_;
+        bitCnt_ += 8;
+    }
+    uint32_t v = bitBuf_ & ((1UL << n) - 1);
+    bitBuf_ >>= n;
+    bitCnt_ -= n;
+    return v;
+}
+
+void StreamInflate::buildTree(Tree &t, const uint8_t *lengths, uint16_t num) {
+    uint16_t offs[16];
+    memset(t.counts, 0, sizeof(t.counts));
+    for (uint16_t i = 0; i < num; i++) {
+        t.counts[lengths[i]]++;
+    }
+    t.counts[0] = 0;
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < 16; i++) {
+        offs[i] = sum;
+        sum += t.counts[i];
+    }
+    for (uint16_t i = 0; i < num; i++) {
+        if (lengths[i]) {
+            t.symbols[offs[lengths[i]]++] = i;
+        }
+    }
+}
+
+// Canonical Huffman decode, one bit at a time (codes are sent MSB-first).
+int StreamInflate::decodeSymbol(const Tree &t) {
+    int code = 0, first = 0, index = 0;
+    for (uint8_t len = 1; len < 16; len++) {
+        code |= getBits(1);
+        if (failed()) return -1;
+        int count = t.counts[len];
+        if (code - first < count) {
+            return t.symbols[index + code - first];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    fail(kErrData);
+    return -1;
+}
+
+bool StreamInflate::readDynamicTrees() {
+    uint8_t lengths[288 + 32];
+    uint16_t hlit = getBits(5) + 257;
+    uint8_t hdist = getBits(5) + 1;
+    uint8_t hclen = getBits(4) + 4;
+    if (failed() || hlit > 286 || hdist > 30) {
+        fail(kErrData);
+        return false;
+    }
+
+    memset(lengths, 0, 19);
+    for (uint8_t i = 0; i < hclen; i++) {
+        lengths[kClenOrder[i]] = getBits(3);
+    }
+    buildTree(lit_, lengths, 19); // borrow lit_ for the code-length tree
+
+    uint16_t num = 0;
+    while (num < hlit + hdist) {
+        int sym = decodeSymbol(lit_);
+        if (sym < 0) return false;
+        uint8_t repeatVal = 0;
+        uint8_t repeat = 1;
+        if (sym < 16) {
+            lengths[num++] = sym;
+            continue;
+        } else if (sym == 16) {
+            if (num == 0) {
+                fail(kErrData);
+                return false;
+            }
+            repeatVal = lengths[num - 1];
+            repeat = 3 + getBits(2);
+        } else if (sym == 17) {
+            repeat = 3 + getBits(3);
+        } else {
+            repeat = 11 + getBits(7);
+        }
+        if (failed() || num + repeat > hlit + hdist) {
+            fail(kErrData);
+            return false;
+        }
+        while (repeat--) lengths[num++] = repeatVal;
+    }
+    if (lengths[256] == 0) {
+        fail(kErrData);
+        return false;
+    }
+
+    buildTree(lit_, lengths, hlit);
+    buildTree(dist_, lengths + hlit, hdist);
+    return true;
+}
+
+bool StreamInflate::readBlockHeader() {
+    lastBlock_ = getBits(1);
+    uint8_t type = getBits(2);
+    if (failed()) return false;
+
+    if (type == 0) {
+        // Stored block: discard to byte boundary, then LEN/NLEN.
+        bitBuf_ = 0;
+        bitCnt_ = 0;
+        if (pos_ + 4 > inLen_) {
+            fail(kErrTruncated);
+            return false;
+        }
+        uint16_t len = in_[pos_] | (in_[pos_ + 1] << 8);
+        uint16_t nlen = in_[pos_ + 2] | (in_[pos_ + 3] << 8);
+        pos_ += 4;
+        if (len != (uint16_t)~nlen) {
+            fail(kErrData);
+            return false;
+        }
+        storedRemain_ = len;
+        state_ = kStored;
+    } else if (type == 1) {
+        uint8_t lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        buildTree(lit_, lengths, 288);
+        memset(lengths, 5, 30);
+        buildTree(dist_, lengths, 30);
+        state_ = kHuffman;
+    } else if (type == 2) {
+        if (!readDynamicTrees()) return false;
+        state_ = kHuffman;
+    } else {
+        fail(kErrData);
+        return false;
+    }
+    return true;
+}
+
+void StreamInflate::finish() {
+    // Trailer is byte aligned: CRC32 then ISIZE, both little-endian.
+    bitBuf_ = 0;
+    bitCnt_ = 0;
+    state_ = kFinished;
+    if (pos_ + 8 > inLen_) {
+        fail(kErrTruncated);
+        return;
+    }
+    const uint8_t *t = in_ + pos_;
+    uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    uint32_t isize = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    pos_ += 8;
+    if (crc != (crc_ ^ 0xFFFFFFFF) || isize != (uint32_t)produced_) {
+        fail(kErrChecksum);
+        return;
+    }
+    status_ = kDone;
+}
+
+int StreamInflate::emit(uint8_t b) {
+    window_[wpos_ & mask_] = b;
+    wpos_++;
+    produced_++;
+    crc_ = crcUpdate(crc_, b);
+    return b;
+}
+
+int StreamInflate::read() {
+    for (;;) {
+        if (matchLen_) {
+            matchLen_--;
+            return emit(window_[(wpos_ - matchDist_) & mask_]);
+        }
+        switch (state_) {
+        case kBlockHeader:
+            if (lastBlock_) {
+                finish();
+                return -1;
+            }
+            if (!readBlockHeader()) return -1;
+            break;
+
+        case kStored:
+            if (storedRemain_ == 0) {
+                state_ = kBlockHeader;
+                break;
+            }
+            if (pos_ >= inLen_) {
+                fail(kErrTruncated);
+                return -1;
+            }
+            storedRemain_--;
+            return emit(in_[pos_++]);
+
+        case kHuffman: {
+            int sym = decodeSymbol(lit_);
+            if (sym < 0) return -1;
+            if (sym < 256) return emit((uint8_t)sym);
+            if (sym == 256) {
+                state_ = kBlockHeader;
+                break;
+            }
+            sym -= 257;
+            if (sym >= 29) {
+                fail(kErrData);
+                return -1;
+            }
+            uint16_t len = kLengthBase[sym] + getBits(kLengthExtra[sym]);
+            int dsym = decodeSymbol(dist_);
+            if (dsym < 0) return -1;
+            if (dsym >= 30) {
+                fail(kErrData);
+                return -1;
+            }
+            uint32_t dist = kDistBase[dsym] + getBits(kDistExtra[dsym]);
+            if (failed()) return -1;
+            if (dist > produced_) {
+                fail(kErrData);
+                return -1;
+            }
+            if (dist > mask_ + 1) {
+                fail(kErrWindow);
+                return -1;
+            }
+            matchLen_ = len;
+            matchDist_ = dist;
+            break;
+        }
+
+        case kFinished:
+            return -1;
+        }
+    }
+}
+
+size_t StreamInflate::readBytes(char *buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int c = read();
+        if (c < 0) break;
+        buffer[n++] = (char)c;
+    }
+    return n;
+}
@@ -0,0 +1,86 @@
+#ifndef STREAM_INFLATE_H
+#define STREAM_INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pull-style gzip/deflate (RFC 1951/1952) decoder. The compressed input is
+// consumed from a caller-owned buffer and decompressed bytes are produced on
+// demand through read()/readBytes(), so it can be handed straight to
+// deserializeJson() as a custom reader. Back-references are resolved from a
+// caller-supplied ring window of 2^windowBits bytes; the full inflated
+// message is never materialised. Producers must compress with a window no
+// larger than ours (e.g. Python: zlib.compressobj(9, zlib.DEFLATED, 16 + 12)).
+class StreamInflate {
+public:
+    enum Status : uint8_t {
+        kOk = 0,       // more output may follow
+        kDone,         // stream finished and CRC32/ISIZE verified
+        kErrHeader,    // not a gzip member we understand
+        kErrData,      // corrupt deflate stream
+        kErrWindow,    // back-reference further than our window
+        kErrTruncated, // input ended before the final block
+        kErrChecksum,  // trailer CRC32 or size mismatch
+    };
+
+    StreamInflate(uint8_t *window, uint8_t windowBits);
+
+    // True if the buffer starts with the gzip magic (1F 8B 08). Never matches
+    // printable text, so it can't be confused with JSON or plain payloads.
+    static bool isGzip(const uint8_t *data, size_t len);
+
+    // Reset state and parse the gzip member header. Returns false (and sets
+    // status()) if the header is malformed.
+    bool begin(const uint8_t *in, size_t len);
+
+    // ArduinoJson custom-reader interface.
+    int read();
+    size_t readBytes(char *buffer, size_t length);
+
+    Status status() const { return status_; }
+    bool failed() const { return status_ > kDone; }
+    size_t consumed() const { return pos_; }
+    size_t produced() const { return produced_; }
+    static const char *statusName(Status s);
+
+private:
+    struct Tree {
+        uint16_t counts[16];
+        uint16_t symbols[288];
+    };
+
+    enum State : uint8_t { kBlockHeader, kStored, kHuffman, kFinished };
+
+    uint32_t getBits(uint8_t n);
+    int decodeSymbol(const Tree &t);
+    void buildTree(Tree &t, const uint8_t *lengths, uint16_t num);
+    bool readBlockHeader();
+    bool readDynamicTrees();
+    void finish();
+    int emit(uint8_t b);
+    void fail(Status s);
+
+    uint8_t *window_;
+    uint32_t mask_;
+    uint32_t wpos_ = 0;
+
+    const uint8_t *in_ = nullptr;
+    size_t inLen_ = 0;
+    size_t pos_ = 0;
+    uint32_t bitBuf_ = 0;
+    uint8_t bitCnt_ = 0;
+
+    State state_ = kFinished;
+    Status status_ = kErrHeader;
+    bool lastBlock_ = false;
+    uint16_t storedRemain_ = 0;
+    uint16_t matchLen_ = 0;
+    uint16_t matchDist_ = 0;
+    size_t produced_ = 0;
+    uint32_t crc_ = 0;
+
+    Tree lit_;
+    Tree dist_;
+};
+
+#endif // STREAM_INFLATE_H
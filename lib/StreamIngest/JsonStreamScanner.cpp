@@ -0,0 +1,331 @@
+#include "JsonStreamScanner.h"
+
+#include <string.h>
+
+// Arena record layout (one per captured value):
+//   [type][keyLen][key bytes][0][lenLo][lenHi][value bytes][0]
+
+namespace {
+
+inline bool isSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool isScalarChar(uint8_t c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '+' || c == '-' || c == '.';
+}
+
+inline int hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+JsonStreamScanner::JsonStreamScanner(uint8_t *arena, size_t arenaSize)
+    : arena_(arena), arenaSize_(arenaSize) {}
+
+void JsonStreamScanner::reset() {
+    used_ = 0;
+    received_ = 0;
+    lex_ = kExpectValue;
+    depth_ = 0;
+    arrayMask_ = 0;
+    stringIsKey_ = false;
+    overBudget_ = false;
+    keyLen_ = 0;
+    keyValid_ = false;
+    capturing_ = false;
+}
+
+JsonStreamScanner::Result JsonStreamScanner::result() const {
+    if (lex_ == kError) return kMalformed;
+    if (overBudget_) return kOverBudget;
+    if (lex_ == kDone) return kComplete;
+    return kPending;
+}
+
+void JsonStreamScanner::push(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        push(data[i]);
+    }
+}
+
+void JsonStreamScanner::push(uint8_t c) {
+    received_++;
+    if (lex_ != kError) {
+        step(c);
+    }
+}
+
+void JsonStreamScanner::step(uint8_t c) {
+    switch (lex_) {
+    case kExpectValue:
+    case kExpectValueOrEnd:
+        if (isSpace(c)) return;
+        if (lex_ == kExpectValueOrEnd && c == ']') {
+            closeContainer(c);
+            return;
+        }
+        beginValue(c);
+        return;
+
+    case kExpectKeyOrEnd:
+        if (isSpace(c)) return;
+        if (c == '}') {
+            closeContainer(c);
+            return;
+        }
+        // fall through
+    case kExpectKey:
+        if (isSpace(c)) return;
+        if (c != '"') {
+            lex_ = kError;
+            return;
+        }
+        if (depth_ == 1) {
+            keyLen_ = 0;
+            keyValid_ = true;
+        }
+        stringIsKey_ = true;
+        lex_ = kInString;
+        return;
+
+    case kExpectColon:
+        if (isSpace(c)) return;
+        lex_ = (c == ':') ? kExpectValue : kError;
+        return;
+
+    case kAfterValue:
+        if (isSpace(c)) return;
+        if (c == ',') {
+            lex_ = isArray(depth_ - 1) ? kExpectValue : kExpectKey;
+        } else if (c == '}' || c == ']') {
+            closeContainer(c);
+        } else {
+            lex_ = kError;
+        }
+        return;
+
+    case kInString:
+        if (c == '"') {
+            endString();
+        } else if (c == '\\') {
+            lex_ = kInEscape;
+        } else if (c < 0x20) {
+            lex_ = kError;
+        } else if (stringIsKey_) {
+            if (depth_ == 1) {
+                if (keyLen_ < kMaxKey - 1) key_[keyLen_++] = c;
+                else keyValid_ = false;
+            }
+        } else {
+            captureByte(c);
+        }
+        return;
+
+    case kInEscape: {
+        uint8_t out;
+        switch (c) {
+        case '"': case '\\': case '/': out = c; break;
+        case 'b': out = '\b'; break;
+        case 'f': out = '\f'; break;
+        case 'n': out = '\n'; break;
+        case 'r': out = '\r'; break;
+        case 't': out = '\t'; break;
+        case 'u':
+            unicode_ = 0;
+            unicodeDigits_ = 0;
+            lex_ = kInUnicode;
+            return;
+        default:
+            lex_ = kError;
+            return;
+        }
+        lex_ = kInString;
+        if (stringIsKey_) {
+            if (depth_ == 1) {
+                if (keyLen_ < kMaxKey - 1) key_[keyLen_++] = out;
+                else keyValid_ = false;
+            }
+        } else {
+            captureByte(out);
+        }
+        return;
+    }
+
+    case kInUnicode: {
+        int h = hexValue(c);
+        if (h < 0) {
+            lex_ = kError;
+            return;
+        }
+        unicode_ = (unicode_ << 4) | h;
+        if (++unicodeDigits_ == 4) {
+            lex_ = kInString;
+            if (!stringIsKey_) captureUtf8(unicode_);
+            else if (depth_ == 1) {
+                // Keys we look up are ASCII; anything else can't match.
+                if (unicode_ < 0x80 && keyLen_ < kMaxKey - 1) key_[keyLen_++] = (char)unicode_;
+                else keyValid_ = false;
+            }
+        }
+        return;
+    }
+
+    case kInScalar:
+        if (isScalarChar(c)) {
+            captureByte(c);
+            return;
+        }
+        endScalar();
+        if (lex_ != kError) step(c);
+        return;
+
+    case kDone:
+    case kError:
+        return;
+    }
+}
+
+void JsonStreamScanner::beginValue(uint8_t c) {
+    if (depth_ == 0 && c != '{') {
+        lex_ = kError; // only objects are routable
+        return;
+    }
+    if (c == '{' || c == '[') {
+        if (depth_ >= kMaxDepth) {
+            lex_ = kError;
+            return;
+        }
+        if (c == '[') arrayMask_ |= (1U << depth_);
+        else arrayMask_ &= ~(1U << depth_);
+        depth_++;
+        lex_ = (c == '[') ? kExpectValueOrEnd : kExpectKeyOrEnd;
+        return;
+    }
+
+    const bool topLevel = depth_ == 1 && keyValid_;
+    const bool arrayItem = depth_ == 2 && isArray(1) && keyValid_;
+    if (c == '"') {
+        stringIsKey_ = false;
+        if (topLevel) beginCapture(kString);
+        else if (arrayItem) beginCapture(kArrayItem);
+        lex_ = kInString;
+    } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+        scalarFirst_ = c;
+        if (topLevel) beginCapture(kNumber);
+        captureByte(c);
+        lex_ = kInScalar;
+    } else {
+        lex_ = kError;
+    }
+}
+
+void JsonStreamScanner::endString() {
+    if (stringIsKey_) {
+        stringIsKey_ = false;
+        if (depth_ == 1) key_[keyLen_] = '\0';
+        lex_ = kExpectColon;
+        return;
+    }
+    commitCapture();
+    afterValue();
+}
+
+void JsonStreamScanner::endScalar() {
+    if (capturing_) {
+        ValueType t = scalarFirst_ == 't' ? kTrue
+                    : scalarFirst_ == 'f' ? kFalse
+                    : scalarFirst_ == 'n' ? kNull
+                                          : kNumber;
+        arena_[recordStart_] = t;
+    }
+    commitCapture();
+    afterValue();
+}
+
+void JsonStreamScanner::closeContainer(uint8_t c) {
+    if (depth_ == 0 || c != (isArray(depth_ - 1) ? ']' : '}')) {
+        lex_ = kError;
+        return;
+    }
+    depth_--;
+    afterValue();
+}
+
+void JsonStreamScanner::afterValue() {
+    lex_ = depth_ == 0 ? kDone : kAfterValue;
+}
+
+void JsonStreamScanner::beginCapture(ValueType type) {
+    if (overBudget_) return;
+    size_t header = 2 + keyLen_ + 1 + 2;
+    if (used_ + header + 1 > arenaSize_) {
+        overBudget_ = true;
+        return;
+    }
+    recordStart_ = used_;
+    arena_[used_++] = type;
+    arena_[used_++] = keyLen_;
+    memcpy(arena_ + used_, key_, keyLen_);
+    used_ += keyLen_;
+    arena_[used_++] = '\0';
+    used_ += 2; // length, patched on commit
+    valueLen_ = 0;
+    capturing_ = true;
+}
+
+void JsonStreamScanner::captureByte(uint8_t c) {
+    if (!capturing_) return;
+    // Leave room for the terminating NUL written on commit.
+    if (used_ + 2 > arenaSize_ || valueLen_ == 0xFFFF) {
+        overBudget_ = true;
+        capturing_ = false;
+        used_ = recordStart_;
+        return;
+    }
+    arena_[used_++] = c;
+    valueLen_++;
+}
+
+void JsonStreamScanner::captureUtf8(uint16_t cp) {
+    if (cp >= 0xD800 && cp <= 0xDFFF) {
+        captureByte('?'); // surrogate halves: the display font has no glyphs anyway
+    } else if (cp < 0x80) {
+        captureByte(cp);
+    } else if (cp < 0x800) {
+        captureByte(0xC0 | (cp >> 6));
+        captureByte(0x80 | (cp & 0x3F));
+    } else {
+        captureByte(0xE0 | (cp >> 12));
+        captureByte(0x80 | ((cp >> 6) & 0x3F));
+        captureByte(0x80 | (cp & 0x3F));
+    }
+}
+
+void JsonStreamScanner::commitCapture() {
+    if (!capturing_) return;
+    size_t lenPos = recordStart_ + 2 + arena_[recordStart_ + 1] + 1;
+    arena_[lenPos] = valueLen_ & 0xFF;
+    arena_[lenPos + 1] = valueLen_ >> 8;
+    arena_[used_++] = '\0';
+    capturing_ = false;
+}
+
+bool JsonStreamScanner::next(size_t &cursor, Field &out) const {
+    size_t end = capturing_ ? recordStart_ : used_;
+    if (cursor >= end) return false;
+    const uint8_t *r = arena_ + cursor;
+    out.type = (ValueType)r[0];
+    out.keyLen = r[1];
+    out.key = (const char *)r + 2;
+    const uint8_t *len = r + 2 + out.keyLen + 1;
+    out.valueLen = len[0] | (len[1] << 8);
+    out.value = (const char *)len + 2;
+    cursor += 2 + out.keyLen + 1 + 2 + out.valueLen + 1;
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef JSON_STREAM_SCANNER_H
+#define JSON_STREAM_SCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-at-a-time JSON scanner for payloads too large to buffer. It keeps no
+// copy of the input; only the parts our handlers use are captured into a
+// fixed, caller-supplied arena:
+//   - top-level scalars  ({"status":"firing", "id":42, ...})
+//   - string elements of top-level arrays  ({"lines":["a","b"]})
+// Nested objects and non-string array items are skipped. If the captured
+// data would exceed the arena the message is marked over budget and the
+// rest of the input is still consumed, so the caller can count the
+// rejection without disturbing the MQTT stream.
+class JsonStreamScanner {
+public:
+    enum Result : uint8_t {
+        kPending = 0,  // value not finished yet
+        kComplete,     // one full top-level object captured
+        kOverBudget,   // arena exhausted
+        kMalformed,    // not a JSON object, or syntax error
+    };
+
+    enum ValueType : uint8_t { kString, kNumber, kTrue, kFalse, kNull, kArrayItem };
+
+    // One captured field, as seen when iterating with next().
+    struct Field {
+        const char *key;    // NUL-terminated, points into the arena
+        uint8_t keyLen;
+        ValueType type;
+        const char *value;  // NUL-terminated, points into the arena
+        uint16_t valueLen;
+    };
+
+    JsonStreamScanner(uint8_t *arena, size_t arenaSize);
+
+    void reset();
+    void push(uint8_t c);
+    void push(const uint8_t *data, size_t len);
+
+    Result result() const;
+    size_t received() const { return received_; }
+    size_t used() const { return used_; }
+
+    // Iterate captured fields in input order. Pass cursor = 0 to start;
+    // returns false once exhausted.
+    bool next(size_t &cursor, Field &out) const;
+
+private:
+    static constexpr uint8_t kMaxDepth = 16;
+    static constexpr uint8_t kMaxKey = 32;
+
+    enum Lex : uint8_t {
+        kExpectValue,
+        kExpectValueOrEnd,
+        kExpectKeyOrEnd,
+        kExpectKey,
+        kExpectColon,
+        kAfterValue,
+        kInString,
+        kInEscape,
+        kInUnicode,
+        kInScalar,
+        kDone,
+        kError,
+    };
+
+    void step(uint8_t c);
+    void beginValue(uint8_t c);
+    void endScalar();
+    void endString();
+    void closeContainer(uint8_t c);
+    void afterValue();
+    bool isArray(uint8_t level) const { return (arrayMask_ >> level) & 1; }
+
+    void beginCapture(ValueType type);
+    void captureByte(uint8_t c);
+    void captureUtf8(uint16_t cp);
+    void commitCapture();
+
+    uint8_t *arena_;
+    size_t arenaSize_;
+    size_t used_ = 0;
+    size_t received_ = 0;
+
+    Lex lex_ = kExpectValue;
+    uint8_t depth_ = 0;
+    uint16_t arrayMask_ = 0;
+    bool stringIsKey_ = false;
+    bool overBudget_ = false;
+
+    // Key of the current depth-1 member.
+    char key_[kMaxKey];
+    uint8_t keyLen_ = 0;
+    bool keyValid_ = false;
+
+    // In-progress capture record (header lives at recordStart_).
+    bool capturing_ = false;
+    size_t recordStart_ = 0;
+    uint16_t valueLen_ = 0;
+
+    // Literal/number first byte, and \uXXXX accumulator.
+    uint8_t scalarFirst_ = 0;
+    uint16_t unicode_ = 0;
+    uint8_t unicodeDigits_ = 0;
+};
+
+#endif // JSON_STREAM_SCANNER_H
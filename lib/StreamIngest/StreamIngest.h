@@ -0,0 +1,40 @@
+#ifndef STREAM_INGEST_H
+#define STREAM_INGEST_H
+
+#include <Arduino.h>
+#include "JsonStreamScanner.h"
+
+// Write-only Stream handed to PubSubClient::setStream(). PubSubClient pushes
+// every PUBLISH payload byte through write() as it comes off the socket,
+// including the bytes that no longer fit its own buffer, so the scanner
+// sees the whole message even when the callback only gets a truncated copy.
+// Call begin() before each mqttClient.loop(): one loop() reads at most one
+// packet, which keeps messages from bleeding into each other.
+class StreamIngest : public Stream {
+public:
+    explicit StreamIngest(JsonStreamScanner &scanner) : scanner_(scanner) {}
+
+    void begin() { scanner_.reset(); }
+
+    // True if the broker sent more payload than the callback received.
+    bool truncated(unsigned int callbackLength) const {
+        return scanner_.received() > callbackLength;
+    }
+
+    size_t write(uint8_t c) override {
+        scanner_.push(c);
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override {
+        scanner_.push(buffer, size);
+        return size;
+    }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    JsonStreamScanner &scanner_;
+};
+
+#endif // STREAM_INGEST_H
@@ -0,0 +1,39 @@
+#include "TextHistory.h"
+
+void TextHistory::put(char c, uint32_t color) {
+    Line &cur = lines_[head_];
+    if (c == '\r') return;
+    if (c == '\n') {
+        head_ = (head_ + 1) % kLines;
+        if (complete_ < kLines - 1) complete_++;
+        Line &next = lines_[head_];
+        next.len = 0;
+        next.text[0] = '\0';
+        return;
+    }
+    if (cur.len == 0) cur.color = color;
+    if (cur.len < kCols) {
+        cur.text[cur.len++] = c;
+        cur.text[cur.len] = '\0';
+    }
+}
+
+void TextHistory::clear() {
+    head_ = 0;
+    complete_ = 0;
+    lines_[0].len = 0;
+    lines_[0].text[0] = '\0';
+}
+
+uint8_t TextHistory::count() const {
+    return complete_ + (lines_[head_].len ? 1 : 0);
+}
+
+const char *TextHistory::line(uint8_t back, uint32_t *color) const {
+    // Skip an empty in-progress line so index 0 is the last visible text.
+    uint8_t skip = lines_[head_].len ? 0 : 1;
+    if (back + skip > complete_) return nullptr;
+    const Line &l = lines_[(head_ + kLines - back - skip) % kLines];
+    if (color) *color = l.color;
+    return l.text;
+}
@@ -0,0 +1,36 @@
+#ifndef TEXT_HISTORY_H
+#define TEXT_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Ring of the most recent text lines printed to the message canvas, with
+// the colour each line started in, so older output can be scrolled back
+// to after it has scrolled off the panel. Lines longer than kCols are
+// truncated; the newest (possibly unfinished) line is index 0.
+class TextHistory {
+public:
+    static constexpr uint8_t kLines = 64;
+    static constexpr uint8_t kCols = 63;
+
+    void put(char c, uint32_t color);
+    void clear();
+
+    // Lines available, including an unfinished current one.
+    uint8_t count() const;
+    // back = 0 is the newest line. Returns nullptr past the oldest.
+    const char *line(uint8_t back, uint32_t *color) const;
+
+private:
+    struct Line {
+        uint32_t color;
+        uint8_t len;
+        char text[kCols + 1];
+    };
+
+    Line lines_[kLines] = {};
+    uint8_t head_ = 0;     // line being written
+    uint8_t complete_ = 0; // finished lines held (<= kLines - 1)
+};
+
+#endif // TEXT_HISTORY_H
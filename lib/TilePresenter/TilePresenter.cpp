@@ -0,0 +1,184 @@
+#include "TilePresenter.h"
+
+#include <string.h>
+
+bool TilePresenter::begin(uint16_t width, uint16_t height) {
+    const uint16_t cols = (width + kTile - 1) / kTile;
+    const uint16_t rows = (height + kTile - 1) / kTile;
+    if (!width || !height || cols * rows > kMaxTiles) return false;
+    width_ = width;
+    height_ = height;
+    cols_ = (uint8_t)cols;
+    rows_ = (uint8_t)rows;
+    return true;
+}
+
+int8_t TilePresenter::addTarget(Push push, void *ctx, uint32_t minIntervalMs, uint32_t maxPixels) {
+    if (targetCount_ == kMaxTargets) return -1;
+    Target &t = targets_[targetCount_];
+    memset(&t, 0, sizeof(t));
+    t.push = push;
+    t.ctx = ctx;
+    t.minIntervalMs = minIntervalMs;
+    t.maxPixels = maxPixels;
+    return targetCount_++;
+}
+
+void TilePresenter::invalidate(int8_t target) {
+    if (target >= 0 && target < targetCount_) memset(targets_[target].known, 0, sizeof(targets_[target].known));
+}
+
+// FNV-1a over the tile's rows, a word at a time.
+uint32_t TilePresenter::hashTile(const uint8_t *frame, uint16_t col, uint16_t row) const {
+    const uint16_t x0 = col * kTile;
+    const uint16_t y0 = row * kTile;
+    const uint16_t w = x0 + kTile <= width_ ? kTile : width_ - x0;
+    const uint16_t y1 = y0 + kTile <= height_ ? y0 + kTile : height_;
+    uint32_t h = 2166136261u;
+    for (uint16_t y = y0; y < y1; y++) {
+        const uint8_t *p = frame + (size_t)y * width_ + x0;
+        uint16_t x = 0;
+        for (; x + 4 <= w; x += 4) {
+            uint32_t word;
+            memcpy(&word, p + x, 4);
+            h = (h ^ word) * 16777619u;
+        }
+        for (; x < w; x++) h = (h ^ p[x]) * 16777619u;
+    }
+    return h;
+}
+
+bool TilePresenter::due(const Target &t, uint32_t nowMs) const { return (int32_t)(nowMs - t.dueMs) >= 0; }
+
+void TilePresenter::present(const uint8_t *frame, uint32_t nowMs) {
+    for (uint8_t r = 0; r < rows_; r++) {
+        for (uint8_t c = 0; c < cols_; c++) hashes_[r * cols_ + c] = hashTile(frame, c, r);
+    }
+    for (uint8_t i = 0; i < targetCount_; i++) {
+        Target &t = targets_[i];
+        if (t.pending) t.stats.skipped++;
+        else t.changedMs = nowMs;
+        t.pending = true;
+        if (due(t, nowMs)) flush(t, nowMs);
+    }
+}
+
+void TilePresenter::service(uint32_t nowMs) {
+    for (uint8_t i = 0; i < targetCount_; i++) {
+        Target &t = targets_[i];
+        if (t.pending && due(t, nowMs)) flush(t, nowMs);
+    }
+}
+
+uint32_t TilePresenter::msUntilNext(uint32_t nowMs) const {
+    uint32_t next = kIdle;
+    for (uint8_t i = 0; i < targetCount_; i++) {
+        const Target &t = targets_[i];
+        if (!t.pending) continue;
+        const int32_t wait = (int32_t)(t.dueMs - nowMs);
+        const uint32_t ms = wait > 0 ? (uint32_t)wait : 0;
+        if (ms < next) next = ms;
+    }
+    return next;
+}
+
+uint32_t TilePresenter::pixels(const Rect &r) const {
+    const uint16_t x1 = (r.col + r.cols) * kTile < width_ ? (r.col + r.cols) * kTile : width_;
+    const uint16_t y1 = (r.row + r.rows) * kTile < height_ ? (r.row + r.rows) * kTile : height_;
+    return (uint32_t)(x1 - r.col * kTile) * (y1 - r.row * kTile);
+}
+
+// Push a rectangle of tiles; from here on the display shows them.
+void TilePresenter::pushRect(Target &t, const Rect &r) {
+    const uint16_t x = r.col * kTile;
+    const uint16_t y = r.row * kTile;
+    const uint16_t x1 = (r.col + r.cols) * kTile < width_ ? (r.col + r.cols) * kTile : width_;
+    const uint16_t y1 = (r.row + r.rows) * kTile < height_ ? (r.row + r.rows) * kTile : height_;
+    t.push(t.ctx, x, y, x1 - x, y1 - y);
+    t.stats.rects++;
+    t.stats.pixels += (uint32_t)(x1 - x) * (y1 - y);
+    for (uint8_t row = r.row; row < r.row + r.rows; row++) {
+        for (uint8_t col = r.col; col < r.col + r.cols; col++) {
+            const uint16_t i = row * cols_ + col;
+            t.sent[i] = hashes_[i];
+            t.known[i] = true;
+        }
+    }
+}
+
+// Push the tiles that differ from what the target was last sent, up to its
+// pixel budget.
+void TilePresenter::flush(Target &t, uint32_t nowMs) {
+    Rect rects[kMaxRects];
+    uint8_t count = 0;
+    bool overflow = false;
+    uint8_t c0 = 0xFF, r0 = 0xFF, c1 = 0, r1 = 0; // bounding box of the changes
+    for (uint8_t r = 0; r < rows_; r++) {
+        uint8_t c = 0;
+        while (c < cols_) {
+            if (!dirty(t, r * cols_ + c)) {
+                c++;
+                continue;
+            }
+            uint8_t end = c;
+            while (end < cols_ && dirty(t, r * cols_ + end)) end++;
+            if (c < c0) c0 = c;
+            if (r < r0) r0 = r;
+            if (end > c1) c1 = end;
+            r1 = r + 1;
+            // Same span as a rectangle ending on the row above: grow it.
+            bool merged = false;
+            for (uint8_t k = 0; k < count && !merged; k++) {
+                Rect &q = rects[k];
+                if (q.col == c && q.cols == end - c && q.row + q.rows == r) {
+                    q.rows++;
+                    merged = true;
+                }
+            }
+            if (!merged) {
+                if (count < kMaxRects) rects[count++] = {c, r, (uint8_t)(end - c), 1};
+                else overflow = true;
+            }
+            c = end;
+        }
+    }
+    if (c0 == 0xFF) { // nothing differs for this target
+        t.pending = false;
+        return;
+    }
+    if (overflow) {
+        rects[0] = {c0, r0, (uint8_t)(c1 - c0), (uint8_t)(r1 - r0)};
+        count = 1;
+    }
+
+    uint32_t used = 0;
+    for (uint8_t k = 0; k < count; k++) {
+        Rect r = rects[k];
+        if (t.maxPixels) {
+            // As many whole tile rows as the budget allows, at least one.
+            const uint32_t rowPixels = pixels({r.col, r.row, r.cols, 1});
+            uint8_t rows = 0;
+            while (rows < r.rows && ((rows == 0 && used == 0) || used + (rows + 1) * rowPixels <= t.maxPixels)) rows++;
+            if (!rows) break;
+            const bool partial = rows < r.rows;
+            r.rows = rows;
+            pushRect(t, r);
+            used += rows * rowPixels;
+            if (partial) break;
+        } else {
+            pushRect(t, r);
+        }
+    }
+    for (uint16_t i = 0; i < (uint16_t)cols_ * rows_; i++) {
+        if (dirty(t, i)) { // budget ran out: the rest in a moment
+            t.stats.slices++;
+            t.dueMs = nowMs + kResumeMs;
+            return;
+        }
+    }
+    t.pending = false;
+    t.dueMs = nowMs + t.minIntervalMs;
+    t.stats.frames++;
+    const uint32_t lag = nowMs - t.changedMs;
+    if (lag > t.stats.maxLagMs) t.stats.maxLagMs = lag;
+}
@@ -0,0 +1,93 @@
+#ifndef TILE_PRESENTER_H
+#define TILE_PRESENTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Presents one 8-bit frame to several displays, each getting only the parts
+// that changed since what it was last sent.
+//
+// present() hashes the frame in kTile x kTile tiles, once for all displays.
+// Each target keeps the tile hashes it last received; the tiles that differ
+// are merged into rectangles (runs along a tile row, then identical runs on
+// following rows) and handed to its push callback. A target with a minimum
+// interval that isn't due yet is skipped and caught up by service(): it
+// gets the frame as it is then, so a slow display drops intermediate frames
+// instead of queueing them. A target with a pixel budget is sent at most
+// that much per call, in whole tile rows, and the rest kResumeMs later, so
+// one large change can't hold up the loop or the other displays.
+class TilePresenter {
+public:
+    static constexpr uint8_t kTile = 16;
+    static constexpr uint16_t kMaxTiles = 160; // 240 x 135 in 16 px tiles
+    static constexpr uint8_t kMaxTargets = 3;
+    static constexpr uint8_t kMaxRects = 8; // more than this: one bounding box
+    static constexpr uint32_t kResumeMs = 20; // between slices of a budgeted push
+    static constexpr uint32_t kIdle = 0xFFFFFFFF;
+
+    // Copy the frame rectangle (pixels, frame coordinates) to the display.
+    typedef void (*Push)(void *ctx, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+    struct Stats {
+        uint32_t frames;  // changes fully delivered
+        uint32_t skipped; // presents folded into a later push by the rate limit
+        uint32_t slices;  // pushes cut short by the pixel budget
+        uint32_t rects;
+        uint64_t pixels;
+        uint32_t maxLagMs; // longest a change waited on the rate limit
+    };
+
+    // False if the frame needs more than kMaxTiles tiles.
+    bool begin(uint16_t width, uint16_t height);
+    // minIntervalMs 0 pushes on every present(); maxPixels 0 sends all
+    // changes at once. Returns the target id, or -1 if full.
+    int8_t addTarget(Push push, void *ctx, uint32_t minIntervalMs, uint32_t maxPixels = 0);
+    // Send the whole frame to this target next time, e.g. after it was
+    // cleared behind our back.
+    void invalidate(int8_t target);
+
+    // The frame changed: rehash it and push to every target that is due.
+    void present(const uint8_t *frame, uint32_t nowMs);
+    // Push to targets whose interval has run out since.
+    void service(uint32_t nowMs);
+    // Until a rate-limited or sliced target is due; kIdle if none is waiting.
+    uint32_t msUntilNext(uint32_t nowMs) const;
+
+    uint8_t targets() const { return targetCount_; }
+    const Stats &stats(int8_t target) const { return targets_[target].stats; }
+    uint16_t tileCount() const { return cols_ * rows_; }
+
+private:
+    struct Target {
+        Push push;
+        void *ctx;
+        uint32_t minIntervalMs;
+        uint32_t maxPixels;
+        uint32_t dueMs;
+        uint32_t changedMs; // first present not yet delivered
+        bool pending;
+        uint32_t sent[kMaxTiles];
+        bool known[kMaxTiles]; // sent[] holds what the display shows
+        Stats stats;
+    };
+    struct Rect {
+        uint8_t col, row, cols, rows;
+    };
+
+    uint32_t hashTile(const uint8_t *frame, uint16_t col, uint16_t row) const;
+    bool due(const Target &t, uint32_t nowMs) const;
+    void flush(Target &t, uint32_t nowMs);
+    bool dirty(const Target &t, uint16_t tile) const { return !t.known[tile] || t.sent[tile] != hashes_[tile]; }
+    uint32_t pixels(const Rect &r) const;
+    void pushRect(Target &t, const Rect &r);
+
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    uint8_t cols_ = 0;
+    uint8_t rows_ = 0;
+    uint32_t hashes_[kMaxTiles];
+    Target targets_[kMaxTargets];
+    uint8_t targetCount_ = 0;
+};
+
+#endif // TILE_PRESENTER_H
@@ -0,0 +1,98 @@
+#include "TimerWheel.h"
+
+int8_t TimerWheel::add(Callback cb, void *arg, uint32_t periodMs) {
+    if (count_ >= kMaxTimers) return -1;
+    Timer &t = timers_[count_];
+    t.cb = cb;
+    t.arg = arg;
+    t.period = periodMs;
+    t.next = -1;
+    t.armed = false;
+    return (int8_t)count_++;
+}
+
+void TimerWheel::link(int8_t id) {
+    uint8_t slot = slotFor(timers_[id].deadline);
+    timers_[id].next = slots_[slot];
+    slots_[slot] = id;
+}
+
+void TimerWheel::unlink(int8_t id) {
+    int8_t *p = &slots_[slotFor(timers_[id].deadline)];
+    while (*p != -1) {
+        if (*p == id) {
+            *p = timers_[id].next;
+            break;
+        }
+        p = &timers_[*p].next;
+    }
+    timers_[id].next = -1;
+}
+
+void TimerWheel::start(int8_t id, uint32_t delayMs, uint32_t nowMs) {
+    if (id < 0 || id >= count_) return;
+    if (timers_[id].armed) unlink(id);
+    if (!primed_) {
+        lastTick_ = nowMs / kTickMs;
+        primed_ = true;
+    }
+    timers_[id].deadline = nowMs + delayMs;
+    timers_[id].armed = true;
+    link(id);
+}
+
+void TimerWheel::stop(int8_t id) {
+    if (!armed(id)) return;
+    unlink(id);
+    timers_[id].armed = false;
+}
+
+size_t TimerWheel::advance(uint32_t nowMs) {
+    if (!primed_) return 0;
+    const uint32_t nowTick = nowMs / kTickMs;
+    // Visit each slot between the last processed tick and now, at most one
+    // full rotation (a long stall still reaches every bucket once).
+    uint32_t steps = nowTick - lastTick_;
+    if (steps >= kSlots) steps = kSlots - 1;
+    uint32_t tick = nowTick - steps;
+    size_t fired = 0;
+    for (;; tick++) {
+        int8_t id = slots_[tick % kSlots];
+        while (id != -1) {
+            Timer &t = timers_[id];
+            int8_t next = t.next;
+            if ((int32_t)(nowMs - t.deadline) >= 0) {
+                unlink(id);
+                t.armed = false;
+                if (t.period) {
+                    // Keep the cadence, but don't replay missed periods.
+                    t.deadline += t.period;
+                    if ((int32_t)(nowMs - t.deadline) >= 0) t.deadline = nowMs + t.period;
+                    t.armed = true;
+                    link(id);
+                }
+                fired++;
+                t.cb(t.arg); // may re-arm or stop any timer, including this one
+                // The chain may have changed under us; restart the slot.
+                next = slots_[tick % kSlots];
+            }
+            id = next;
+        }
+        if (tick == nowTick) break;
+    }
+    lastTick_ = nowTick;
+    fired_ += fired;
+    return fired;
+}
+
+uint32_t TimerWheel::msUntilNext(uint32_t nowMs, uint32_t maxMs) const {
+    uint32_t best = maxMs;
+    for (uint8_t i = 0; i < count_; i++) {
+        const Timer &t = timers_[i];
+        if (!t.armed) continue;
+        int32_t left = (int32_t)(t.deadline - nowMs);
+        if (left <= 0) return 0;
+        if ((uint32_t)left < best) best = (uint32_t)left;
+    }
+    return best;
+}
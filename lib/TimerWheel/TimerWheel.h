@@ -0,0 +1,62 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hashed timer wheel for a cooperative loop. Timers live in kSlots buckets
+// of kTickMs each, chained through a fixed table, so arming, cancelling and
+// advancing are O(1) per timer with no allocation. Deadlines further out than
+// one rotation simply stay in their bucket until their time comes round.
+//
+// The loop sleeps for msUntilNext() (or until an I/O event), then calls
+// advance() to fire whatever has expired.
+class TimerWheel {
+public:
+    typedef void (*Callback)(void *arg);
+
+    static constexpr uint8_t kMaxTimers = 24;
+    static constexpr uint8_t kSlots = 32;
+    static constexpr uint32_t kTickMs = 10;
+
+    // Register a timer; periodMs 0 makes it one-shot. Returns its id, or -1
+    // if the table is full. Timers start disarmed.
+    int8_t add(Callback cb, void *arg, uint32_t periodMs = 0);
+
+    // (Re)arm to fire delayMs from now. A periodic timer then repeats.
+    void start(int8_t id, uint32_t delayMs, uint32_t nowMs);
+    void stop(int8_t id);
+    bool armed(int8_t id) const { return id >= 0 && id < count_ && timers_[id].armed; }
+
+    // Fire every timer whose deadline is <= nowMs. Returns the number fired.
+    size_t advance(uint32_t nowMs);
+
+    // Milliseconds until the earliest armed deadline, capped at maxMs.
+    uint32_t msUntilNext(uint32_t nowMs, uint32_t maxMs) const;
+
+    uint32_t fired() const { return fired_; }
+
+private:
+    struct Timer {
+        Callback cb;
+        void *arg;
+        uint32_t period;
+        uint32_t deadline;
+        int8_t next; // next timer in the same slot, -1 ends the chain
+        bool armed;
+    };
+
+    static uint8_t slotFor(uint32_t ms) { return (ms / kTickMs) % kSlots; }
+    void link(int8_t id);
+    void unlink(int8_t id);
+
+    Timer timers_[kMaxTimers] = {};
+    int8_t slots_[kSlots] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                             -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+    uint8_t count_ = 0;
+    bool primed_ = false;
+    uint32_t lastTick_ = 0; // last tick (ms / kTickMs) advance() processed
+    uint32_t fired_ = 0;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,124 @@
+#include "TopicRouter.h"
+
+#include <string.h>
+
+bool TopicRouter::validFilter(const char *filter) {
+    if (!filter || !*filter) return false;
+    const char *p = filter;
+    while (*p) {
+        const char *slash = strchr(p, '/');
+        size_t len = slash ? (size_t)(slash - p) : strlen(p);
+        for (size_t i = 0; i < len; i++) {
+            if ((p[i] == '+' || p[i] == '#') && len != 1) return false;
+        }
+        if (len == 1 && p[0] == '#' && slash) return false;
+        if (!slash) break;
+        p = slash + 1;
+        if (!*p) break; // trailing '/' is an empty final level
+    }
+    return true;
+}
+
+void TopicRouter::clear() {
+    nodes_.clear();
+    pool_.clear();
+    routes_.clear();
+}
+
+uint16_t TopicRouter::newNode(const char *token, size_t len) {
+    Node n;
+    n.token = pool_.size();
+    n.tokenLen = len;
+    n.firstChild = kNone;
+    n.nextSibling = kNone;
+    n.plusChild = kNone;
+    n.route = -1;
+    n.hashRoute = -1;
+    pool_.append(token, len);
+    nodes_.push_back(n);
+    return nodes_.size() - 1;
+}
+
+uint16_t TopicRouter::literalChild(uint16_t parent, const char *token, size_t len, bool create) {
+    for (uint16_t c = nodes_[parent].firstChild; c != kNone; c = nodes_[c].nextSibling) {
+        const Node &n = nodes_[c];
+        if (n.tokenLen == len && memcmp(pool_.data() + n.token, token, len) == 0) {
+            return c;
+        }
+    }
+    if (!create) return kNone;
+    uint16_t c = newNode(token, len);
+    nodes_[c].nextSibling = nodes_[parent].firstChild;
+    nodes_[parent].firstChild = c;
+    return c;
+}
+
+bool TopicRouter::add(const char *filter, uint8_t handler, uint8_t qos) {
+    if (!validFilter(filter) || strlen(filter) > 255) return false;
+    if (nodes_.empty()) newNode("", 0); // root
+
+    uint16_t node = 0;
+    const char *p = filter;
+    int16_t *slot = nullptr;
+    for (;;) {
+        const char *slash = strchr(p, '/');
+        size_t len = slash ? (size_t)(slash - p) : strlen(p);
+        if (len == 1 && p[0] == '#') {
+            slot = &nodes_[node].hashRoute;
+            break;
+        }
+        if (len == 1 && p[0] == '+') {
+            if (nodes_[node].plusChild == kNone) {
+                uint16_t c = newNode("+", 1);
+                nodes_[node].plusChild = c;
+            }
+            node = nodes_[node].plusChild;
+        } else {
+            node = literalChild(node, p, len, true);
+        }
+        if (!slash) {
+            slot = &nodes_[node].route;
+            break;
+        }
+        p = slash + 1;
+    }
+
+    if (*slot >= 0) return false;
+    *slot = routes_.size();
+    routes_.push_back(Route{filter, handler, qos > 1 ? (uint8_t)1 : qos});
+    return true;
+}
+
+int16_t TopicRouter::matchFrom(uint16_t node, const char *level, const char *end, bool firstLevel) const {
+    const char *slash = (const char *)memchr(level, '/', end - level);
+    const bool last = slash == nullptr;
+    size_t len = last ? (size_t)(end - level) : (size_t)(slash - level);
+    const Node &n = nodes_[node];
+
+    // Literal child first, then '+', then '#'.
+    for (uint16_t c = n.firstChild; c != kNone; c = nodes_[c].nextSibling) {
+        const Node &child = nodes_[c];
+        if (child.tokenLen != len || memcmp(pool_.data() + child.token, level, len) != 0) continue;
+        int16_t r = last ? (child.route >= 0 ? child.route : child.hashRoute)
+                         : matchFrom(c, slash + 1, end, false);
+        if (r >= 0) return r;
+        break;
+    }
+
+    const bool wildcardsAllowed = !(firstLevel && len > 0 && level[0] == '$');
+    if (!wildcardsAllowed) return -1;
+
+    if (n.plusChild != kNone) {
+        const Node &child = nodes_[n.plusChild];
+        int16_t r = last ? (child.route >= 0 ? child.route : child.hashRoute)
+                         : matchFrom(n.plusChild, slash + 1, end, false);
+        if (r >= 0) return r;
+    }
+    return n.hashRoute;
+}
+
+const TopicRouter::Route *TopicRouter::match(const char *topic) const {
+    if (nodes_.empty() || !topic) return nullptr;
+    int16_t r = matchFrom(0, topic, topic + strlen(topic), true);
+    return r >= 0 ? &routes_[r] : nullptr;
+}
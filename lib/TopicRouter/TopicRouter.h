@@ -0,0 +1,61 @@
+#ifndef TOPIC_ROUTER_H
+#define TOPIC_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Maps MQTT topics to handler ids using the subscription filters we
+// registered, so a message can be dispatched (or dropped) before its payload
+// is parsed. Filters are compiled into a flat trie, one node per topic
+// level, with dedicated '+' and '#' branches. Matching walks the topic once
+// without allocating. Precedence when several filters match: a literal
+// level beats '+', which beats '#'.
+//
+// MQTT semantics: '+' matches exactly one level (possibly empty), '#' matches
+// the parent level and everything below it, and wildcards in the first
+// level never match topics that start with '$'.
+class TopicRouter {
+public:
+    struct Route {
+        std::string filter;
+        uint8_t handler;
+        uint8_t qos;
+    };
+
+    // Returns false if the filter is malformed ('#' not last, wildcard not
+    // alone in its level, empty filter) or the same filter is already routed.
+    bool add(const char *filter, uint8_t handler, uint8_t qos);
+    void clear();
+
+    const Route *match(const char *topic) const;
+
+    size_t size() const { return routes_.size(); }
+    const Route &route(size_t i) const { return routes_[i]; }
+
+    static bool validFilter(const char *filter);
+
+private:
+    static constexpr uint16_t kNone = 0xFFFF;
+
+    struct Node {
+        uint16_t token;      // offset into pool_
+        uint8_t tokenLen;
+        uint16_t firstChild; // literal children, linked through nextSibling
+        uint16_t nextSibling;
+        uint16_t plusChild;
+        int16_t route;       // filter ending exactly here
+        int16_t hashRoute;   // filter ending in '#' below this node
+    };
+
+    uint16_t newNode(const char *token, size_t len);
+    uint16_t literalChild(uint16_t parent, const char *token, size_t len, bool create);
+    int16_t matchFrom(uint16_t node, const char *level, const char *end, bool firstLevel) const;
+
+    std::vector<Node> nodes_;
+    std::string pool_;
+    std::vector<Route> routes_;
+};
+
+#endif // TOPIC_ROUTER_H
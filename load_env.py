@@ -29,6 +29,11 @@ SPEC = [
     ("MQTT_CLEAN_SESSION", "1",               "bool"),
     ("MQTT_TLS",           "0",               "bool"),
     ("MQTT_TLS_INSECURE",  "0",               "bool"),
+    ("MQTT_PUB_TOPIC",     "m5notify/{client}", "str"),
+    ("POWER_LISTEN_INTERVAL", "3",            "int"),
+    ("POWER_LIGHT_SLEEP",  "1",               "bool"),
+    ("CPU_GOVERNOR",       "1",               "bool"),
+    ("POWER_PANEL_SLEEP",  "1",               "bool"),
 ]
 
 
@@ -4,12 +4,41 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "SPIFFSManager.h"
+#include "KvStore.h"
+#include "StreamInflate.h"
+#include "StreamIngest.h"
+#include "TopicRouter.h"
+#include "PublishQueue.h"
+#include "StageProfiler.h"
+#include "ClockSync.h"
+#include "HeapMonitor.h"
+#include "AsyncLog.h"
+#include "TimerWheel.h"
+#include "PowerManager.h"
+#include "CpuGovernor.h"
+#include "ButtonInput.h"
+#include "ButtonGesture.h"
+#include "TextHistory.h"
+#include "SensorSampler.h"
+#include "StatusCells.h"
+#include "EnergyModel.h"
+#include "FSBench.h"
+#include "BootProfiler.h"
+#include "FrameSnapshot.h"
+#include "AudioEngine.h"
+#include "IconImage.h"
+#include "TilePresenter.h"
 #include <WiFi.h>
 #include <WiFiMulti.h>
 #include <M5UnitLCD.h>
 #include <M5Unified.h>
 #include <PubSubClient.h>
 #include <vector>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <esp_vfs_eventfd.h>
+#include <unistd.h>
 
 #ifndef MQTT_TLS
 #define MQTT_TLS 0
@@ -69,10 +98,45 @@
 #define MQTT_TLS_INSECURE 0
 #endif
 
+// Base topic for everything the device publishes (receipts, telemetry).
+// "{client}" expands to MQTT_CLIENT_ID.
+#ifndef MQTT_PUB_TOPIC
+#define MQTT_PUB_TOPIC "m5notify/{client}"
+#endif
+
+// Beacon intervals the radio may sleep through between wakeups (1 = every
+// DTIM). Higher saves power at the cost of inbound latency.
+#ifndef POWER_LISTEN_INTERVAL
+#define POWER_LISTEN_INTERVAL 3
+#endif
+
+#ifndef POWER_LIGHT_SLEEP
+#define POWER_LIGHT_SLEEP 1
+#endif
+
+// 0 pins the CPU at 240 MHz (baseline for comparing latency).
+#ifndef CPU_GOVERNOR
+#define CPU_GOVERNOR 1
+#endif
+
+// Put the LCD controller to sleep while the backlight is off.
+#ifndef POWER_PANEL_SLEEP
+#define POWER_PANEL_SLEEP 1
+#endif
+
+// Keep a copy of the message canvas in LittleFS and show it at boot.
+#ifndef SCREEN_SNAPSHOT
+#define SCREEN_SNAPSHOT 1
+#endif
+
 /******************************************************************************
  *                    GLOBAL OBJECTS & VARIABLES
  ******************************************************************************/
 SPIFFSManager spiffsManager(LittleFS);
+// Settings log: one appended record per change, replayed into RAM at boot.
+// Wi-Fi credentials are stored as "wifi/<ssid>" -> password.
+KvStore kvStore(spiffsManager, "/kv.log", "/kv.tmp");
+static const char kWifiKeyPrefix[] = "wifi/";
 
 #if MQTT_TLS
 WiFiClientSecure wifiClient;
@@ -81,8 +145,87 @@ WiFiClient wifiClient;
 #endif
 WiFiMulti wifiMulti;
 PubSubClient mqttClient(wifiClient);
-M5Canvas canvas(&M5.Display);
-M5Canvas statusBar(&M5.Display);   // double-buffered top status bar (kills flicker)
+// The message canvas, remembering what was printed to it so BtnB can page
+// back through lines that have scrolled off. Any new output returns to the
+// live view first.
+class HistoryCanvas : public M5Canvas
+{
+public:
+  using M5Canvas::M5Canvas;
+  using M5Canvas::write;
+
+  size_t write(uint8_t c) override
+  {
+    if (back_) showLive();
+    history_.put((char)c, getTextStyle().fore_rgb888);
+    return M5Canvas::write(c);
+  }
+
+  // Page towards older (pages > 0) or newer lines. False if already at that end.
+  bool page(int pages)
+  {
+    const int rows = visibleRows();
+    int maxBack = (int)history_.count() - rows;
+    int back = back_ + pages * (rows > 1 ? rows - 1 : 1);
+    if (back > maxBack) back = maxBack;
+    if (back < 0) back = 0;
+    if (back == back_) return false;
+    back_ = back;
+    render();
+    return true;
+  }
+  bool showLive()
+  {
+    if (!back_) return false;
+    back_ = 0;
+    render();
+    return true;
+  }
+  bool scrolledBack() const { return back_ != 0; }
+  // Repaint the current page from history, e.g. over the boot splash.
+  void redraw() { render(); }
+  // Add a line to the history without drawing it, standing in for
+  // something drawn by other means (an image) when the page is repainted.
+  void record(const char *text)
+  {
+    const uint32_t color = getTextStyle().fore_rgb888;
+    while (*text) history_.put(*text++, color);
+    history_.put('\n', color);
+  }
+  void clearHistory()
+  {
+    history_.clear();
+    back_ = 0;
+  }
+
+private:
+  int visibleRows() { return height() / (fontHeight() ? fontHeight() : 1); }
+
+  // Redraw the page ending back_ lines before the newest. Written below the
+  // recording write() so replayed text isn't recorded again.
+  void render()
+  {
+    fillSprite(BLACK);
+    setCursor(0, 0);
+    for (int i = back_ + visibleRows() - 1; i >= back_; i--)
+    {
+      uint32_t color;
+      const char *text = history_.line(i, &color);
+      if (!text) continue;
+      setTextColor(color);
+      while (*text) M5Canvas::write((uint8_t)*text++);
+      M5Canvas::write((uint8_t)'\n');
+    }
+    setTextColor(WHITE);
+  }
+
+  TextHistory history_;
+  int back_ = 0;
+};
+HistoryCanvas canvas(&M5.Display);
+// Top status bar, drawn cell by cell from cached icon sprites (see
+// drawStatusBar()). Each cell is pushed as one transfer, so nothing flickers.
+StatusCells statusCells;
 static constexpr int kStatusBarHeight = 24;
 // Dark navy gives the status bar subtle definition vs. the black canvas
 // without measurably affecting power (same number of pixels written).
@@ -90,7 +233,6 @@ static constexpr uint16_t kStatusBarBG = 0x0841; // ~rgb(8,8,12)
 #ifndef FIRMWARE_VERSION
 #define FIRMWARE_VERSION "v1.1"
 #endif
-long mqttLastReconnectAttempt = 0;
 bool isCharging = false;
 bool enableDimming = true; // Enable dimming when on battery
 const uint32_t connectTimeoutMs = 10000;
@@ -103,22 +245,507 @@ struct StatusBarState {
   bool mqttConnected;
   int  batLevel;       // 0..100
   bool charging;
+  bool loopStall;      // a loop iteration overran its budget recently
+};
+static StatusBarState lastStatus = {false, -1, false, -1, false, false};
+
+// gzip payloads are inflated through a 4 KB ring window straight into the
+// JSON parser, so the inflated text never exists as one buffer. Producers
+// must compress with wbits <= 12 (see Readme).
+static constexpr uint8_t kInflateWindowBits = 12;
+static uint8_t inflateWindow[1 << kInflateWindowBits];
+StreamInflate inflater(inflateWindow, kInflateWindowBits);
+
+// Running totals for compressed payloads; the last message's figures are
+// kept separately so the per-message ratio/cost can be reported.
+struct InflateStats {
+  uint32_t messages;
+  uint32_t failures;
+  uint64_t bytesIn;
+  uint64_t bytesOut;
+  uint64_t decodeUs;
+  uint32_t lastIn;
+  uint32_t lastOut;
+  uint32_t lastUs;
+};
+static InflateStats inflateStats = {};
+
+// Image messages (see IconImage) are decoded row by row into the canvas.
+// Decoded icons are kept by content hash, so a repeat is one copy.
+static constexpr size_t kIconCacheBytes = 16 * 1024;
+IconCache iconCache(kIconCacheBytes);
+struct ImageStats {
+  uint32_t messages;
+  uint32_t failures;
+  uint32_t decoded;  // cache misses
+  uint64_t decodeUs; // ... and their total decode + draw time
+};
+static ImageStats imageStats = {};
+
+// Payloads bigger than the PubSubClient buffer are parsed incrementally as
+// they come off the socket. Only the fields the handlers use are kept, in a
+// fixed arena; anything that doesn't fit is rejected and counted.
+static constexpr size_t kStreamBudget = 3072;
+static uint8_t streamArena[kStreamBudget];
+JsonStreamScanner streamScanner(streamArena, sizeof(streamArena));
+StreamIngest streamIngest(streamScanner);
+
+struct StreamStats {
+  uint32_t messages;
+  uint32_t overBudget;
+  uint32_t malformed;
+  uint32_t largest;
+};
+static StreamStats streamStats = {};
+
+// Topic routing. Each subscription filter maps to one handler, chosen before
+// the payload is touched; topics without a route are dropped unparsed.
+// Routes come from /topics.json, falling back to MQTT_TOPIC -> auto.
+enum TopicHandler : uint8_t
+{
+  kHandlerAuto,       // sniff the payload format (original single-topic behaviour)
+  kHandlerGithub,
+  kHandlerGrafana,
+  kHandlerWifiConfig,
+  kHandlerCommand,
+  kHandlerIgnore,
+  kHandlerPong,       // clock-sync replies on <base>/pong (added automatically)
+};
+static const struct
+{
+  const char *name;
+  TopicHandler id;
+} kHandlerNames[] = {
+    {"auto", kHandlerAuto},
+    {"github", kHandlerGithub},
+    {"grafana", kHandlerGrafana},
+    {"wifi", kHandlerWifiConfig},
+    {"command", kHandlerCommand},
+    {"ignore", kHandlerIgnore},
+    {"pong", kHandlerPong},
+};
+TopicRouter topicRouter;
+static size_t userRouteCount = 0; // routes before the automatic pong route
+
+struct RouteStats {
+  uint32_t routed;
+  uint32_t dropped;
+};
+static RouteStats routeStats = {};
+
+// Outbound path: receipts and telemetry are queued and only flushed while
+// the link is already busy (right after inbound traffic), or once the oldest
+// receipt has waited kReceiptMaxDelayMs.
+static bool mqttPublishRaw(const char *topic, const uint8_t *payload, size_t len)
+{
+  return mqttClient.publish(topic, payload, len, false);
+}
+PublishQueue publishQueue(mqttPublishRaw);
+String pubTopicBase;
+
+enum ReceiptEvent : uint8_t
+{
+  kReceiptDisplayed,
+  kReceiptAcked,
+};
+struct Receipt {
+  char id[24];
+  ReceiptEvent event;
+  uint32_t atMs;
+};
+static constexpr size_t kMaxReceipts = 16;
+static constexpr unsigned long kReceiptMaxDelayMs = 30000;
+static constexpr unsigned long kTelemetryIntervalMs = 300000;
+static Receipt pendingReceipts[kMaxReceipts];
+static size_t pendingReceiptCount = 0;
+static unsigned long firstReceiptAt = 0;
+// Notifications shown but not yet acknowledged with BtnA.
+static char unackedIds[kMaxReceipts][24];
+static size_t unackedCount = 0;
+// Producer "id" of the message being handled, echoed back in its receipt.
+static char currentMessageId[24] = "";
+static uint32_t localMessageSeq = 0;
+static uint32_t outboundSeq = 0;
+static bool linkHot = false; // inbound traffic just arrived; radio is awake
+
+// Per-stage latency of the packet -> pixels pipeline, timed with micros()
+// (esp_timer). Cycle counts can't be converted to time once the governor has
+// switched the clock inside an interval. Histograms cover the last stats
+// window; they are published on <base>/stats and dumped by "stats".
+enum PipelineStage : uint8_t
+{
+  kStageReceive,  // mqttClient.loop() entry to callback entry
+  kStageRoute,    // topic trie lookup
+  kStageCopy,     // payload copy out of the PubSubClient buffer
+  kStageParse,    // deserializeJson (incl. inflate / stream rebuild)
+  kStageRender,   // handler drawing, excluding pushes
+  kStagePush,     // canvas.pushSprite()
+  kStageCallback, // whole callback
+  kStageCount,
+};
+static const char *const kStageNames[kStageCount] = {
+    "recv", "route", "copy", "parse", "render", "push", "total"};
+StageProfiler stageProfiler(kStageNames, kStageCount);
+static constexpr unsigned long kStatsIntervalMs = 60000;
+static uint32_t loopStartUs = 0;
+static uint32_t pushUs = 0; // pushes inside the current render
+
+// Record the time since `start` (micros()) against a stage; returns now.
+static uint32_t endStage(uint8_t stage, uint32_t start)
+{
+  uint32_t now = micros();
+  stageProfiler.record(stage, now - start);
+  return now;
+}
+
+static void endRender(uint32_t start)
+{
+  uint32_t elapsed = micros() - start;
+  stageProfiler.record(kStageRender, elapsed > pushUs ? elapsed - pushUs : 0);
+}
+
+// Main-loop iteration time, split by section. Anything that blocks here
+// delays the next mqttClient.loop() and therefore every message behind it;
+// the idle wait in waitForEvents() is deliberately outside the iteration.
+enum LoopSection : uint8_t
+{
+  kSectionInput,    // button edges and gestures
+  kSectionPower,    // charge detection, brightness fade, status bar
+  kSectionWifi,     // wifiConnect(); association runs on the link task
+  kSectionMqttConn, // handing a connect to the link task
+  kSectionMqttLoop, // mqttClient.loop() incl. the message callback
+  kSectionOutbound, // receipts, telemetry, stats, publish queue
+  kSectionConsole,  // serial command polling
+  kSectionHeap,     // periodic heap walk
+  kSectionDisplay,  // Unit LCD mirror pushes, wherever they happen
+  kSectionStorage,  // deferred LittleFS writes (snapshot, KV compaction)
+  kSectionAudio,    // handing the next note to the speaker
+  kSectionCount,
+};
+static const char *const kSectionNames[kSectionCount] = {
+    "input", "power", "wifi", "mqttconn", "mqttloop", "outbound",
+    "console", "heap", "display", "storage", "audio"};
+static constexpr uint32_t kLoopBudgetUs = 100000;
+static constexpr unsigned long kStallAlertHoldMs = 30000; // status-bar marker hold
+LoopProfiler loopProfiler(kSectionNames, kSectionCount, kLoopBudgetUs);
+static unsigned long lastStallMs = 0;
+
+// Cooperative scheduler. loop() sleeps in select() on the MQTT socket and
+// the input wake fd until one becomes readable or the next timer is due,
+// instead of polling everything every 50 ms.
+TimerWheel timers;
+static int8_t buttonTimer = -1;
+static int8_t fadeTimer = -1;
+static int8_t statusTimer = -1;
+static int8_t sensorTimer = -1;
+static int8_t wifiTimer = -1;
+static int8_t mqttConnectTimer = -1;
+static int8_t linkTimer = -1;
+static int8_t heapTimer = -1;
+static int8_t kvTimer = -1;
+static constexpr uint32_t kKvCompactDelayMs = 5000; // let a burst of writes settle first
+static int8_t splashTimer = -1;
+static int8_t bootTimer = -1;
+static int8_t snapshotTimer = -1;
+static constexpr uint32_t kSnapshotQuietMs = 10000; // after the last present
+static constexpr uint32_t kInputPollMs = 50;     // only without the wake fd
+static constexpr uint32_t kFadeStepMs = 100;
+static constexpr uint32_t kStatusPollMs = 2000;  // status bar (cached values only)
+static constexpr uint32_t kWifiPollMs = 500;
+static constexpr uint32_t kMqttRetryMs = 15000;
+static constexpr uint32_t kSplashMs = 800;
+static constexpr uint32_t kBootReportMs = 30000; // report even if the broker never answers
+static constexpr uint32_t kLinkServiceMs = 1000; // keepalive + outbound timers
+static constexpr uint32_t kMaxSleepMs = 1000;
+static constexpr uint32_t kSocketPollMs = 50;    // when the socket can't be select()ed
+static uint8_t currentBrightness = 0;
+
+// Boot phases, printed once the first subscription is sent (or after
+// kBootReportMs). Marked from the loop task only.
+BootProfiler bootProfiler;
+static bool bootReported = false;
+static bool splashUp = false; // canvas pushes wait until the splash is cleared
+static uint32_t splashStartMs = 0;
+
+// Screen snapshot: the canvas, run-length coded into kSnapshotPath once the
+// screen has been quiet for kSnapshotQuietMs, and pushed back to the panel
+// early in the next boot, before the network is up.
+static const char kSnapshotPath[] = "/screen.rle";
+static const char kSnapshotTmpPath[] = "/screen.tmp";
+static uint32_t canvasVersion = 0;   // bumped by every presentCanvas()
+static uint32_t snapshotVersion = 0; // canvasVersion the file holds
+struct SnapshotStats {
+  uint32_t bytes;     // file size, header included
+  uint32_t encodeUs;  // coding alone
+  uint32_t writeUs;   // coding, write and rename; at boot, the last one before the reset
+  uint32_t writes;
+  uint32_t restoreUs; // read, decode and push at boot
+};
+static SnapshotStats snapshotStats = {};
+
+// Link task: Wi-Fi association (wifiMulti.run() scans and blocks for
+// seconds) and the MQTT/TLS connect run here, off the loop. While mqttBusy
+// is set the task owns mqttClient and the loop leaves it alone. Results come
+// back as linkEvents bits plus a poke on wakeFd; the task never logs or
+// draws (AsyncLog and the canvas belong to the loop).
+enum LinkEvent : uint8_t { kLinkWifiUp = 1, kLinkMqttUp = 2, kLinkMqttFailed = 4 };
+static TaskHandle_t linkTaskHandle = nullptr;
+static std::atomic<uint8_t> linkEvents{0};
+static std::atomic<bool> mqttBusy{false};
+static int64_t wifiUpUs = 0;       // written by the task before kLinkWifiUp
+static int64_t mqttUpUs = 0;       // ... before kLinkMqttUp
+static int64_t subscribedUs = 0;
+static constexpr uint32_t kWifiRetryMs = 5000;
+static constexpr uint32_t kWifiConnectTimeoutMs = 5000;
+
+static bool mqttUp() { return !mqttBusy.load() && mqttClient.connected(); }
+
+// Deferred present. With the backlight off nobody can see the panel, so
+// presentCanvas() and drawStatusBar() only mark their sprite dirty; the
+// first setBacklight() above zero pushes each dirty one once.
+static bool panelDark = false;
+static bool canvasDirty = false;
+static bool statusBarDirty = false;
+struct PresentStats {
+  uint32_t pushes;       // canvas or status-bar presents to the panel
+  uint32_t deferred;     // presents skipped while dark
+  uint32_t flushes;      // consolidated presents on wake
+  uint32_t canvasBytes;  // message-canvas bytes pushed
+  uint32_t barBytes;     // status-bar bytes actually pushed (changed cells)
+  uint32_t barFullBytes; // what pushing the whole bar each time would have cost
+};
+static PresentStats presentStats = {};
+
+// Message canvas presenter: the canvas is hashed in 16 px tiles once per
+// present and each display is sent only the tiles that changed since its
+// last push. The internal panel gets every present; an M5 Unit LCD on I2C,
+// if attached, mirrors it at most every kMirrorIntervalMs and at most
+// kMirrorSlicePixels per push, so it lags behind a burst instead of
+// holding up the loop.
+TilePresenter presenter;
+static M5GFX *mirrorPanel = nullptr;
+static int8_t mirrorTimer = -1;
+static constexpr uint32_t kMirrorIntervalMs = 250;
+static constexpr uint32_t kMirrorSlicePixels = 240 * TilePresenter::kTile; // ~90 ms at 400 kHz, 8-bit
+
+// Estimated charge per component, from the residency and activity counters
+// above. Currents are rough StickC Plus2 figures; the model corrects its
+// total against the battery gauge (see EnergyModel::calibrate()).
+static const EnergyModel::Coefficients kEnergyCoefficients = {
+    30.0f,   // backlightFullMa at level 255
+    50.0f,   // cpuHighMa, 240 MHz running
+    25.0f,   // cpuLowMa, 80 MHz running
+    12.0f,   // cpuIdleMa, clock-gated idle
+    1.0f,    // lightSleepMa
+    12.0f / POWER_LISTEN_INTERVAL, // radioUpMa, DTIM wakes thinned by the listen interval
+    25.0f,   // radioDownMa, ~1 s scans every 5 s while offline
+    0.5f,    // radioWakeMas, ~5 ms at 100 mA per received burst
+    3.0f,    // panelMa, LCD controller out of sleep
+    0.006f,  // spiMasPerKB, 40 MHz SPI with the CPU busy
+    40.0f,   // speakerMa
+    2.0f,    // baseMa: LDO, IMU, RTC
+};
+static constexpr float kBatteryCapacityMah = 200.0f;
+static constexpr uint32_t kEnergyTickMs = 60000;
+EnergyModel energy(kEnergyCoefficients, kBatteryCapacityMah);
+static EnergyModel::Integrator backlightEnergy; // level * us
+static EnergyModel::Integrator radioEnergy;     // 1 while associated
+static EnergyModel::Integrator panelEnergy;     // 1 while the controller is awake
+static int8_t energyTimer = -1;
+static uint64_t energyTickUs = 0; // start of the current accounting tick
+
+// Alert sounds: one AudioEngine event per kind of notification, from
+// /sounds.json or kDefaultSounds. Notes go to the speaker by playRaw() on
+// kAudioChannel from audioTimer, so posting one from a message handler
+// costs a queue insert.
+static constexpr uint32_t kSpeakerRate = 192000;
+static constexpr int kAudioChannel = 0;
+static bool playAudio(void *, const int8_t *cycle, size_t len, uint32_t rate, uint32_t repeat, bool stopCurrent)
+{
+  return M5.Speaker.playRaw(cycle, len, rate, false, repeat, kAudioChannel, stopCurrent);
+}
+AudioEngine audio(playAudio, nullptr, kSpeakerRate);
+static int8_t audioTimer = -1;
+
+// Buttons are interrupt-driven: the ISR queues timestamped edges and pokes
+// wakeFd, an eventfd that loop() selects on next to the socket. Serial RX
+// pokes it too. Gestures are decoded here, on the loop task.
+enum Button : uint8_t { kBtnA, kBtnB, kButtonCount };
+static const gpio_num_t kButtonPins[kButtonCount] = {GPIO_NUM_37, GPIO_NUM_39};
+ButtonInput buttons;
+static ButtonGesture gestures[kButtonCount];
+static int wakeFd = -1;
+static bool buttonsPolled = false; // no interrupts: sample levels on a timer
+
+// Wake loop() out of select(). Safe from any task.
+static void pokeLoop()
+{
+  if (wakeFd < 0) return;
+  uint64_t one = 1;
+  write(wakeFd, &one, sizeof(one));
+}
+
+// Battery, charger and RSSI are read only by the sampler, each at its own
+// rate; everything else uses its cached values. Channel ids follow add order.
+enum Sensor : uint8_t { kSensorCharging, kSensorBattery, kSensorRssi, kSensorCount };
+static constexpr uint32_t kChargePollMs = 4000;    // brightness follows the charger
+static constexpr uint32_t kBatteryPollMs = 60000;  // % moves over minutes
+static constexpr uint32_t kRssiPollMs = 10000;
+SensorSampler sensors;
+
+// Idle power: Wi-Fi power save plus automatic light sleep while the screen
+// is dark. BtnA (GPIO37) and BtnB (GPIO39) wake the chip.
+PowerManager powerManager;
+static int64_t socketWakeUs = 0; // last wake caused by socket data
+
+// 80 MHz while idle, 240 MHz from the moment work lands until kHoldMs after
+// the last of it.
+CpuGovernor cpuGovernor;
+static int8_t governorTimer = -1;
+
+static void boostCpu(CpuGovernor::Reason reason)
+{
+  uint32_t now = millis();
+  cpuGovernor.boost(reason, now);
+  timers.start(governorTimer, CpuGovernor::kHoldMs, now);
+}
+
+// Per-message callback time, bucketed by the clock it ran at.
+struct ClockScope {
+  uint32_t start;
+  ~ClockScope() { cpuGovernor.recordLatency(micros() - start); }
+};
+
+struct SchedStats {
+  uint32_t wakeups;
+  uint32_t socketWakeups;
+  uint32_t inputWakeups;
+};
+static SchedStats schedStats = {};
+
+static inline bool loopStallAlert()
+{
+  return loopProfiler.overruns() && millis() - lastStallMs < kStallAlertHoldMs;
+}
+
+// End-to-end producer -> pixels latency. Producers may stamp payloads with
+// "ts" (epoch ms); the device maps its own clock onto theirs via ping/pong
+// on <base>/ping and <base>/pong, answered by tools/latency_probe.py.
+ClockSync clockSync;
+SampleWindow e2eLatency;
+static constexpr unsigned long kPingIntervalMs = 30000;
+// Without a peer on <base>/pong, pings back off (doubling after
+// kPingUnanswered) to kPingMaxIntervalMs; a pong restores kPingIntervalMs.
+static constexpr uint8_t kPingUnanswered = 3;
+static constexpr unsigned long kPingMaxIntervalMs = 30UL * 60 * 1000;
+static unsigned long pingIntervalMs = kPingIntervalMs;
+static uint8_t unansweredPings = 0;
+static int64_t currentMessageTs = 0;
+static uint32_t pingSeq = 0;
+
+// Heap health: sampled every kHeapSampleMs, plus the free size before and
+// after each message handler so leaks can be pinned on a message type.
+HeapMonitor heapMonitor;
+static constexpr unsigned long kHeapSampleMs = 60000;
+static uint8_t heapFlags = 0;
+
+static HeapSample heapSnapshot()
+{
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  return {(uint32_t)info.total_free_bytes, (uint32_t)info.largest_free_block,
+          (uint32_t)info.minimum_free_bytes, (uint32_t)info.allocated_blocks};
+}
+
+// Charges whatever the enclosing handler leaves allocated to `handler`.
+// Reads only the free size: a full heap_caps_get_info() walk per message
+// costs more and is no less noisy with the other tasks allocating.
+struct HeapScope {
+  uint8_t handler;
+  uint32_t freeBefore;
+  ~HeapScope() { heapMonitor.account(handler, freeBefore, heap_caps_get_free_size(MALLOC_CAP_8BIT)); }
+};
+
+// Log records are formatted and written to the UART by an idle-priority
+// task, so a 115200 baud port never stalls the loop or the MQTT callback.
+static TaskHandle_t logTaskHandle = nullptr;
+
+static void logSink(const char *text, size_t len) { Serial.write((const uint8_t *)text, len); }
+static uint32_t logClock() { return millis(); }
+static void logWake()
+{
+  if (logTaskHandle) xTaskNotifyGive(logTaskHandle);
+}
+
+static void logTask(void *)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    AsyncLog::instance().drain();
+  }
+}
+
+static void startLogger()
+{
+  AsyncLog::instance().begin(logSink, logClock, logWake);
+  xTaskCreatePinnedToCore(logTask, "log", 4096, nullptr, tskIDLE_PRIORITY, &logTaskHandle, 0);
+  logWake(); // anything logged before the task existed
+}
+
+// Records the enclosing scope's duration when it exits.
+struct StageScope {
+  uint8_t stage;
+  uint32_t start;
+  ~StageScope() { endStage(stage, start); }
 };
-static StatusBarState lastStatus = {false, -1, false, -1, false};
 
 /******************************************************************************
  *                        FUNCTION PROTOTYPES
  ******************************************************************************/
-JsonDocument loadWifiConfig(SPIFFSManager &spiffsManager);
+size_t loadWifiConfig(KvStore &kv);
 bool wifiConnect();
 boolean mqttReconnect();
 void mqttCallback(char *topic, byte *payload, unsigned int length);
 void displayWifiStatus();
-JsonDocument updateWifiConfig(SPIFFSManager &spiffsManager, const char *ssid, const char *password);
+bool updateWifiConfig(KvStore &kv, const char *ssid, const char *password);
 void displayBatteryStatus();
 void displayMQTTStatus();
 void handleGithubEventJSON(const JsonDocument &event);
 void handleGrafanaEventJSON(const JsonDocument &event);
+void dispatchJsonMessage(JsonDocument &doc);
+void dispatchRoutedJson(uint8_t handler, JsonDocument &doc);
+void applyWifiConfigMessage(const JsonDocument &doc);
+void handleCommand(const char *command, bool fromConsole = false);
+bool handleCompressedMessage(const byte *payload, unsigned int length, uint8_t handler);
+bool handleStreamedMessage(uint8_t handler);
+bool handleImageMessage(const byte *payload, unsigned int length);
+void loadTopicRoutes(SPIFFSManager &spiffsManager);
+void loadSoundTheme(SPIFFSManager &spiffsManager);
+void onNotificationShown(uint8_t handler);
+void recordReceipt(const char *id, ReceiptEvent event);
+void acknowledgeDisplayed();
+void serviceOutbound();
+void presentCanvas();
+void pushCanvasRect(void *ctx, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+void dumpStageStats();
+void dumpLoopStats();
+void dumpHeapStats();
+void dumpPowerStats();
+void dumpCpuStats();
+void dumpEnergyStats();
+void runFsBench();
+void startLinkTask();
+void reportBoot();
+#if SCREEN_SNAPSHOT
+bool restoreSnapshot();
+#endif
+void serviceHeapMonitor();
+void wakeScreen();
+void startScheduler();
+void startSensors();
+void pollSerialCommands();
+void handlePong(const JsonDocument &doc);
 void scanWifiNetworks();
 void drawStatusBar();
 void refreshStatusBar(bool force = false);
@@ -136,7 +763,9 @@ const uint8_t dimBrightness = 0;
  ******************************************************************************/
 void setup()
 {
+  bootProfiler.mark("core", esp_timer_get_time()); // ROM, bootloader, Arduino core
   Serial.begin(115200);
+  startLogger();
   auto cfg = M5.config();
   M5.begin(cfg);
   { // Configure speaker with custom I2S settings
@@ -144,32 +773,103 @@ void setup()
     spk_cfg.buzzer = true;
     if (spk_cfg.use_dac || spk_cfg.buzzer)
     {
-      spk_cfg.sample_rate = 192000;
+      spk_cfg.sample_rate = kSpeakerRate;
     }
     M5.Speaker.config(spk_cfg);
   }
   M5.Power.begin();
+  {
+    PowerManager::Config pm = {};
+    pm.listenInterval = POWER_LISTEN_INTERVAL;
+    pm.lightSleep = POWER_LIGHT_SLEEP;
+    pm.maxFreqMhz = 240;
+    pm.minFreqMhz = 80;
+    pm.wakePins[0] = GPIO_NUM_37;
+    pm.wakePins[1] = GPIO_NUM_39;
+    pm.wakePinCount = 2;
+    powerManager.begin(pm);
+    cpuGovernor.begin(pm.minFreqMhz, pm.maxFreqMhz, powerManager.pmActive(), CPU_GOVERNOR);
+  }
   // Start the speaker once at boot. The previous code called begin()/end()
   // around every tone which slowed the MQTT callback and could miss notes.
   M5.Speaker.begin();
+  LOGI("Started");
+  bootProfiler.mark("m5", esp_timer_get_time());
+
+  /**************************************************************************
+   *  Credentials first, so the radio can associate in the background while
+   *  the display comes up.
+   **************************************************************************/
+  const bool fsMounted = LittleFS.begin(FORMAT_SPIFFS_IF_FAILED);
+  size_t wifiNetworks = 0;
+  if (fsMounted)
+  {
+    pubTopicBase = MQTT_PUB_TOPIC;
+    pubTopicBase.replace("{client}", MQTT_CLIENT_ID);
+    // A reset during fsbench leaves its files, possibly most of the partition.
+    if (uint16_t stale = FSBench::removeLeftovers("/littlefs"))
+      LOGW("Removed %u files left by an interrupted fsbench", (unsigned)stale);
+    loadTopicRoutes(spiffsManager);
+    loadSoundTheme(spiffsManager);
+    if (!kvStore.begin())
+      LOGE("Settings log has a bad tail and couldn't be rewritten; settings are read-only");
+    wifiNetworks = loadWifiConfig(kvStore);
+    kvStore.forEach(kWifiKeyPrefix, [](const char *key, const char *password) {
+      const char *ssid = key + sizeof(kWifiKeyPrefix) - 1;
+      LOGI("Adding Network SSID: >%s<", ssid);
+      wifiMulti.addAP(ssid, password);
+    });
+  }
+  bootProfiler.mark("fs", esp_timer_get_time());
 
-  delay(3000);
-  Serial.println("Started");
+  if (fsMounted)
+  {
+#if MQTT_TLS
+#if MQTT_TLS_INSECURE
+    // WARNING: skips certificate validation. Acceptable only for local/dev brokers.
+    wifiClient.setInsecure();
+#else
+    // TODO: load broker CA via wifiClient.setCACert(...) for production use.
+    // Falling back to insecure mode if no CA is provided.
+    wifiClient.setInsecure();
+#endif
+#endif
+    mqttClient.setServer(MQTT_HOST, MQTT_PORT);
+    mqttClient.setCallback(mqttCallback);
+    // PubSubClient defaults to a 256-byte RX/TX buffer, which silently drops
+    // any larger MQTT payload. Match the callback cap (4 KB) so big JSON
+    // messages actually reach mqttCallback().
+    mqttClient.setBufferSize(4096);
+    // Anything larger is still streamed through streamIngest byte by byte.
+    mqttClient.setStream(streamIngest);
+    // Give the broker more slack on slow Wi-Fi: 15 s socket timeout, 60 s keepalive.
+    mqttClient.setSocketTimeout(15);
+    mqttClient.setKeepAlive(60);
+
+    // wifiMulti picks the strongest known SSID; the link task runs it.
+    LOGI("Connecting Wifi...");
+    startLinkTask();
+  }
+  bootProfiler.mark("radio", esp_timer_get_time());
 
-  M5.setPrimaryDisplayType({m5::board_t::board_M5UnitLCD});
-  M5.Display.setRotation(3);
-  M5.Display.setColorDepth(8);
-  M5.Display.fillScreen(BLACK);
+  // The internal panel stays primary; an attached Unit LCD mirrors it.
+  const int mirrorIndex = M5.getDisplayIndex(m5::board_t::board_M5UnitLCD);
+  if (mirrorIndex >= 0 && &M5.Displays(mirrorIndex) != &M5.Display) mirrorPanel = &M5.Displays(mirrorIndex);
 
   /**************************************************************************
-   *                Initialize the Status Bar Sprite (double-buffered)
+   *                Initialize the Status Bar (background; cells come later)
    **************************************************************************/
-  statusBar.setColorDepth(8);
-  statusBar.createSprite(M5.Display.width(), kStatusBarHeight);
-  statusBar.fillSprite(kStatusBarBG);
-  statusBar.pushSprite(0, 0);
-  // 1-px divider between status bar and message canvas
-  M5.Display.drawFastHLine(0, kStatusBarHeight, M5.Display.width(), DARKGREY);
+  statusCells.layout(M5.Display.width(), kStatusBarHeight);
+  for (M5GFX *panel : {&M5.Display, mirrorPanel})
+  {
+    if (!panel) continue;
+    panel->setRotation(3);
+    panel->setColorDepth(8);
+    panel->fillScreen(BLACK);
+    panel->fillRect(0, 0, panel->width(), kStatusBarHeight, kStatusBarBG);
+    // 1-px divider between status bar and message canvas
+    panel->drawFastHLine(0, kStatusBarHeight, panel->width(), DARKGREY);
+  }
 
   /**************************************************************************
    *                Initialize the Scrollable Text Canvas
@@ -181,13 +881,23 @@ void setup()
   canvas.setTextColor(WHITE);
   canvas.setTextScroll(true);
   canvas.fillSprite(BLACK);
-  canvas.pushSprite(0, kStatusBarHeight + 1);
+  presenter.begin(canvas.width(), canvas.height());
+  presenter.addTarget(pushCanvasRect, &M5.Display, 0);
+  if (mirrorPanel) presenter.addTarget(pushCanvasRect, mirrorPanel, kMirrorIntervalMs, kMirrorSlicePixels);
+  bootProfiler.mark("display", esp_timer_get_time());
 
   /**************************************************************************
-   *                Boot splash (one-time, ~800 ms)
+   *  Last boot's screen if there is a snapshot, otherwise the boot splash.
+   *  The splash stays up for kSplashMs without blocking: canvas pushes are
+   *  held back until splashTimer repaints the canvas from history.
    **************************************************************************/
+  bool restored = false;
+#if SCREEN_SNAPSHOT
+  if (fsMounted) restored = restoreSnapshot();
+  if (restored) bootProfiler.mark("restore", esp_timer_get_time());
+#endif
+  if (!restored)
   {
-    canvas.fillSprite(BLACK);
     canvas.setTextDatum(middle_center);
     int cx = canvas.width() / 2;
     int cy = canvas.height() / 2;
@@ -199,240 +909,495 @@ void setup()
     canvas.drawString(FIRMWARE_VERSION, cx, cy + 14);
     canvas.setTextDatum(top_left);
     canvas.setTextColor(WHITE);
-    canvas.pushSprite(0, kStatusBarHeight + 1);
-    delay(800);
-    canvas.fillSprite(BLACK);
-    canvas.pushSprite(0, kStatusBarHeight + 1);
+    presentCanvas();
+    splashUp = true;
+    splashStartMs = millis();
   }
 
-  if (!LittleFS.begin(FORMAT_SPIFFS_IF_FAILED))
+  if (!fsMounted)
   {
-    Serial.println("LittleFS Mount Failed");
+    LOGE("LittleFS Mount Failed");
+    splashUp = false;
+    canvas.redraw();
     canvas.println("FS Mount Failed");
+    presentCanvas();
     return;
   }
+  canvas.printf("Loaded %d wifi networks\n", (int)wifiNetworks);
+  presentCanvas();
 
-  WiFi.mode(WIFI_STA);
-
-
-  JsonDocument wifiJSON = loadWifiConfig(spiffsManager);
-  for (JsonObject network : wifiJSON.as<JsonArray>())
-  {
-    const char *ssid = network["ssid"];
-    const char *password = network["password"];
-    Serial.printf("Adding Network SSID: >%s<\n", ssid ? ssid : "");
-    if (ssid && password) {
-      wifiMulti.addAP(ssid, password);
-    }
-  }
-
-#if MQTT_TLS
-#if MQTT_TLS_INSECURE
-  // WARNING: skips certificate validation. Acceptable only for local/dev brokers.
-  wifiClient.setInsecure();
-#else
-  // TODO: load broker CA via wifiClient.setCACert(...) for production use.
-  // Falling back to insecure mode if no CA is provided.
-  wifiClient.setInsecure();
-#endif
-#endif
-  mqttClient.setServer(MQTT_HOST, MQTT_PORT);
-  mqttClient.setCallback(mqttCallback);
-  // PubSubClient defaults to a 256-byte RX/TX buffer, which silently drops
-  // any larger MQTT payload. Match the callback cap (4 KB) so big JSON
-  // messages actually reach mqttCallback().
-  mqttClient.setBufferSize(4096);
-  // Give the broker more slack on slow Wi-Fi: 15 s socket timeout, 60 s keepalive.
-  mqttClient.setSocketTimeout(15);
-  mqttClient.setKeepAlive(60);
-
-  // Connect to Wi-Fi using wifiMulti (connects to the SSID with strongest connection)
-  Serial.println("Connecting Wifi...");
-  if(wifiMulti.run() == WL_CONNECTED) {
-    Serial.println("");
-    Serial.println("WiFi connected");
-    Serial.println("IP address: ");
-    Serial.println(WiFi.localIP());
-    canvas.setTextColor(GREEN);
-    canvas.printf("WiFi connected: %s\n", WiFi.SSID().c_str());
-    canvas.setTextColor(WHITE);
-    canvas.pushSprite(0, kStatusBarHeight + 1);
-  }
+  startSensors();
   refreshStatusBar(true); // initial paint
+  startScheduler();
+  bootProfiler.mark("setup", esp_timer_get_time());
 }
 
 
 /******************************************************************************
  *                         HELPER FUNCTIONS
  ******************************************************************************/
-JsonDocument updateWifiConfig(SPIFFSManager &spiffsManager, const char *ssid, const char *password)
+// Store one network's credentials. Costs one small append to the KV log, or
+// nothing if they are unchanged.
+bool updateWifiConfig(KvStore &kv, const char *ssid, const char *password)
+{
+  String key = String(kWifiKeyPrefix) + ssid;
+  const bool stored = kv.put(key.c_str(), password);
+  // Also after a failure: a read-only log retries its compaction.
+  if (kv.needsCompaction()) timers.start(kvTimer, kKvCompactDelayMs, millis());
+  if (!stored)
+  {
+    canvas.println("Failed to store wifi config.");
+    return false;
+  }
+  LOGD("Updated wifi config for %s", ssid);
+  return true;
+}
+
+// Older firmware kept every network in /wifi.json and rewrote the whole file
+// on each change. Import it once, then drop the file; if it can't be read or
+// a network can't be stored, the file stays and the import is retried at
+// the next boot.
+static void migrateWifiJson(KvStore &kv)
 {
+  if (!spiffsManager.fileExists("/wifi.json")) return;
   JsonDocument wifiDoc;
-  if (!spiffsManager.fileExists("/wifi.json"))
+  DeserializationError err = spiffsManager.readJson("/wifi.json", wifiDoc);
+  if (err || !wifiDoc.is<JsonArray>())
   {
-    canvas.println("wifi.json does not exist, creating new file.");
-    wifiDoc.to<JsonArray>(); // create an empty array
+    LOGW("/wifi.json unreadable (%s), kept for the next boot", err ? err.c_str() : "not an array");
+    return;
   }
-  else
+  bool stored = true;
+  for (JsonObject network : wifiDoc.as<JsonArray>())
   {
-    String wifis = spiffsManager.readFile("/wifi.json");
-    Serial.printf("Read wifi file content: '%s'\n", wifis.c_str());
-    DeserializationError error = deserializeJson(wifiDoc, wifis);
-    if (error || !wifiDoc.is<JsonArray>())
-    {
-      canvas.println("Error parsing wifi.json; creating new array.");
-      wifiDoc.clear();
-      wifiDoc.to<JsonArray>();
-    }
+    const char *ssid = network["ssid"];
+    const char *password = network["password"];
+    if (ssid && password) stored = updateWifiConfig(kv, ssid, password) && stored;
   }
-  JsonArray array = wifiDoc.as<JsonArray>();
-  bool found = false;
-  for (JsonObject cred : array)
+  if (!stored)
   {
-    if (cred["ssid"].is<const char *>() && strcmp(cred["ssid"], ssid) == 0)
-    {
-      cred["password"] = password;
-      found = true;
-      break;
-    }
+    LOGW("/wifi.json only partly migrated, kept for the next boot");
+    return;
   }
-  if (!found)
+  LOGI("Migrated /wifi.json to the KV store.");
+  spiffsManager.deleteFile("/wifi.json");
+}
+
+size_t loadWifiConfig(KvStore &kv)
+{
+  migrateWifiJson(kv);
+
+  size_t count = 0;
+  kv.forEach(kWifiKeyPrefix, [&count](const char *, const char *) { count++; });
+
+  // Only seed with env-var defaults the first time around; afterwards we
+  // trust the persisted config and don't overwrite it.
+  if (count == 0)
   {
-    JsonObject newCred = array.add<JsonObject>();
-    newCred["ssid"] = ssid;
-    newCred["password"] = password;
+    LOGI("Seeding wifi config with env-var defaults.");
+    if (updateWifiConfig(kv, WIFI_SSID, WIFI_PASS)) count = 1;
   }
-  String output;
-  serializeJson(wifiDoc, output);
-  spiffsManager.writeFile("/wifi.json", output.c_str());
-  Serial.printf("Updated wifi config written: %s\n", output.c_str());
-  return wifiDoc;
+
+  kv.forEach(kWifiKeyPrefix, [](const char *key, const char *) {
+    LOGI("Loaded Network SSID: %s", key + sizeof(kWifiKeyPrefix) - 1);
+  });
+  return count;
 }
 
-JsonDocument loadWifiConfig(SPIFFSManager &spiffsManager)
+static const char *handlerName(uint8_t id)
 {
-  JsonDocument wifiDoc;
+  for (const auto &h : kHandlerNames)
+  {
+    if (h.id == id) return h.name;
+  }
+  return "?";
+}
 
-  // Only seed the SPIFFS file with env-var defaults the first time around;
-  // afterwards we trust the persisted config and don't overwrite it.
-  bool needsSeed = !spiffsManager.fileExists("/wifi.json");
-  if (!needsSeed)
+// Compile /topics.json into the topic trie. Expected shape:
+//   [{"filter": "notify/github/#", "handler": "github", "qos": 1}, ...]
+// "{client}" in a filter expands to MQTT_CLIENT_ID, e.g. "cmd/{client}".
+void loadTopicRoutes(SPIFFSManager &spiffsManager)
+{
+  topicRouter.clear();
+  if (spiffsManager.fileExists("/topics.json"))
   {
-    String existing = spiffsManager.readFile("/wifi.json");
-    if (existing.length() == 0)
+    JsonDocument doc;
+    DeserializationError err = spiffsManager.readJson("/topics.json", doc);
+    if (err || !doc.is<JsonArray>())
     {
-      needsSeed = true;
+      LOGW("Error parsing topics.json; using MQTT_TOPIC only.");
     }
     else
     {
-      DeserializationError err = deserializeJson(wifiDoc, existing);
-      if (err || !wifiDoc.is<JsonArray>() || wifiDoc.as<JsonArray>().size() == 0)
+      for (JsonObject entry : doc.as<JsonArray>())
       {
-        needsSeed = true;
-        wifiDoc.clear();
+        const char *filter = entry["filter"];
+        const char *name = entry["handler"] | "auto";
+        uint8_t qos = entry["qos"] | MQTT_QOS;
+        if (!filter) continue;
+
+        int handler = -1;
+        for (const auto &h : kHandlerNames)
+        {
+          if (strcmp(h.name, name) == 0) handler = h.id;
+        }
+        String expanded = filter;
+        expanded.replace("{client}", MQTT_CLIENT_ID);
+        if (handler < 0 || !topicRouter.add(expanded.c_str(), handler, qos))
+        {
+          LOGW("Skipping route %s -> %s (invalid filter or handler)", expanded.c_str(), name);
+        }
       }
     }
   }
 
-  if (needsSeed)
+  if (topicRouter.size() == 0)
   {
-    Serial.println("Seeding /wifi.json with env-var defaults.");
-    wifiDoc = updateWifiConfig(spiffsManager, WIFI_SSID, WIFI_PASS);
+    topicRouter.add(MQTT_TOPIC, kHandlerAuto, 1);
   }
-
-  for (JsonObject network : wifiDoc.as<JsonArray>())
+  userRouteCount = topicRouter.size();
+  topicRouter.add((pubTopicBase + "/pong").c_str(), kHandlerPong, 0);
+  for (size_t i = 0; i < topicRouter.size(); i++)
   {
-    Serial.printf("Loaded Network SSID: %s\n", network["ssid"].as<const char *>());
+    const TopicRouter::Route &r = topicRouter.route(i);
+    LOGI("Route %s -> %s (QoS %u)", r.filter.c_str(), handlerName(r.handler), r.qos);
   }
-  canvas.printf("Loaded %d wifi networks\n", (int)wifiDoc.as<JsonArray>().size());
-  canvas.pushSprite(0, kStatusBarHeight + 1);
-  return wifiDoc;
 }
 
-// Render the entire status bar into the off-screen sprite, then push it as
-// a single transfer. This eliminates the clear-then-redraw flicker the
-// previous implementation produced when drawing directly on M5.Display.
-void drawStatusBar()
+// Built-in theme, the sequences the buzzer has always played.
+static const AudioEngine::Note kSuccessNotes[] = {{8000, 100}, {10000, 100}, {12000, 200}};
+static const AudioEngine::Note kFailureNotes[] = {{8000, 400}, {6000, 600}};
+static const AudioEngine::Note kNotifyNotes[] = {{5000, 150}, {5000, 150}};
+static const struct
 {
-  statusBar.fillSprite(kStatusBarBG);
-
-  // ---- Battery icon (right side) ----
-  const int batIconW = 24, batIconH = 14;
-  const int batX = M5.Display.width() - batIconW - 4;
-  const int batY = (kStatusBarHeight - batIconH) / 2;
-  const int bodyW = batIconW - 4, bodyH = batIconH;
-  uint16_t batColor;
-  if (lastStatus.batLevel <= 15)      batColor = RED;
-  else if (lastStatus.batLevel <= 30) batColor = YELLOW;
-  else                                batColor = GREEN;
-  statusBar.drawRect(batX, batY, bodyW, bodyH, DARKGREY);
-  statusBar.fillRect(batX + bodyW, batY + (bodyH / 2) - 2, 3, 4, DARKGREY);
-  int fillWidth = ((bodyW - 2) * lastStatus.batLevel) / 100;
-  if (fillWidth < 0) fillWidth = 0;
-  statusBar.fillRect(batX + 1, batY + 1, fillWidth, bodyH - 2, batColor);
-  if (lastStatus.charging)
-  {
-    int cx = batX + bodyW / 2, cy = batY + bodyH / 2;
-    statusBar.drawLine(cx - 4, batY + 2, cx, cy, DARKGREEN);
-    statusBar.drawLine(cx, cy, cx - 2, batY + bodyH - 2, DARKGREEN);
-    statusBar.drawLine(cx - 3, batY + 2, cx, cy, DARKGREEN);
-    statusBar.drawLine(cx + 1, cy, cx - 2, batY + bodyH - 2, DARKGREEN);
-  }
-
-  // ---- WiFi bars (left of battery) ----
-  const int wifiW = 20;
-  const int wifiX = batX - wifiW - 6;
-  const int wifiY = 0;
-  if (lastStatus.wifiConnected)
-  {
-    for (int i = 0; i < 4; i++)
-    {
-      int barW = 2, spacing = 2;
-      int x = wifiX + spacing + i * (barW + spacing);
-      int baseY = wifiY + kStatusBarHeight - spacing - 4;
-      int barH = 2 * (i + 1);
-      if (i < lastStatus.wifiBars)
-        statusBar.fillRect(x, baseY - barH, barW, barH, GREEN);
-      else
-        statusBar.drawRect(x, baseY - barH, barW, barH, DARKGREY);
+  const char *event;
+  uint8_t priority;
+  const AudioEngine::Note *notes;
+  uint8_t count;
+} kDefaultSounds[] = {
+    {"success", 1, kSuccessNotes, 3},
+    {"failure", 3, kFailureNotes, 2},
+    {"notify", 1, kNotifyNotes, 2},
+};
+
+// /sounds.json: {"<event>": {"priority": 1, "wave": "square", "volume": 255,
+// "notes": [[hz, ms], ...]}, ...}. hz 0 is a rest. Without the file, or if it
+// defines nothing usable, the built-in theme is used.
+void loadSoundTheme(SPIFFSManager &spiffsManager)
+{
+  audio.clearTheme();
+  if (spiffsManager.fileExists("/sounds.json"))
+  {
+    JsonDocument doc;
+    DeserializationError err = spiffsManager.readJson("/sounds.json", doc);
+    if (err || !doc.is<JsonObject>()) LOGW("Error parsing sounds.json; using the built-in sounds.");
+    for (JsonPair event : doc.as<JsonObject>())
+    {
+      AudioEngine::Note notes[AudioEngine::kMaxNotes];
+      uint8_t count = 0;
+      for (JsonArray n : event.value()["notes"].as<JsonArray>())
+      {
+        if (count == AudioEngine::kMaxNotes) break;
+        notes[count++] = {n[0] | (uint16_t)0, n[1] | (uint16_t)0};
+      }
+      AudioEngine::Wave wave = AudioEngine::kSquare;
+      const char *waveName = event.value()["wave"] | "square";
+      if (!AudioEngine::waveFromName(waveName, wave)) LOGW("Sound %s: unknown wave %s", event.key().c_str(), waveName);
+      if (!audio.addEvent(event.key().c_str(), event.value()["priority"] | 1, wave, event.value()["volume"] | 255,
+                          notes, count))
+      {
+        LOGW("Skipping sound %s (bad notes, or theme full)", event.key().c_str());
+      }
     }
   }
-  else
+  if (!audio.events())
   {
-    int pad = 4;
-    int sx = wifiX + pad, sy = wifiY + pad;
-    int ex = wifiX + wifiW - pad, ey = wifiY + kStatusBarHeight - pad;
-    statusBar.drawLine(sx, sy, ex, ey, RED);
-    statusBar.drawLine(ex, sy, sx, ey, RED);
+    for (const auto &d : kDefaultSounds)
+      audio.addEvent(d.event, d.priority, AudioEngine::kSquare, 255, d.notes, d.count);
   }
+  LOGI("%u sounds, %u B of wavetables", (unsigned)audio.events(), (unsigned)audio.poolUsed());
+}
 
-  // ---- MQTT indicator dot (left of WiFi) ----
-  const int dotSize = 8;
-  int dotX = wifiX - dotSize - 6;
-  int dotY = (kStatusBarHeight - dotSize) / 2;
-  uint16_t dotColor = lastStatus.mqttConnected ? CYAN : DARKGREY;
-  statusBar.fillCircle(dotX + dotSize / 2, dotY + dotSize / 2, dotSize / 2, dotColor);
+// TilePresenter callback: copy one canvas rectangle to a display, below its
+// status bar. The clip keeps pushSprite() to just those pixels.
+void pushCanvasRect(void *ctx, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+  M5GFX *panel = (M5GFX *)ctx;
+  const uint32_t start = micros();
+  panel->setClipRect(x, kStatusBarHeight + 1 + y, w, h);
+  canvas.pushSprite(panel, 0, kStatusBarHeight + 1);
+  panel->clearClipRect();
+  if (panel == mirrorPanel) loopProfiler.charge(kSectionDisplay, micros() - start);
+}
+
+// Come back when the mirror is due for the changes it hasn't been sent.
+static void scheduleMirror()
+{
+  const uint32_t wait = presenter.msUntilNext(millis());
+  if (wait != TilePresenter::kIdle) timers.start(mirrorTimer, wait, millis());
+}
 
-  // ---- Left-side label: SSID prefix when connected, else "offline" ----
-  // Drawn inside the throttled refresh, so it only repaints when state
-  // actually changes. No new ongoing battery cost.
-  statusBar.setFont(&fonts::Font0); // small built-in 6x8
-  statusBar.setTextDatum(middle_left);
-  if (lastStatus.wifiConnected)
+// Push the changed parts of the message canvas to the panels, below the
+// status bar.
+void presentCanvas()
+{
+#if SCREEN_SNAPSHOT
+  canvasVersion++;
+  timers.start(snapshotTimer, kSnapshotQuietMs, millis());
+#endif
+  if (panelDark || splashUp)
   {
-    statusBar.setTextColor(WHITE, kStatusBarBG);
-    String ssid = WiFi.SSID();
-    if (ssid.length() > 9) ssid = ssid.substring(0, 9);
-    statusBar.drawString(ssid.c_str(), 4, kStatusBarHeight / 2);
+    canvasDirty = true;
+    presentStats.deferred++;
+    return;
   }
-  else
+  canvasDirty = false;
+  presentStats.pushes++;
+  boostCpu(CpuGovernor::kRender);
+  const uint64_t pixels = presenter.stats(0).pixels;
+  uint32_t start = micros();
+  presenter.present((const uint8_t *)canvas.getBuffer(), millis());
+  uint32_t elapsed = micros() - start;
+  pushUs += elapsed;
+  stageProfiler.record(kStagePush, elapsed);
+  presentStats.canvasBytes += (uint32_t)(presenter.stats(0).pixels - pixels) * StatusCells::kPanelBytesPerPixel;
+  if (mirrorPanel) scheduleMirror();
+}
+
+#if SCREEN_SNAPSHOT
+static bool writeSnapshotChunk(void *ctx, const uint8_t *data, size_t len)
+{
+  return ((File *)ctx)->write(data, len) == len;
+}
+
+static size_t readSnapshotChunk(void *ctx, uint8_t *data, size_t len)
+{
+  return ((File *)ctx)->read(data, len);
+}
+
+// Write the live canvas to kSnapshotPath if it changed since the last write.
+// Goes through a temp file, so a reset mid-write keeps the old snapshot.
+static void saveSnapshot()
+{
+  const uint8_t *pixels = (const uint8_t *)canvas.getBuffer();
+  if (!pixels || canvasVersion == snapshotVersion || canvas.scrolledBack()) return;
+  const int64_t start = esp_timer_get_time();
+  FrameSnapshot::Header h = {};
+  h.width = canvas.width();
+  h.height = canvas.height();
+  h.rawBytes = (uint32_t)h.width * h.height;
+  h.encodedBytes = FrameSnapshot::encode(pixels, h.rawBytes, nullptr, nullptr); // sizing pass, no I/O
+  h.encodeUs = (uint32_t)(esp_timer_get_time() - start);
+  h.lastWriteUs = snapshotStats.writeUs;
+  uint8_t header[FrameSnapshot::kHeaderBytes];
+  FrameSnapshot::packHeader(h, header);
+
+  fs::FS &fs = spiffsManager.fs();
+  File file = fs.open(kSnapshotTmpPath, FILE_WRITE);
+  bool ok = file && file.write(header, sizeof(header)) == sizeof(header) &&
+            FrameSnapshot::encode(pixels, h.rawBytes, writeSnapshotChunk, &file) == h.encodedBytes;
+  if (file) file.close();
+  if (!ok || !fs.rename(kSnapshotTmpPath, kSnapshotPath))
+  {
+    LOGW("Screen snapshot write failed");
+    fs.remove(kSnapshotTmpPath);
+    return;
+  }
+  snapshotVersion = canvasVersion;
+  snapshotStats.bytes = sizeof(header) + h.encodedBytes;
+  snapshotStats.encodeUs = h.encodeUs;
+  snapshotStats.writeUs = (uint32_t)(esp_timer_get_time() - start);
+  snapshotStats.writes++;
+  LOGD("Screen snapshot: %u B in %u us", (unsigned)snapshotStats.bytes, (unsigned)snapshotStats.writeUs);
+}
+
+// Decode the last snapshot straight into the canvas buffer and push it.
+// False if there is none, or it is damaged or from a different canvas size.
+bool restoreSnapshot()
+{
+  if (!spiffsManager.fileExists(kSnapshotPath)) return false;
+  const int64_t start = esp_timer_get_time();
+  uint8_t *pixels = (uint8_t *)canvas.getBuffer();
+  File file = spiffsManager.fs().open(kSnapshotPath, FILE_READ);
+  uint8_t header[FrameSnapshot::kHeaderBytes];
+  FrameSnapshot::Header h = {};
+  bool ok = pixels && file && file.read(header, sizeof(header)) == sizeof(header) &&
+            FrameSnapshot::unpackHeader(header, h) && h.width == canvas.width() && h.height == canvas.height() &&
+            FrameSnapshot::decode(readSnapshotChunk, &file, h.encodedBytes, pixels, h.rawBytes);
+  if (file) file.close();
+  if (!ok)
+  {
+    LOGW("Screen snapshot unusable, ignored");
+    canvas.fillSprite(BLACK);
+    return false;
+  }
+  // New output scrolls in below the restored lines.
+  canvas.setCursor(0, canvas.height());
+  presentCanvas();
+  snapshotVersion = canvasVersion;
+  snapshotStats.bytes = sizeof(header) + h.encodedBytes;
+  snapshotStats.encodeUs = h.encodeUs;
+  snapshotStats.writeUs = h.lastWriteUs;
+  snapshotStats.restoreUs = (uint32_t)(esp_timer_get_time() - start);
+  return true;
+}
+#endif
+
+// Status-bar icons. Every discrete state of a cell (Wi-Fi 0..4 bars or
+// offline, battery in 10 % buckets with or without the charging bolt, MQTT
+// on/off, stall marker on/off) is rendered once, on first use, into a
+// cell-sized sprite and kept. Only the label is drawn per change.
+static M5Canvas wifiIcons[StatusCells::kWifiStates];
+static M5Canvas batteryIcons[StatusCells::kBatteryBuckets][2];
+static M5Canvas mqttIcons[2];
+static M5Canvas stallIcons[2];
+static M5Canvas labelCell;
+
+// Create the icon sprite for a cell if needed; true if it must be drawn.
+static bool newIcon(M5Canvas &icon, uint8_t cell)
+{
+  if (icon.getBuffer()) return false;
+  const StatusCells::Rect &r = statusCells.rect(cell);
+  icon.setColorDepth(8);
+  if (!icon.createSprite(r.w, r.h)) return false;
+  icon.fillSprite(kStatusBarBG);
+  return true;
+}
+
+static M5Canvas &wifiIcon(uint8_t state)
+{
+  M5Canvas &icon = wifiIcons[state];
+  if (!newIcon(icon, StatusCells::kWifi)) return icon;
+  const int h = icon.height();
+  if (state == StatusCells::kWifiOffline)
   {
-    statusBar.setTextColor(DARKGREY, kStatusBarBG);
-    statusBar.drawString("offline", 4, kStatusBarHeight / 2);
+    const int pad = 4;
+    const int ex = icon.width() - pad, ey = h - pad;
+    icon.drawLine(pad, pad, ex, ey, RED);
+    icon.drawLine(ex, pad, pad, ey, RED);
+    return icon;
   }
-  statusBar.setTextDatum(top_left);
+  for (int i = 0; i < 4; i++)
+  {
+    const int barW = 2, spacing = 2;
+    const int x = spacing + i * (barW + spacing);
+    const int baseY = h - spacing - 4;
+    const int barH = 2 * (i + 1);
+    if (i < state) icon.fillRect(x, baseY - barH, barW, barH, GREEN);
+    else           icon.drawRect(x, baseY - barH, barW, barH, DARKGREY);
+  }
+  return icon;
+}
+
+static M5Canvas &batteryIcon(uint8_t bucket, bool charging)
+{
+  M5Canvas &icon = batteryIcons[bucket][charging];
+  if (!newIcon(icon, StatusCells::kBattery)) return icon;
+  const int level = bucket * 10;
+  const int bodyW = icon.width() - 3, bodyH = icon.height();
+  uint16_t color;
+  if (level <= 15)      color = RED;
+  else if (level <= 30) color = YELLOW;
+  else                  color = GREEN;
+  icon.drawRect(0, 0, bodyW, bodyH, DARKGREY);
+  icon.fillRect(bodyW, bodyH / 2 - 2, 3, 4, DARKGREY);
+  icon.fillRect(1, 1, ((bodyW - 2) * level) / 100, bodyH - 2, color);
+  if (charging)
+  {
+    const int cx = bodyW / 2, cy = bodyH / 2;
+    icon.drawLine(cx - 4, 2, cx, cy, DARKGREEN);
+    icon.drawLine(cx, cy, cx - 2, bodyH - 2, DARKGREEN);
+    icon.drawLine(cx - 3, 2, cx, cy, DARKGREEN);
+    icon.drawLine(cx + 1, cy, cx - 2, bodyH - 2, DARKGREEN);
+  }
+  return icon;
+}
 
-  statusBar.pushSprite(0, 0);
+static M5Canvas &mqttIcon(bool connected)
+{
+  M5Canvas &icon = mqttIcons[connected];
+  if (!newIcon(icon, StatusCells::kMqtt)) return icon;
+  const int r = icon.width() / 2;
+  icon.fillCircle(r, r, r, connected ? CYAN : DARKGREY);
+  return icon;
+}
+
+static M5Canvas &stallIcon(bool stalled)
+{
+  M5Canvas &icon = stallIcons[stalled];
+  if (!newIcon(icon, StatusCells::kStall) || !stalled) return icon;
+  icon.setFont(&fonts::Font0);
+  icon.setTextColor(ORANGE, kStatusBarBG);
+  icon.drawString("!", 0, 0);
+  return icon;
+}
+
+// SSID prefix when connected, else "offline".
+static M5Canvas &labelIcon(const char *text, bool connected)
+{
+  newIcon(labelCell, StatusCells::kLabel);
+  labelCell.fillSprite(kStatusBarBG);
+  labelCell.setFont(&fonts::Font0); // small built-in 6x8
+  labelCell.setTextColor(connected ? WHITE : DARKGREY, kStatusBarBG);
+  labelCell.drawString(text, 0, 0);
+  return labelCell;
+}
+
+// Push only the cells whose state changed since the last push; with the
+// panel dark, nothing is pushed and the diff carries over to the wake flush.
+void drawStatusBar()
+{
+  if (panelDark)
+  {
+    statusBarDirty = true; // lastStatus is the model; drawn on wake
+    presentStats.deferred++;
+    return;
+  }
+  statusBarDirty = false;
+
+  char label[StatusCells::kLabelChars + 1];
+  if (lastStatus.wifiConnected) strlcpy(label, WiFi.SSID().c_str(), sizeof(label));
+  else                          strlcpy(label, "offline", sizeof(label));
+  const uint8_t wifi = StatusCells::wifiState(lastStatus.wifiConnected, lastStatus.wifiBars);
+  const uint8_t battery = StatusCells::batteryBucket(lastStatus.batLevel);
+
+  uint32_t keys[StatusCells::kCount];
+  keys[StatusCells::kLabel] = StatusCells::labelKey(label, lastStatus.wifiConnected);
+  keys[StatusCells::kStall] = lastStatus.loopStall;
+  keys[StatusCells::kMqtt] = lastStatus.mqttConnected;
+  keys[StatusCells::kWifi] = wifi;
+  keys[StatusCells::kBattery] = battery * 2 + lastStatus.charging;
+  const uint8_t changed = statusCells.update(keys);
+  if (!changed) return;
+
+  presentStats.pushes++;
+  presentStats.barBytes += statusCells.bytes(changed);
+  presentStats.barFullBytes += statusCells.fullBytes();
+  boostCpu(CpuGovernor::kRender);
+  for (uint8_t cell = 0; cell < StatusCells::kCount; cell++)
+  {
+    if (!(changed & (1 << cell))) continue;
+    M5Canvas *icon = nullptr;
+    switch (cell)
+    {
+    case StatusCells::kLabel:   icon = &labelIcon(label, lastStatus.wifiConnected); break;
+    case StatusCells::kStall:   icon = &stallIcon(lastStatus.loopStall); break;
+    case StatusCells::kMqtt:    icon = &mqttIcon(lastStatus.mqttConnected); break;
+    case StatusCells::kWifi:    icon = &wifiIcon(wifi); break;
+    case StatusCells::kBattery: icon = &batteryIcon(battery, lastStatus.charging); break;
+    }
+    if (icon && icon->getBuffer())
+    {
+      const StatusCells::Rect &r = statusCells.rect(cell);
+      icon->pushSprite(&M5.Display, r.x, r.y);
+      if (mirrorPanel)
+      {
+        const uint32_t start = micros();
+        icon->pushSprite(mirrorPanel, r.x, r.y);
+        loopProfiler.charge(kSectionDisplay, micros() - start);
+      }
+    }
+  }
 }
 
 // Sample current state and only redraw if anything actually changed.
@@ -441,16 +1406,18 @@ void refreshStatusBar(bool force)
 {
   StatusBarState s;
   s.wifiConnected = (WiFi.status() == WL_CONNECTED);
-  int rssi = s.wifiConnected ? WiFi.RSSI() : -200;
+  int rssi = s.wifiConnected ? sensors.value(kSensorRssi) : -200;
   s.wifiBars = (rssi >= -50) ? 4
              : (rssi >= -60) ? 3
              : (rssi >= -70) ? 2
              : (rssi >= -85) ? 1
                              : 0;
-  s.mqttConnected = mqttClient.connected();
-  s.batLevel = (int)M5.Power.getBatteryLevel();
+  s.mqttConnected = mqttUp();
+  s.batLevel = sensors.value(kSensorBattery);
   s.charging = isCharging;
+  s.loopStall = loopStallAlert();
 
+  if (force) statusCells.invalidate(); // repaint every cell
   if (force || memcmp(&s, &lastStatus, sizeof(s)) != 0)
   {
     lastStatus = s;
@@ -464,66 +1431,87 @@ void displayMQTTStatus()    { refreshStatusBar(true); }
 void displayWifiStatus()    { refreshStatusBar(true); }
 void displayBatteryStatus() { refreshStatusBar(true); }
 
+// Notices association changes; the link task does the (re)connecting.
 bool wifiConnect()
 {
   static bool wasConnected = false;
-  static unsigned long lastReconnectAttempt = 0;
-  const unsigned long reconnectIntervalMs = 5000;
 
   if (WiFi.status() == WL_CONNECTED)
   {
     if (!wasConnected) {
-      mqttLastReconnectAttempt = 0;
+      timers.start(mqttConnectTimer, 0, millis()); // connect MQTT right away
+      powerManager.onWifiConnected();
+      radioEnergy.set(1, esp_timer_get_time());
+      LOGI("WiFi connected, IP address: %s", WiFi.localIP().toString().c_str());
       canvas.setTextColor(GREEN);
       canvas.printf("WiFi connected: %s\n", WiFi.SSID().c_str());
       canvas.setTextColor(WHITE);
-      canvas.pushSprite(0, kStatusBarHeight + 1);
+      presentCanvas();
       wasConnected = true;
     }
   }
   else
   {
+    if (wasConnected) radioEnergy.set(0, esp_timer_get_time());
     wasConnected = false;
-    unsigned long now = millis();
-    // Throttle reconnect attempts so we don't block the main loop on every
-    // pass. wifiMulti.run() with a small timeout will fall through quickly
-    // when no network is in range.
-    if (now - lastReconnectAttempt >= reconnectIntervalMs)
-    {
-      lastReconnectAttempt = now;
-      wifiMulti.run(1000);
-    }
-  }
-
-  // Poll the status bar at 2 Hz, but refreshStatusBar() only pushes pixels
-  // when an icon's underlying value has changed — so the LCD bus stays
-  // idle when the bar is stable. Net battery cost is lower than the old
-  // 30-second blind clear-and-redraw.
-  static unsigned long lastStatusPoll = 0;
-  unsigned long currentMillis = millis();
-  if (currentMillis - lastStatusPoll >= 2000)
-  {
-    refreshStatusBar();
-    lastStatusPoll = currentMillis;
   }
   return WiFi.status() == WL_CONNECTED;
 }
 
-void scanWifiNetworks() {
-  // free memory used by scan
-  WiFi.scanDelete();
+// Link task body. Associates whenever Wi-Fi is down (retrying every
+// kWifiRetryMs; a disconnect event wakes it early) and runs MQTT connects
+// the loop hands over through mqttBusy.
+static void linkTask(void *)
+{
   WiFi.mode(WIFI_STA);
-  WiFi.disconnect();      // ensure we’re not already connected
+  for (;;)
+  {
+    if (WiFi.status() != WL_CONNECTED)
+    {
+      if (wifiMulti.run(kWifiConnectTimeoutMs) == WL_CONNECTED)
+      {
+        if (!wifiUpUs) wifiUpUs = esp_timer_get_time();
+        linkEvents.fetch_or(kLinkWifiUp, std::memory_order_release);
+        pokeLoop();
+      }
+    }
+    if (mqttBusy.load(std::memory_order_acquire))
+    {
+      const bool ok = WiFi.status() == WL_CONNECTED && mqttReconnect();
+      linkEvents.fetch_or(ok ? kLinkMqttUp : kLinkMqttFailed, std::memory_order_release);
+      mqttBusy.store(false, std::memory_order_release);
+      pokeLoop();
+    }
+    ulTaskNotifyTake(pdTRUE, WiFi.status() == WL_CONNECTED ? portMAX_DELAY : pdMS_TO_TICKS(kWifiRetryMs));
+  }
+}
+
+void startLinkTask()
+{
+  // 8 KB like the loop task: the TLS handshake runs on this stack.
+  xTaskCreatePinnedToCore(linkTask, "link", 8192, nullptr, 1, &linkTaskHandle, 0);
+}
+
+static void wakeLinkTask()
+{
+  if (linkTaskHandle) xTaskNotifyGive(linkTaskHandle);
+}
+
+void scanWifiNetworks() {
+  // free memory used by scan
+  WiFi.scanDelete();
+  WiFi.mode(WIFI_STA);
+  WiFi.disconnect();      // ensure we’re not already connected
   delay(100);
 
-  Serial.println("Scanning for Wi-Fi networks...");
+  LOGI("Scanning for Wi-Fi networks...");
   int n = WiFi.scanNetworks();
   if (n == 0) {
-    Serial.println("  No networks found");
+    LOGI("  No networks found");
   } else {
     for (int i = 0; i < n; i++) {
       // SSID, signal strength and open/protected
-      Serial.printf("  %2d: %s  (%d dBm)  %s\n",
+      LOGI("  %2d: %s  (%d dBm)  %s",
                     i + 1,
                     WiFi.SSID(i).c_str(),
                     WiFi.RSSI(i),
@@ -535,28 +1523,82 @@ void scanWifiNetworks() {
   }
 }
 
+// Runs on the link task, which owns mqttClient until it returns: no logging
+// or drawing here, onMqttConnectResult() reports on the loop.
 boolean mqttReconnect()
 {
   // cleanSession=false (8th arg) so the broker retains our session and queues
   // QoS>=1 messages while we're offline. Re-delivered on reconnect.
-  if (mqttClient.connect(MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD, MQTT_TOPIC, 1, false, "", false))
+  if (!mqttClient.connect(MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD, MQTT_TOPIC, 1, false, "", false))
   {
-    Serial.println("MQTT Connected");
-    // Subscribe at QoS 1 so the broker actually queues messages for this
-    // session while we're disconnected (QoS 0 is fire-and-forget).
-    mqttClient.subscribe(MQTT_TOPIC, 1);
-    canvas.setTextColor(CYAN);
-    canvas.printf("[OK] MQTT %s\n", MQTT_TOPIC);
-    canvas.setTextColor(WHITE);
-    canvas.pushSprite(0, kStatusBarHeight + 1);
+    return false;
   }
-  else
+  if (!mqttUpUs) mqttUpUs = esp_timer_get_time();
+  // Subscribe every routed filter at its configured QoS. QoS 1 makes the
+  // broker queue messages for this session while we're disconnected.
+  for (size_t i = 0; i < topicRouter.size(); i++)
   {
-    Serial.println("MQTT Connection failed");
+    const TopicRouter::Route &r = topicRouter.route(i);
+    mqttClient.subscribe(r.filter.c_str(), r.qos);
   }
+  if (!subscribedUs) subscribedUs = esp_timer_get_time();
   return mqttClient.connected();
 }
 
+static void onMqttConnectResult(bool ok)
+{
+  if (!ok)
+  {
+    LOGW("MQTT Connection failed");
+    timers.start(mqttConnectTimer, kMqttRetryMs, millis());
+    return;
+  }
+  LOGI("MQTT Connected");
+  canvas.setTextColor(CYAN);
+  if (userRouteCount == 1)
+    canvas.printf("[OK] MQTT %s\n", topicRouter.route(0).filter.c_str());
+  else
+    canvas.printf("[OK] MQTT %u topics\n", (unsigned)userRouteCount);
+  canvas.setTextColor(WHITE);
+  presentCanvas();
+  refreshStatusBar();
+  if (!bootReported)
+  {
+    bootProfiler.mark("mqtt", mqttUpUs);
+    bootProfiler.mark("subscribed", subscribedUs);
+    reportBoot();
+  }
+}
+
+// Pick up whatever the link task finished since the last call.
+static void serviceLink()
+{
+  const uint8_t events = linkEvents.exchange(0, std::memory_order_acquire);
+  if (events & kLinkWifiUp)
+  {
+    bootProfiler.mark("wifi", wifiUpUs);
+    wifiConnect();
+  }
+  if (events & (kLinkMqttUp | kLinkMqttFailed)) onMqttConnectResult(events & kLinkMqttUp);
+}
+
+// One line per boot: where the time to first subscription went.
+void reportBoot()
+{
+  bootReported = true;
+  char line[192];
+  bootProfiler.summarize(line, sizeof(line));
+  char snapshot[64] = "";
+#if SCREEN_SNAPSHOT
+  if (bootProfiler.has("restore"))
+    snprintf(snapshot, sizeof(snapshot), " (snapshot %u B in %u us, last write %u us)",
+             (unsigned)snapshotStats.bytes, (unsigned)snapshotStats.restoreUs, (unsigned)snapshotStats.writeUs);
+#endif
+  char out[AsyncLog::kMaxText];
+  snprintf(out, sizeof(out), "boot: %s%s%s", line, snapshot, bootProfiler.has("subscribed") ? "" : " (not subscribed yet)");
+  AsyncLog::instance().print(out);
+}
+
 /******************************************************************************
  *                          MQTT CALLBACK
  ******************************************************************************/
@@ -577,28 +1619,25 @@ static uint16_t colorFromName(const char *name)
   return WHITE;
 }
 
-// Queue a non-blocking notification tone for the given color.
-// M5.Speaker.tone(freq, duration, channel, stop_current) with stop_current=false
-// queues notes back-to-back without delay() calls.
-static void playColorTone(const char *color)
+// Hand audio whatever is due and come back when the next note is.
+static void scheduleAudio()
 {
-  if (!color) return;
-  if (strcmp(color, "RED") == 0)
-  {
-    M5.Speaker.tone(8000, 400, 0, true);
-    M5.Speaker.tone(6000, 600, 0, false);
-  }
-  else if (strcmp(color, "GREEN") == 0)
-  {
-    M5.Speaker.tone(8000, 100, 0, true);
-    M5.Speaker.tone(10000, 100, 0, false);
-    M5.Speaker.tone(12000, 200, 0, false);
-  }
-  else
-  {
-    M5.Speaker.tone(5000, 150, 0, true);
-    M5.Speaker.tone(5000, 150, 0, false);
-  }
+  const uint32_t wait = audio.msUntilNext(esp_timer_get_time());
+  if (wait != AudioEngine::kIdle) timers.start(audioTimer, wait, millis());
+}
+
+// Queue the theme's sound for `event`, if it has one. Never waits on audio.
+static void playEventSound(const char *event)
+{
+  if (audio.post(event, esp_timer_get_time())) scheduleAudio();
+}
+
+// Legacy pipe colors: red is a failure, green a success.
+static const char *soundForColor(const char *color)
+{
+  if (strcmp(color, "RED") == 0) return "failure";
+  if (strcmp(color, "GREEN") == 0) return "success";
+  return "notify";
 }
 
 // Handle the legacy pipe-delimited "e|gh|<color>|<line>|<order>" format.
@@ -624,7 +1663,7 @@ static void handleGithubPipeMessage(char *message)
   canvas.setTextColor(colorFromName(color));
   if (order && strcmp(order, "1") == 0)
   {
-    playColorTone(color);
+    playEventSound(soundForColor(color));
   }
   canvas.printf("%s\n", line);
   if (order && strcmp(order, "1") == 0)
@@ -632,89 +1671,91 @@ static void handleGithubPipeMessage(char *message)
     canvas.printf("---------------------------------\n");
   }
   canvas.setTextColor(WHITE);   // restore default so next line isn't tinted
-  canvas.pushSprite(0, kStatusBarHeight + 1);
+  presentCanvas();
 }
 
 void mqttCallback(char *topic, byte *payload, unsigned int length)
 {
+  const uint32_t entry = micros();
+  stageProfiler.record(kStageReceive, entry - loopStartUs);
+  StageScope total = {kStageCallback, entry};
+  ClockScope clock = {entry};
+
+  // Route on the topic first so unwanted payloads are never copied or parsed.
+  const TopicRouter::Route *route = topicRouter.match(topic);
+  endStage(kStageRoute, entry);
+  if (!route || route->handler == kHandlerIgnore)
+  {
+    routeStats.dropped++;
+    LOGI("MQTT %s: no route (%u bytes dropped unparsed)", topic, length);
+    return;
+  }
+  const uint8_t handler = route->handler;
+  routeStats.routed++;
+  HeapScope heapScope = {handler, (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT)};
+
   canvas.setFont(&fonts::Font2); // compact 6x8 built-in — fits more text per line
 
   // Cap message size to avoid stack blow-up; oversize messages are dropped.
   static constexpr size_t kMaxMessage = 4096;
+
+  // Payloads above the PubSubClient buffer reach us truncated; the full
+  // message has already been scanned by streamIngest as it arrived.
+  if (streamIngest.truncated(length))
+  {
+    // Images are drawn from the payload itself, so they have to fit.
+    if (IconImage::isImage(payload, length))
+    {
+      imageStats.failures++;
+      LOGW("image: %u-byte message doesn't fit the %u-byte buffer, dropped",
+           (unsigned)streamScanner.received(), (unsigned)kMaxMessage);
+      return;
+    }
+    if (handleStreamedMessage(handler)) onNotificationShown(handler);
+    return;
+  }
+
   if (length >= kMaxMessage)
   {
-    Serial.printf("MQTT message too large (%u bytes); dropping.\n", length);
+    LOGW("MQTT message too large (%u bytes); dropping.", length);
+    return;
+  }
+
+  // gzip payloads skip the copy/echo entirely and go straight to the parser.
+  if (StreamInflate::isGzip(payload, length))
+  {
+    if (handleCompressedMessage(payload, length, handler)) onNotificationShown(handler);
+    return;
+  }
+
+  // Image messages are binary and drawn straight from the payload.
+  if (IconImage::isImage(payload, length))
+  {
+    if (handleImageMessage(payload, length)) onNotificationShown(handler);
     return;
   }
+
+  uint32_t t = micros();
   std::vector<char> buf(length + 1);
   memcpy(buf.data(), payload, length);
   buf[length] = '\0';
   char *message = buf.data();
-  Serial.println(message);
+  endStage(kStageCopy, t);
+  LOGD("MQTT %s: %s", topic, message);
 
   // Try JSON first; fall back to legacy formats only if parse fails.
+  t = micros();
   JsonDocument doc;
   DeserializationError jsonErr = deserializeJson(doc, message, length);
+  t = endStage(kStageParse, t);
+  pushUs = 0;
   if (!jsonErr)
   {
-    // Accept both legacy (msgType/msgGroup) and new (messageType/messageGroup)
-    // key names. Group "gh" and "github" are treated as equivalent.
-    const char *msgType = doc["msgType"].is<const char *>()
-                            ? doc["msgType"].as<const char *>()
-                            : (doc["messageType"].is<const char *>() ? doc["messageType"].as<const char *>() : nullptr);
-    const char *msgGroup = doc["msgGroup"].is<const char *>()
-                             ? doc["msgGroup"].as<const char *>()
-                             : (doc["messageGroup"].is<const char *>() ? doc["messageGroup"].as<const char *>() : nullptr);
-    const bool isGithubGroup = msgGroup && (strcmp(msgGroup, "gh") == 0 || strcmp(msgGroup, "github") == 0);
-    const bool isGrafanaGroup = msgGroup && strcmp(msgGroup, "grafana") == 0;
-    if (msgType && isGithubGroup && strcmp(msgType, "event") == 0)
-    {
-      Serial.println("message supported");
-      handleGithubEventJSON(doc);
-    }
-    else if (msgType && isGrafanaGroup && strcmp(msgType, "event") == 0)
-    {
-      Serial.println("message supported");
-      handleGrafanaEventJSON(doc);
-    }
-    else if (msgType && msgGroup && strcmp(msgType, "config") == 0 && strcmp(msgGroup, "wifi") == 0)
-    {
-      Serial.println("message supported");
-      if (doc["ssid"].is<const char *>() && doc["password"].is<const char *>())
-      {
-        updateWifiConfig(spiffsManager, doc["ssid"], doc["password"]);
-        loadWifiConfig(spiffsManager);
-      }
-      else
-      {
-        Serial.println("Invalid wifi config message");
-      }
-    }
-    else
-    {
-      Serial.println("message not supported");
-      // Fallback: surface useful JSON fields so the user always sees something.
-      const char *fallback = nullptr;
-      if (doc["message"].is<const char *>())      fallback = doc["message"].as<const char *>();
-      else if (doc["text"].is<const char *>())    fallback = doc["text"].as<const char *>();
-      else if (doc["title"].is<const char *>())   fallback = doc["title"].as<const char *>();
-      else if (doc["body"].is<const char *>())    fallback = doc["body"].as<const char *>();
-
-      canvas.setTextColor(WHITE);
-      if (fallback)
-      {
-        canvas.printf("%s\n", fallback);
-      }
-      else
-      {
-        // Pretty-print compact JSON so the user can debug payload shape.
-        String out;
-        serializeJson(doc, out);
-        if (out.length() > 200) { out.remove(200); out += "..."; }
-        canvas.printf("%s\n", out.c_str());
-      }
-      canvas.pushSprite(0, kStatusBarHeight + 1);
-    }
+    dispatchRoutedJson(handler, doc);
+  }
+  else if (handler == kHandlerCommand)
+  {
+    handleCommand(message);
   }
   else if (strchr(message, '|') != nullptr)
   {
@@ -722,19 +1763,388 @@ void mqttCallback(char *topic, byte *payload, unsigned int length)
   }
   else if (strcmp(message, "clear") == 0)
   {
-    canvas.clear();
-    canvas.pushSprite(0, kStatusBarHeight + 1);
+    handleCommand(message);
   }
   else
   {
     // Plain-text message that isn't JSON, pipe, or "clear" — show it raw.
     canvas.setTextColor(WHITE);
     canvas.printf("%s\n", message);
-    canvas.pushSprite(0, kStatusBarHeight + 1);
+    presentCanvas();
   }
+  endRender(t);
 
-  M5.Display.setBrightness(fullBrightness);
-  lastBrightnessChange = millis(); // reset timeout timer
+  onNotificationShown(handler);
+}
+
+// Wake the screen and queue a "displayed" receipt. Commands and config
+// messages don't produce receipts.
+void onNotificationShown(uint8_t handler)
+{
+  if (handler == kHandlerPong)
+  {
+    currentMessageId[0] = '\0';
+    return; // control traffic; nothing was drawn
+  }
+
+  // Lights the screen, flushing the canvas first if it was drawn while dark.
+  wakeScreen();
+
+  if (socketWakeUs)
+  {
+    powerManager.recordWakeLatency((uint32_t)(esp_timer_get_time() - socketWakeUs));
+    socketWakeUs = 0;
+  }
+
+  // Pixels are on the panel now; close out the producer's timestamp.
+  if (currentMessageTs && clockSync.valid())
+  {
+    int64_t latency = clockSync.toHost(millis()) - currentMessageTs;
+    if (latency >= 0) e2eLatency.add((uint32_t)latency);
+  }
+  currentMessageTs = 0;
+  linkHot = true;
+
+  if (handler == kHandlerCommand || handler == kHandlerWifiConfig)
+  {
+    currentMessageId[0] = '\0';
+    return;
+  }
+  char id[sizeof(currentMessageId)];
+  if (currentMessageId[0]) strlcpy(id, currentMessageId, sizeof(id));
+  else                     snprintf(id, sizeof(id), "m%u", (unsigned)++localMessageSeq);
+  currentMessageId[0] = '\0';
+
+  recordReceipt(id, kReceiptDisplayed);
+  if (unackedCount < kMaxReceipts)
+  {
+    strlcpy(unackedIds[unackedCount++], id, sizeof(unackedIds[0]));
+  }
+}
+
+// Hand a parsed payload to the handler its topic was routed to. Shared by
+// the plain, compressed and streamed ingest paths.
+void dispatchRoutedJson(uint8_t handler, JsonDocument &doc)
+{
+  if (doc["id"].is<const char *>())
+    strlcpy(currentMessageId, doc["id"], sizeof(currentMessageId));
+  else if (doc["id"].is<long long>())
+    snprintf(currentMessageId, sizeof(currentMessageId), "%lld", doc["id"].as<long long>());
+  currentMessageTs = doc["ts"].is<long long>() ? doc["ts"].as<long long>() : 0;
+
+  switch (handler)
+  {
+  case kHandlerGithub:
+    handleGithubEventJSON(doc);
+    break;
+  case kHandlerGrafana:
+    handleGrafanaEventJSON(doc);
+    break;
+  case kHandlerWifiConfig:
+    applyWifiConfigMessage(doc);
+    break;
+  case kHandlerCommand:
+    if (doc["cmd"].is<const char *>()) handleCommand(doc["cmd"]);
+    break;
+  case kHandlerPong:
+    handlePong(doc);
+    break;
+  default:
+    dispatchJsonMessage(doc);
+    break;
+  }
+}
+
+// Plain-text device commands, received on a "command" route (and "clear"
+// on the auto route for backwards compatibility) or typed on the serial
+// console. Anything that can take the device out of service for a while is
+// console-only.
+void handleCommand(const char *command, bool fromConsole)
+{
+  if (strcmp(command, "clear") == 0)
+  {
+    canvas.clear();
+    canvas.clearHistory();
+    presentCanvas();
+  }
+  else if (strcmp(command, "stats") == 0)
+  {
+    dumpStageStats();
+  }
+  else if (strcmp(command, "loop") == 0)
+  {
+    dumpLoopStats();
+  }
+  else if (strcmp(command, "heap") == 0)
+  {
+    dumpHeapStats();
+  }
+  else if (strcmp(command, "power") == 0)
+  {
+    dumpPowerStats();
+  }
+  else if (strcmp(command, "cpu") == 0)
+  {
+    dumpCpuStats();
+  }
+  else if (strcmp(command, "energy") == 0)
+  {
+    dumpEnergyStats();
+  }
+  else if (strcmp(command, "fsbench") == 0)
+  {
+    if (fromConsole) runFsBench();
+    else LOGW("fsbench is only accepted on the serial console");
+  }
+  else
+  {
+    LOGW("Unknown command: %s", command);
+  }
+}
+
+void applyWifiConfigMessage(const JsonDocument &doc)
+{
+  if (doc["ssid"].is<const char *>() && doc["password"].is<const char *>())
+  {
+    updateWifiConfig(kvStore, doc["ssid"], doc["password"]);
+    canvas.printf("Loaded %d wifi networks\n", (int)loadWifiConfig(kvStore));
+    presentCanvas();
+  }
+  else
+  {
+    LOGW("Invalid wifi config message");
+  }
+}
+
+// Sniff msgType/msgGroup to pick a handler; used on "auto" routes.
+void dispatchJsonMessage(JsonDocument &doc)
+{
+  // Accept both legacy (msgType/msgGroup) and new (messageType/messageGroup)
+  // key names. Group "gh" and "github" are treated as equivalent.
+  const char *msgType = doc["msgType"].is<const char *>()
+                          ? doc["msgType"].as<const char *>()
+                          : (doc["messageType"].is<const char *>() ? doc["messageType"].as<const char *>() : nullptr);
+  const char *msgGroup = doc["msgGroup"].is<const char *>()
+                           ? doc["msgGroup"].as<const char *>()
+                           : (doc["messageGroup"].is<const char *>() ? doc["messageGroup"].as<const char *>() : nullptr);
+  const bool isGithubGroup = msgGroup && (strcmp(msgGroup, "gh") == 0 || strcmp(msgGroup, "github") == 0);
+  const bool isGrafanaGroup = msgGroup && strcmp(msgGroup, "grafana") == 0;
+  if (msgType && isGithubGroup && strcmp(msgType, "event") == 0)
+  {
+    LOGD("message supported");
+    handleGithubEventJSON(doc);
+  }
+  else if (msgType && isGrafanaGroup && strcmp(msgType, "event") == 0)
+  {
+    LOGD("message supported");
+    handleGrafanaEventJSON(doc);
+  }
+  else if (msgType && msgGroup && strcmp(msgType, "config") == 0 && strcmp(msgGroup, "wifi") == 0)
+  {
+    LOGD("message supported");
+    applyWifiConfigMessage(doc);
+  }
+  else
+  {
+    LOGD("message not supported");
+    // Fallback: surface useful JSON fields so the user always sees something.
+    const char *fallback = nullptr;
+    if (doc["message"].is<const char *>())      fallback = doc["message"].as<const char *>();
+    else if (doc["text"].is<const char *>())    fallback = doc["text"].as<const char *>();
+    else if (doc["title"].is<const char *>())   fallback = doc["title"].as<const char *>();
+    else if (doc["body"].is<const char *>())    fallback = doc["body"].as<const char *>();
+
+    canvas.setTextColor(WHITE);
+    if (fallback)
+    {
+      canvas.printf("%s\n", fallback);
+    }
+    else
+    {
+      // Pretty-print compact JSON so the user can debug payload shape.
+      String out;
+      serializeJson(doc, out);
+      if (out.length() > 200) { out.remove(200); out += "..."; }
+      canvas.printf("%s\n", out.c_str());
+    }
+    presentCanvas();
+  }
+}
+
+// Inflate a gzip payload directly into deserializeJson() and dispatch it.
+// Compression ratio and decode time are logged per message and accumulated
+// in inflateStats.
+bool handleCompressedMessage(const byte *payload, unsigned int length, uint8_t handler)
+{
+  uint32_t start = micros();
+  JsonDocument doc;
+  DeserializationError jsonErr = DeserializationError::InvalidInput;
+  if (inflater.begin(payload, length))
+  {
+    jsonErr = deserializeJson(doc, inflater);
+    // Drain anything after the JSON value so the trailer CRC is checked.
+    while (inflater.read() >= 0) {}
+  }
+  uint32_t elapsed = micros() - start;
+  stageProfiler.record(kStageParse, elapsed);
+
+  if (inflater.status() != StreamInflate::kDone || jsonErr)
+  {
+    inflateStats.failures++;
+    LOGW("inflate: failed (%s, json %s) after %u -> %u bytes",
+                  StreamInflate::statusName(inflater.status()), jsonErr.c_str(),
+                  (unsigned)inflater.consumed(), (unsigned)inflater.produced());
+    return false;
+  }
+
+  inflateStats.messages++;
+  inflateStats.lastIn = length;
+  inflateStats.lastOut = inflater.produced();
+  inflateStats.lastUs = elapsed;
+  inflateStats.bytesIn += inflateStats.lastIn;
+  inflateStats.bytesOut += inflateStats.lastOut;
+  inflateStats.decodeUs += elapsed;
+  LOGD("inflate: %u -> %u bytes (%.1fx) in %u us; total %u msgs, %.1fx avg",
+                (unsigned)inflateStats.lastIn, (unsigned)inflateStats.lastOut,
+                (float)inflateStats.lastOut / inflateStats.lastIn, (unsigned)inflateStats.lastUs,
+                (unsigned)inflateStats.messages,
+                (float)inflateStats.bytesOut / (float)inflateStats.bytesIn);
+
+  uint32_t t = micros();
+  pushUs = 0;
+  dispatchRoutedJson(handler, doc);
+  endRender(t);
+  return true;
+}
+
+// Draw an image message on a new line, with its caption to the right,
+// scrolling the canvas up first if the image doesn't fit below the cursor.
+// A cached icon is copied in; otherwise rows go to the canvas as they are
+// decoded, and into the cache.
+bool handleImageMessage(const byte *payload, unsigned int length)
+{
+  IconImage image;
+  if (!image.begin(payload, length) || image.width() > canvas.width() || image.height() > canvas.height())
+  {
+    imageStats.failures++;
+    LOGW("image: bad header or too large (%u bytes)", length);
+    return false;
+  }
+  imageStats.messages++;
+  uint32_t t = micros();
+  pushUs = 0;
+  canvas.showLive();
+  if (canvas.getCursorX() != 0) canvas.println();
+  const uint16_t w = image.width();
+  const uint16_t h = image.height();
+  int y = canvas.getCursorY();
+  if (y + h > canvas.height())
+  {
+    canvas.scroll(0, canvas.height() - (y + h));
+    y = canvas.height() - h;
+  }
+
+  uint16_t cw, ch;
+  const uint8_t *cached = iconCache.find(image.hash(), cw, ch);
+  if (cached)
+  {
+    canvas.pushImage(0, y, cw, ch, (const lgfx::rgb332_t *)cached);
+  }
+  else
+  {
+    const uint32_t start = micros();
+    uint8_t *slot = iconCache.insert(image.hash(), w, h);
+    uint8_t row[IconImage::kMaxWidth];
+    for (uint16_t r = 0; r < h && image.nextRow(row); r++)
+    {
+      canvas.pushImage(0, y + r, w, 1, (const lgfx::rgb332_t *)row);
+      if (slot) memcpy(slot + (size_t)r * w, row, w);
+    }
+    if (!image.complete())
+    {
+      iconCache.remove(image.hash());
+      canvas.fillRect(0, y, w, h, BLACK);
+      imageStats.failures++;
+      LOGW("image: corrupt pixel data (%ux%u)", w, h);
+      return false;
+    }
+    imageStats.decoded++;
+    imageStats.decodeUs += micros() - start;
+  }
+
+  // One line beside the image. History gets a text stand-in, since paging
+  // repaints from history and the pixels aren't kept.
+  char line[TextHistory::kCols + 1];
+  snprintf(line, sizeof(line), "[image] %.*s", (int)image.captionLen(), image.caption());
+  const int fh = canvas.fontHeight();
+  canvas.setTextColor(WHITE);
+  canvas.drawString(line + 8, w + 4, y + (h > fh ? (h - fh) / 2 : 0));
+  canvas.record(line);
+  canvas.setCursor(0, y + h + 2);
+  presentCanvas();
+  endRender(t);
+  return true;
+}
+
+// Dispatch a message captured by the streaming scanner. The JsonDocument is
+// rebuilt from the captured fields only, so its size is bounded by
+// kStreamBudget rather than by the payload.
+bool handleStreamedMessage(uint8_t handler)
+{
+  uint32_t received = streamScanner.received();
+  streamStats.messages++;
+  if (received > streamStats.largest) streamStats.largest = received;
+
+  JsonStreamScanner::Result result = streamScanner.result();
+  if (result != JsonStreamScanner::kComplete)
+  {
+    if (result == JsonStreamScanner::kOverBudget) streamStats.overBudget++;
+    else                                          streamStats.malformed++;
+    LOGW("stream: rejected %u-byte payload (%s); %u over budget, %u malformed so far",
+                  (unsigned)received,
+                  result == JsonStreamScanner::kOverBudget ? "over budget" : "malformed",
+                  (unsigned)streamStats.overBudget, (unsigned)streamStats.malformed);
+    return false;
+  }
+
+  uint32_t t = micros();
+  JsonDocument doc;
+  JsonStreamScanner::Field f;
+  size_t cursor = 0;
+  while (streamScanner.next(cursor, f))
+  {
+    switch (f.type)
+    {
+    case JsonStreamScanner::kString:
+      doc[f.key] = f.value;
+      break;
+    case JsonStreamScanner::kNumber:
+      if (strpbrk(f.value, ".eE")) doc[f.key] = strtod(f.value, nullptr);
+      else                         doc[f.key] = strtoll(f.value, nullptr, 10);
+      break;
+    case JsonStreamScanner::kTrue:
+    case JsonStreamScanner::kFalse:
+      doc[f.key] = (f.type == JsonStreamScanner::kTrue);
+      break;
+    case JsonStreamScanner::kNull:
+      doc[f.key] = nullptr;
+      break;
+    case JsonStreamScanner::kArrayItem:
+    {
+      JsonArray items = doc[f.key].is<JsonArray>() ? doc[f.key].as<JsonArray>()
+                                                   : doc[f.key].to<JsonArray>();
+      items.add(f.value);
+      break;
+    }
+    }
+  }
+  LOGI("stream: %u-byte payload, %u bytes captured",
+                (unsigned)received, (unsigned)streamScanner.used());
+  t = endStage(kStageParse, t);
+  pushUs = 0;
+  dispatchRoutedJson(handler, doc);
+  endRender(t);
+  return true;
 }
 
 /******************************************************************************
@@ -823,7 +2233,7 @@ void handleGithubEventJSON(const JsonDocument &event)
   }
 
   canvas.setTextColor(WHITE);
-  canvas.pushSprite(0, kStatusBarHeight + 1);
+  presentCanvas();
 }
 
 /******************************************************************************
@@ -872,6 +2282,9 @@ void handleGrafanaEventJSON(const JsonDocument &event)
     else if (strcmp(status, "alerting") == 0) glyph = "!! ";
   }
 
+  // "firing", "resolved", ... sound only if the theme defines them.
+  if (status) playEventSound(status);
+
   if (haveBg) canvas.setTextColor(fg, bg);
   else        canvas.setTextColor(fg);
 
@@ -901,81 +2314,1082 @@ void handleGrafanaEventJSON(const JsonDocument &event)
 
   // Restore default text colors so subsequent prints aren't tinted.
   canvas.setTextColor(WHITE, BLACK);
-  canvas.pushSprite(0, kStatusBarHeight + 1);
+  presentCanvas();
 }
 
 /******************************************************************************
- *                                MAIN LOOP
+ *                     OUTBOUND RECEIPTS & TELEMETRY
  ******************************************************************************/
-void loop()
+static String pubTopic(const char *leaf)
 {
-  // Reduce M5.update() calls - only update every 100ms
-  static unsigned long lastM5Update = 0;
-  unsigned long currentMillis = millis();
-  if (currentMillis - lastM5Update >= 100) {
-    M5.update();
-    lastM5Update = currentMillis;
-    
-    // Check if BtnA was pressed to wake up screen
-    if (M5.BtnA.wasPressed()) {
-      M5.Display.setBrightness(fullBrightness);
-      lastBrightnessChange = millis(); // reset timeout timer
-    }
-  }
-    
-  unsigned long elapsed = millis() - lastBrightnessChange;
+  return pubTopicBase + "/" + leaf;
+}
 
-  // Check charging status via the power management chip rather than
-  // guessing from a raw battery voltage threshold.
-  isCharging = M5.Power.isCharging();
-  
-  static uint8_t lastBrightness = fullBrightness;
-  uint8_t targetBrightness = fullBrightness;
-  
-  if (isCharging) {
-    // Keep screen at full brightness when charging
-    targetBrightness = fullBrightness;
-  } else {
-    // On battery: enable dimming to save power
-    if (enableDimming && elapsed > brightnessTimeout) {
-      unsigned long fadeTime = elapsed - brightnessTimeout;
-      if (fadeTime < fadeDuration) {
-        // Compute new brightness linearly between fullBrightness and dimBrightness
-        targetBrightness = fullBrightness - ((fullBrightness - dimBrightness) * fadeTime) / fadeDuration;
-      } else {
-        // Fade completed: set brightness to dim value
-        targetBrightness = dimBrightness;
-      }
-    }
-  }
-  
-  // Only update brightness if it changed (reduces flickering)
-  if (targetBrightness != lastBrightness) {
-    M5.Display.setBrightness(targetBrightness);
-    lastBrightness = targetBrightness;
+// Queue doc on <base>/<leaf>. serializeJson() would silently cut anything
+// longer than a queue slot into invalid JSON, so an oversized document is
+// logged and dropped instead; callers trim or split before getting here.
+static bool enqueueJson(const char *leaf, const JsonDocument &doc, bool replace = false)
+{
+  char buf[PublishQueue::kMaxPayload];
+  const size_t need = measureJson(doc);
+  if (need >= sizeof(buf))
+  {
+    LOGW("%s: %u B doesn't fit a %u B message, dropped", leaf, (unsigned)need, (unsigned)sizeof(buf));
+    return false;
   }
-  if (wifiConnect())
+  size_t len = serializeJson(doc, buf, sizeof(buf));
+  return publishQueue.enqueue(pubTopic(leaf).c_str(), buf, len, replace);
+}
+
+// Serialize all pending receipts on <base>/receipts, in as few messages as
+// fit a queue slot.
+static void flushReceipts()
+{
+  size_t i = 0;
+  while (i < pendingReceiptCount)
   {
-    if (!mqttClient.connected())
+    JsonDocument doc;
+    doc["device"] = MQTT_CLIENT_ID;
+    doc["seq"] = ++outboundSeq;
+    JsonArray list = doc["receipts"].to<JsonArray>();
+    for (; i < pendingReceiptCount; i++)
     {
-      long now = millis();
-      if (now - mqttLastReconnectAttempt > 15000) // Increased from 5000 to 15000 (15 seconds)
+      JsonObject r = list.add<JsonObject>();
+      r["id"] = pendingReceipts[i].id;
+      r["ev"] = pendingReceipts[i].event == kReceiptAcked ? "acked" : "displayed";
+      r["t"] = pendingReceipts[i].atMs;
+      if (list.size() > 1 && measureJson(doc) >= PublishQueue::kMaxPayload)
       {
-        mqttLastReconnectAttempt = now;
-        if (mqttReconnect())
-          mqttLastReconnectAttempt = 0;
-        else
-        {
-          Serial.println("MQTT Connection failed");
-        }
+        list.remove(list.size() - 1); // starts the next message
+        break;
       }
     }
-    else
-    {
-      mqttClient.loop();
-    }
+    enqueueJson("receipts", doc);
   }
-  
-  // Reduce CPU usage when idle
-  delay(50);
-}
\ No newline at end of file
+  pendingReceiptCount = 0;
+}
+
+void recordReceipt(const char *id, ReceiptEvent event)
+{
+  if (pendingReceiptCount == kMaxReceipts) flushReceipts();
+  if (pendingReceiptCount == 0) firstReceiptAt = millis();
+  Receipt &r = pendingReceipts[pendingReceiptCount++];
+  strlcpy(r.id, id, sizeof(r.id));
+  r.event = event;
+  r.atMs = millis();
+}
+
+// BtnA: everything on screen counts as read.
+void acknowledgeDisplayed()
+{
+  for (size_t i = 0; i < unackedCount; i++)
+  {
+    recordReceipt(unackedIds[i], kReceiptAcked);
+  }
+  unackedCount = 0;
+}
+
+static float sensorReadsPerMinute(uint8_t ch)
+{
+  uint32_t ms = millis();
+  return ms ? sensors.reads(ch) * 60000.0f / ms : 0.0f;
+}
+
+// Counters of the optional subsystems on <base>/subsystems, sent with
+// telemetry but kept out of it so that one stays within a queue slot.
+static void enqueueSubsystems()
+{
+  JsonDocument doc;
+  doc["device"] = MQTT_CLIENT_ID;
+  doc["seq"] = ++outboundSeq;
+  // Canvas per display: [frames, skipped, slices, pixels, maxLagMs].
+  JsonArray panels = doc["panels"].to<JsonArray>();
+  for (int8_t t = 0; t < (int8_t)presenter.targets(); t++)
+  {
+    const TilePresenter::Stats &ts = presenter.stats(t);
+    JsonArray a = panels.add<JsonArray>();
+    a.add(ts.frames);
+    a.add(ts.skipped);
+    a.add(ts.slices);
+    a.add(ts.pixels);
+    a.add(ts.maxLagMs);
+  }
+  // Settings log: [keys, liveBytes, fileBytes, compactions].
+  JsonArray kv = doc["kv"].to<JsonArray>();
+  kv.add(kvStore.size());
+  kv.add(kvStore.liveBytes());
+  kv.add(kvStore.fileBytes());
+  kv.add(kvStore.compactions());
+  // Sounds: [posted, started, preempted, coalesced, dropped].
+  JsonArray snd = doc["snd"].to<JsonArray>();
+  snd.add(audio.posted());
+  snd.add(audio.started());
+  snd.add(audio.preempted());
+  snd.add(audio.coalesced());
+  snd.add(audio.dropped());
+#if SCREEN_SNAPSHOT
+  // Screen snapshot: [bytes, writes, last writeUs, restoreUs].
+  JsonArray snap = doc["snap"].to<JsonArray>();
+  snap.add(snapshotStats.bytes);
+  snap.add(snapshotStats.writes);
+  snap.add(snapshotStats.writeUs);
+  snap.add(snapshotStats.restoreUs);
+#endif
+  enqueueJson("subsystems", doc, true);
+}
+
+// Latest device state on <base>/telemetry. Replaces a not-yet-sent snapshot
+// rather than queueing behind it.
+static void enqueueTelemetry()
+{
+  JsonDocument doc;
+  doc["device"] = MQTT_CLIENT_ID;
+  doc["seq"] = ++outboundSeq;
+  doc["uptime"] = millis() / 1000;
+  doc["bat"] = sensors.value(kSensorBattery);
+  doc["charging"] = isCharging;
+  doc["rssi"] = sensors.value(kSensorRssi);
+  doc["heap"] = ESP.getFreeHeap();
+  JsonObject mq = doc["mqtt"].to<JsonObject>();
+  mq["routed"] = routeStats.routed;
+  mq["dropped"] = routeStats.dropped;
+  JsonObject inf = doc["inflate"].to<JsonObject>();
+  inf["msgs"] = inflateStats.messages;
+  inf["fail"] = inflateStats.failures;
+  inf["in"] = inflateStats.bytesIn;
+  inf["out"] = inflateStats.bytesOut;
+  JsonObject st = doc["stream"].to<JsonObject>();
+  st["msgs"] = streamStats.messages;
+  st["overBudget"] = streamStats.overBudget;
+  st["malformed"] = streamStats.malformed;
+  st["largest"] = streamStats.largest;
+  const PublishQueue::Stats &qs = publishQueue.stats();
+  JsonObject out = doc["outq"].to<JsonObject>();
+  out["published"] = qs.published;
+  out["retransmits"] = qs.retransmits;
+  out["dropped"] = qs.dropped;
+  JsonObject lp = doc["loop"].to<JsonObject>();
+  const LatencyHistogram &it = loopProfiler.iterations();
+  lp["p99"] = it.percentile(99);
+  lp["max"] = it.max();
+  lp["overruns"] = loopProfiler.overruns();
+  lp["stall"] = loopStallAlert();
+  JsonObject sc = doc["sched"].to<JsonObject>();
+  sc["wakeups"] = schedStats.wakeups;
+  sc["socket"] = schedStats.socketWakeups;
+  sc["input"] = schedStats.inputWakeups;
+  sc["timers"] = timers.fired();
+  const PowerManager::Stats &ps = powerManager.stats();
+  const uint64_t totalUs = ps.idleUs + ps.awakeUs;
+  JsonObject pw = doc["power"].to<JsonObject>();
+  pw["mode"] = powerManager.modeName();
+  pw["idlePct"] = totalUs ? (float)(ps.idleUs * 100.0 / totalUs) : 0.0f;
+  pw["darkPct"] = totalUs ? (float)(ps.darkIdleUs * 100.0 / totalUs) : 0.0f;
+  // Sensor reads per minute since boot: [charger, battery, rssi].
+  JsonArray sr = pw["sensorRpm"].to<JsonArray>();
+  for (uint8_t i = 0; i < kSensorCount; i++) sr.add(sensorReadsPerMinute(i));
+  JsonArray present = pw["present"].to<JsonArray>();
+  present.add(presentStats.pushes);
+  present.add(presentStats.deferred);
+  present.add(presentStats.flushes);
+  JsonArray barBytes = pw["barBytes"].to<JsonArray>();
+  barBytes.add(presentStats.barBytes);
+  barBytes.add(presentStats.barFullBytes);
+  const LatencyHistogram &wl = powerManager.wakeLatency();
+  if (wl.count())
+  {
+    JsonArray wake = pw["wake"].to<JsonArray>();
+    wake.add(wl.count());
+    wake.add(wl.percentile(50));
+    wake.add(wl.percentile(99));
+    wake.add(wl.max());
+  }
+  JsonObject cpu = doc["cpu"].to<JsonObject>();
+  const uint64_t lowUs = cpuGovernor.residencyUs(CpuGovernor::kLow);
+  const uint64_t highUs = cpuGovernor.residencyUs(CpuGovernor::kHigh);
+  cpu["lowPct"] = (lowUs + highUs) ? (float)(lowUs * 100.0 / (lowUs + highUs)) : 0.0f;
+  cpu["switches"] = cpuGovernor.switches();
+  JsonObject lat = cpu["lat"].to<JsonObject>();
+  for (uint8_t l = 0; l < CpuGovernor::kLevelCount; l++)
+  {
+    const LatencyHistogram &h = cpuGovernor.latency((CpuGovernor::Level)l);
+    if (!h.count()) continue;
+    JsonArray a = lat[String(cpuGovernor.mhz((CpuGovernor::Level)l))].to<JsonArray>();
+    a.add(h.count());
+    a.add(h.percentile(50));
+    a.add(h.percentile(99));
+  }
+  JsonObject lg = doc["log"].to<JsonObject>();
+  lg["written"] = AsyncLog::instance().written();
+  lg["dropped"] = AsyncLog::instance().dropped();
+  if (loopProfiler.overruns()) lp["worst"] = loopProfiler.name(loopProfiler.worstSection());
+  if (heapMonitor.count())
+  {
+    const HeapSample &hs = heapMonitor.last();
+    JsonObject mem = doc["mem"].to<JsonObject>();
+    mem["largest"] = hs.largestBlock;
+    mem["min"] = hs.minFree;
+    mem["frag"] = HeapMonitor::fragmentation(hs);
+    mem["trend"] = heapMonitor.freeSlope();
+    mem["flags"] = heapFlags;
+    JsonObject per = mem["handlers"].to<JsonObject>();
+    for (const auto &h : kHandlerNames)
+    {
+      const HeapMonitor::HandlerAlloc &a = heapMonitor.handler(h.id);
+      if (!a.calls) continue;
+      JsonArray arr = per[h.name].to<JsonArray>();
+      arr.add(a.calls);
+      arr.add(a.netBytes);
+    }
+    // Per-handler figures grow with the route table; they go first.
+    if (measureJson(doc) >= PublishQueue::kMaxPayload) mem.remove("handlers");
+  }
+  enqueueJson("telemetry", doc, true);
+  enqueueSubsystems();
+}
+
+// Per-stage latency for the current window as {"stage":[n,p50,p99,max]},
+// plus inflate cost/ratio; the window is reset once queued.
+static void enqueueStageStats()
+{
+  JsonDocument doc;
+  doc["device"] = MQTT_CLIENT_ID;
+  doc["seq"] = ++outboundSeq;
+  doc["window"] = kStatsIntervalMs / 1000;
+  JsonObject stages = doc["stages"].to<JsonObject>();
+  for (uint8_t i = 0; i < stageProfiler.size(); i++)
+  {
+    const LatencyHistogram &h = stageProfiler.stage(i);
+    if (h.count() == 0) continue;
+    JsonArray a = stages[stageProfiler.name(i)].to<JsonArray>();
+    a.add(h.count());
+    a.add(h.percentile(50));
+    a.add(h.percentile(99));
+    a.add(h.max());
+  }
+  if (inflateStats.messages)
+  {
+    JsonObject inf = doc["inflate"].to<JsonObject>();
+    inf["ratio"] = (float)inflateStats.bytesOut / (float)inflateStats.bytesIn;
+    inf["avgUs"] = (uint32_t)(inflateStats.decodeUs / inflateStats.messages);
+    inf["lastRatio"] = (float)inflateStats.lastOut / inflateStats.lastIn;
+    inf["lastUs"] = inflateStats.lastUs;
+  }
+  if (imageStats.messages)
+  {
+    JsonObject img = doc["img"].to<JsonObject>();
+    img["msgs"] = imageStats.messages;
+    img["decoded"] = imageStats.decoded;
+    img["avgUs"] = imageStats.decoded ? (uint32_t)(imageStats.decodeUs / imageStats.decoded) : 0;
+    img["hits"] = iconCache.hits();
+    img["evicted"] = iconCache.evictions();
+    img["cacheBytes"] = iconCache.bytes();
+    img["failures"] = imageStats.failures;
+  }
+  if (clockSync.valid())
+  {
+    JsonObject clk = doc["clock"].to<JsonObject>();
+    clk["offset"] = clockSync.offset();
+    clk["rtt"] = clockSync.rtt();
+  }
+  if (e2eLatency.count())
+  {
+    // Last 64 stamped notifications, exact percentiles in ms.
+    JsonArray e2e = doc["e2e"].to<JsonArray>();
+    e2e.add(e2eLatency.count());
+    e2e.add(e2eLatency.percentile(50));
+    e2e.add(e2eLatency.percentile(90));
+    e2e.add(e2eLatency.percentile(99));
+    e2e.add(e2eLatency.percentile(100));
+  }
+
+  // Estimated mAh per component since boot, calibrated average draw and
+  // the runtime it implies on a full battery.
+  JsonObject en = doc["energy"].to<JsonObject>();
+  JsonObject mah = en["mAh"].to<JsonObject>();
+  for (uint8_t i = 0; i < EnergyModel::kCount; i++)
+  {
+    mah[EnergyModel::name(i)] = energy.mAh(i);
+  }
+  en["scale"] = energy.scale();
+  en["avgMa"] = energy.averageMa();
+  en["lifeH"] = energy.lifeHours();
+
+  // Optional sections, dropped in this order if the window won't fit.
+  static const char *const kOptional[] = {"img", "clock", "inflate"};
+  for (const char *key : kOptional)
+  {
+    if (measureJson(doc) >= PublishQueue::kMaxPayload) doc.remove(key);
+  }
+  enqueueJson("stats", doc, true);
+  stageProfiler.reset();
+}
+
+void dumpStageStats()
+{
+  // Lines built piece by piece go to the logger whole, via print().
+  char line[AsyncLog::kMaxText];
+  int len = snprintf(line, sizeof(line), "stats (n/p50/p99/max us): ");
+  stageProfiler.summarize(line + len, sizeof(line) - len);
+  AsyncLog::instance().print(line);
+  for (uint8_t i = 0; i < stageProfiler.size(); i++)
+  {
+    const LatencyHistogram &h = stageProfiler.stage(i);
+    if (h.count() == 0) continue;
+    len = snprintf(line, sizeof(line), "  %-6s mean %lu us |", stageProfiler.name(i), (unsigned long)h.mean());
+    for (uint8_t b = 0; b < LatencyHistogram::kBuckets && len < (int)sizeof(line); b++)
+    {
+      if (h.bucket(b))
+        len += snprintf(line + len, sizeof(line) - len, " <=%lu:%lu", (unsigned long)LatencyHistogram::bucketUpper(b),
+                        (unsigned long)h.bucket(b));
+    }
+    AsyncLog::instance().print(line);
+  }
+  if (e2eLatency.count())
+  {
+    LOGP("  e2e    n %u p50 %lu p90 %lu p99 %lu max %lu ms (clock offset %lld, rtt %u)\n",
+                  e2eLatency.count(), (unsigned long)e2eLatency.percentile(50),
+                  (unsigned long)e2eLatency.percentile(90), (unsigned long)e2eLatency.percentile(99),
+                  (unsigned long)e2eLatency.percentile(100),
+                  (long long)clockSync.offset(), (unsigned)clockSync.rtt());
+  }
+  dumpLoopStats();
+}
+
+void dumpLoopStats()
+{
+  const LatencyHistogram &it = loopProfiler.iterations();
+  LOGP("loop: n %lu p50 %lu p99 %lu max %lu us, %lu over %lu us budget\n",
+                (unsigned long)it.count(), (unsigned long)it.percentile(50),
+                (unsigned long)it.percentile(99), (unsigned long)it.max(),
+                (unsigned long)loopProfiler.overruns(), (unsigned long)loopProfiler.budgetUs());
+  unsigned long uptimeS = millis() / 1000;
+  LOGP("  wakeups %lu (%.1f/s), socket %lu, input %lu, timers fired %lu\n",
+                (unsigned long)schedStats.wakeups,
+                uptimeS ? (float)schedStats.wakeups / uptimeS : 0.0f,
+                (unsigned long)schedStats.socketWakeups, (unsigned long)schedStats.inputWakeups,
+                (unsigned long)timers.fired());
+  LOGP("  button queue overflows %lu%s\n", (unsigned long)buttons.overflows(),
+                buttonsPolled ? " (polled)" : "");
+  for (uint8_t i = 0; i < loopProfiler.size(); i++)
+  {
+    LOGP("  %-8s max %lu us, blamed %lu\n", loopProfiler.name(i),
+                  (unsigned long)loopProfiler.sectionMax(i), (unsigned long)loopProfiler.blamed(i));
+  }
+}
+
+void dumpHeapStats()
+{
+  HeapSample hs = heapSnapshot();
+  LOGP("heap: free %lu, largest %lu (%u%% fragmented), min %lu, %lu blocks\n",
+                (unsigned long)hs.freeBytes, (unsigned long)hs.largestBlock,
+                HeapMonitor::fragmentation(hs), (unsigned long)hs.minFree,
+                (unsigned long)hs.allocBlocks);
+  LOGP("  trend over %u samples: free %ld B, largest %ld B per sample, flags 0x%02x\n",
+                heapMonitor.count(), (long)heapMonitor.freeSlope(),
+                (long)heapMonitor.largestSlope(), heapFlags);
+  for (const auto &h : kHandlerNames)
+  {
+    const HeapMonitor::HandlerAlloc &a = heapMonitor.handler(h.id);
+    if (!a.calls) continue;
+    LOGP("  %-8s %lu msgs, retained %ld B (worst %ld B)\n", h.name,
+                  (unsigned long)a.calls, (long)a.netBytes, (long)a.maxRetained);
+  }
+}
+
+void dumpPowerStats()
+{
+  const PowerManager::Stats &ps = powerManager.stats();
+  const uint64_t totalUs = ps.idleUs + ps.awakeUs;
+  LOGP("power: %s, listen interval %u\n", powerManager.modeName(), POWER_LISTEN_INTERVAL);
+  if (totalUs)
+  {
+    LOGP("  idle %.1f%% (light-sleep eligible %.1f%%), %lu wakeups\n",
+                  ps.idleUs * 100.0 / totalUs, ps.darkIdleUs * 100.0 / totalUs,
+                  (unsigned long)ps.wakeups);
+  }
+  LOGP("  sensor reads/min: charger %.1f, battery %.1f, rssi %.1f\n",
+                sensorReadsPerMinute(kSensorCharging), sensorReadsPerMinute(kSensorBattery),
+                sensorReadsPerMinute(kSensorRssi));
+  LOGP("  panel pushes %lu, deferred while dark %lu, flushed on wake %lu%s\n",
+                (unsigned long)presentStats.pushes, (unsigned long)presentStats.deferred,
+                (unsigned long)presentStats.flushes, POWER_PANEL_SLEEP ? ", panel sleeps" : "");
+  LOGP("  status bar: %lu bytes pushed, %lu as whole-bar pushes\n",
+                (unsigned long)presentStats.barBytes, (unsigned long)presentStats.barFullBytes);
+  const LatencyHistogram &wl = powerManager.wakeLatency();
+  LOGP("  socket wake -> pixels: n %lu p50 %lu p99 %lu max %lu us\n",
+                (unsigned long)wl.count(), (unsigned long)wl.percentile(50),
+                (unsigned long)wl.percentile(99), (unsigned long)wl.max());
+}
+
+void dumpCpuStats()
+{
+  const uint64_t lowUs = cpuGovernor.residencyUs(CpuGovernor::kLow);
+  const uint64_t highUs = cpuGovernor.residencyUs(CpuGovernor::kHigh);
+  const uint64_t totalUs = lowUs + highUs;
+  LOGP("cpu: now %u MHz, %lu switches, %s\n", (unsigned)ESP.getCpuFreqMHz(),
+                (unsigned long)cpuGovernor.switches(),
+                powerManager.pmActive() ? "esp_pm DFS" : "setCpuFrequencyMhz");
+  for (uint8_t l = 0; l < CpuGovernor::kLevelCount; l++)
+  {
+    CpuGovernor::Level level = (CpuGovernor::Level)l;
+    const LatencyHistogram &h = cpuGovernor.latency(level);
+    LOGP("  %3u MHz: %.1f%% of time; callbacks n %lu p50 %lu p99 %lu max %lu us\n",
+                  cpuGovernor.mhz(level),
+                  totalUs ? cpuGovernor.residencyUs(level) * 100.0 / totalUs : 0.0,
+                  (unsigned long)h.count(), (unsigned long)h.percentile(50),
+                  (unsigned long)h.percentile(99), (unsigned long)h.max());
+  }
+  for (uint8_t r = 0; r < CpuGovernor::kReasonCount; r++)
+  {
+    CpuGovernor::Reason reason = (CpuGovernor::Reason)r;
+    LOGP("  boosts on %-8s %lu\n", CpuGovernor::reasonName(reason),
+                  (unsigned long)cpuGovernor.boosts(reason));
+  }
+}
+
+void dumpEnergyStats()
+{
+  const float total = energy.totalMah();
+  LOGP("energy: %.2f mAh modelled, scale %.2f (%lu calibrations), avg %.2f mA, ~%.0f h per charge\n",
+                total, energy.scale(), (unsigned long)energy.calibrations(), energy.averageMa(),
+                energy.lifeHours());
+  for (uint8_t i = 0; i < EnergyModel::kCount; i++)
+  {
+    LOGP("  %-9s %8.3f mAh %5.1f%%\n", EnergyModel::name(i), energy.mAh(i),
+                  total > 0 ? energy.mAh(i) * 100.0f / total : 0.0f);
+  }
+}
+
+static void emitFsBenchLine(const char *line) { AsyncLog::instance().print(line); }
+
+static uint64_t fsBenchClockUs() { return esp_timer_get_time(); }
+
+static bool littleFsUsage(uint64_t &used, uint64_t &total)
+{
+  used = LittleFS.usedBytes();
+  total = LittleFS.totalBytes();
+  return total > 0;
+}
+
+// Runs the filesystem benchmark suite on LittleFS, one JSON line per result
+// on the serial port. Blocks the loop for tens of seconds and temporarily
+// fills the partition to 90 %, so only use it on a bench device.
+void runFsBench()
+{
+  static FSBench bench("/littlefs", "littlefs", emitFsBenchLine, fsBenchClockUs, littleFsUsage);
+  LOGI("fsbench: starting, the loop is blocked until it finishes");
+  bool ok = bench.run();
+  LOGI("fsbench: %s, %lu errors", ok ? "done" : "failed", (unsigned long)bench.errors());
+}
+
+// Heap sample, every kHeapSampleMs from the scheduler. A newly raised trend
+// flag is logged and pushes an immediate telemetry message so it's seen
+// before allocations start failing.
+void serviceHeapMonitor()
+{
+  heapMonitor.addSample(heapSnapshot());
+  uint8_t flags = heapMonitor.flags();
+  uint8_t raised = flags & ~heapFlags;
+  heapFlags = flags;
+  if (raised)
+  {
+    LOGW("heap warning:%s%s%s",
+                  (raised & HeapMonitor::kFlagFragmenting) ? " fragmenting" : "",
+                  (raised & HeapMonitor::kFlagLeaking) ? " leaking" : "",
+                  (raised & HeapMonitor::kFlagLowBlock) ? " low-block" : "");
+    enqueueTelemetry();
+  }
+}
+
+// Line-buffered serial console; each line is run through handleCommand().
+void pollSerialCommands()
+{
+  static char line[32];
+  static size_t len = 0;
+  while (Serial.available())
+  {
+    char c = Serial.read();
+    if (c == '\r' || c == '\n')
+    {
+      if (len == 0) continue;
+      line[len] = '\0';
+      len = 0;
+      handleCommand(line, true);
+    }
+    else if (len < sizeof(line) - 1)
+    {
+      line[len++] = c;
+    }
+  }
+}
+
+// Ping is published directly rather than queued: t0 must be the send time.
+static void sendClockPing()
+{
+  char buf[64];
+  int len = snprintf(buf, sizeof(buf), "{\"seq\":%u,\"t0\":%lu}",
+                     (unsigned)++pingSeq, (unsigned long)millis());
+  mqttClient.publish(pubTopic("ping").c_str(), (const uint8_t *)buf, len, false);
+  if (unansweredPings < kPingUnanswered) unansweredPings++;
+  else if (pingIntervalMs < kPingMaxIntervalMs)
+  {
+    pingIntervalMs = pingIntervalMs * 2 < kPingMaxIntervalMs ? pingIntervalMs * 2 : kPingMaxIntervalMs;
+    LOGD("clock: no pong, pinging every %lu s", pingIntervalMs / 1000);
+  }
+}
+
+// {"seq":n,"t0":<echoed device ms>,"t1":<host rx epoch ms>,"t2":<host tx epoch ms>}
+void handlePong(const JsonDocument &doc)
+{
+  uint32_t t3 = millis();
+  if (!doc["t0"].is<unsigned long>() || !doc["t1"].is<long long>() || !doc["t2"].is<long long>())
+  {
+    LOGW("Invalid pong");
+    return;
+  }
+  unansweredPings = 0;
+  pingIntervalMs = kPingIntervalMs;
+  clockSync.addSample(doc["t0"].as<unsigned long>(), doc["t1"].as<long long>(),
+                      doc["t2"].as<long long>(), t3);
+  LOGD("clock: offset %lld ms, best rtt %u ms",
+                (long long)clockSync.offset(), (unsigned)clockSync.rtt());
+}
+
+// Called after mqttClient.loop() while connected.
+void serviceOutbound()
+{
+  unsigned long now = millis();
+  if (pendingReceiptCount && (linkHot || now - firstReceiptAt >= kReceiptMaxDelayMs))
+  {
+    flushReceipts();
+  }
+  static unsigned long lastTelemetry = 0;
+  if (lastTelemetry == 0 || now - lastTelemetry >= kTelemetryIntervalMs)
+  {
+    lastTelemetry = now;
+    enqueueTelemetry();
+  }
+  static unsigned long lastPing = 0;
+  if (lastPing == 0 || now - lastPing >= pingIntervalMs)
+  {
+    lastPing = now;
+    sendClockPing();
+  }
+  static unsigned long lastStats = millis();
+  if (now - lastStats >= kStatsIntervalMs)
+  {
+    lastStats = now;
+    enqueueStageStats();
+  }
+  publishQueue.flush(mqttClient.connected(), now);
+  linkHot = false;
+}
+
+/******************************************************************************
+ *                              SCHEDULER
+ ******************************************************************************/
+// All backlight changes go through here. Reaching 0 starts deferring
+// presents (and sleeps the panel); leaving 0 wakes the panel and pushes
+// whatever changed while dark before the light comes up.
+static void setBacklight(uint8_t level)
+{
+  const bool dark = level == 0;
+  if (!dark && panelDark)
+  {
+    panelDark = false;
+    if (POWER_PANEL_SLEEP) M5.Display.wakeup();
+    if (POWER_PANEL_SLEEP && mirrorPanel) mirrorPanel->wakeup();
+    if (statusBarDirty || canvasDirty) presentStats.flushes++;
+    if (statusBarDirty) drawStatusBar();
+    if (canvasDirty) presentCanvas();
+  }
+  M5.Display.setBrightness(level);
+  if (mirrorPanel) mirrorPanel->setBrightness(level);
+  currentBrightness = level;
+  powerManager.allowLightSleep(dark);
+  if (dark && !panelDark)
+  {
+    panelDark = true;
+    if (POWER_PANEL_SLEEP) M5.Display.sleep();
+    if (POWER_PANEL_SLEEP && mirrorPanel) mirrorPanel->sleep();
+  }
+  const uint64_t now = esp_timer_get_time();
+  backlightEnergy.set(level, now);
+  panelEnergy.set(!(panelDark && POWER_PANEL_SLEEP), now);
+}
+
+// Full brightness now; the fade timer takes it from there.
+void wakeScreen()
+{
+  setBacklight(fullBrightness);
+  lastBrightnessChange = millis(); // reset timeout timer
+  timers.start(fadeTimer, brightnessTimeout, lastBrightnessChange);
+}
+
+// Any press lights the screen at once. BtnA: click acknowledges what is on
+// screen, hold also clears it. BtnB: click pages back through scrollback,
+// double-click pages forward, hold returns to the newest lines.
+static void onGesture(uint8_t button, ButtonGesture::Event event)
+{
+  if (event == ButtonGesture::kDown)
+  {
+    wakeScreen();
+    return;
+  }
+  bool redraw = false;
+  if (button == kBtnA)
+  {
+    if (event == ButtonGesture::kClick || event == ButtonGesture::kDoubleClick)
+    {
+      redraw = canvas.showLive();
+      acknowledgeDisplayed();
+    }
+    else if (event == ButtonGesture::kLongPress)
+    {
+      acknowledgeDisplayed();
+      handleCommand("clear");
+    }
+  }
+  else if (button == kBtnB)
+  {
+    if (event == ButtonGesture::kClick) redraw = canvas.page(1);
+    else if (event == ButtonGesture::kDoubleClick) redraw = canvas.page(-1);
+    else if (event == ButtonGesture::kLongPress) redraw = canvas.showLive();
+  }
+  if (redraw) presentCanvas();
+}
+
+// Drain queued edges, then the time-based gestures, then re-arm the button
+// timer for the next gesture deadline (if any).
+static void serviceInput()
+{
+  ButtonInput::Edge edge;
+  while (buttons.pop(edge))
+  {
+    ButtonGesture::Event event = gestures[edge.button].edge(edge.pressed, edge.ms);
+    if (event != ButtonGesture::kNone) onGesture(edge.button, event);
+  }
+  uint32_t now = millis();
+  uint32_t next = buttonsPolled || wakeFd < 0 ? kInputPollMs : ButtonGesture::kNever;
+  for (uint8_t b = 0; b < kButtonCount; b++)
+  {
+    ButtonGesture::Event event;
+    while ((event = gestures[b].poll(buttons.rawPressed(b), now)) != ButtonGesture::kNone)
+    {
+      onGesture(b, event);
+    }
+    uint32_t due = gestures[b].msUntilDeadline(now);
+    if (due < next) next = due;
+  }
+  if (next != ButtonGesture::kNever) timers.start(buttonTimer, next, now);
+  else timers.stop(buttonTimer);
+  loopProfiler.mark(kSectionInput, micros());
+  pollSerialCommands();
+  loopProfiler.mark(kSectionConsole, micros());
+}
+
+static void onButtonTimer(void *) { serviceInput(); }
+
+// Dim-on-idle fade. Re-arms itself for the next brightness change: when the
+// timeout ends, then every kFadeStepMs while fading; once fully dimmed it
+// stays idle until wakeScreen() or a charge-state change.
+static void onFadeTimer(void *)
+{
+  unsigned long elapsed = millis() - lastBrightnessChange;
+  uint8_t targetBrightness = fullBrightness;
+  uint32_t nextMs = 0;
+
+  // Keep screen at full brightness when charging; on battery, dim to save power.
+  if (!isCharging && enableDimming)
+  {
+    if (elapsed < brightnessTimeout)
+    {
+      nextMs = brightnessTimeout - elapsed;
+    }
+    else if (elapsed - brightnessTimeout < fadeDuration)
+    {
+      // Compute new brightness linearly between fullBrightness and dimBrightness
+      unsigned long fadeTime = elapsed - brightnessTimeout;
+      targetBrightness = fullBrightness - ((fullBrightness - dimBrightness) * fadeTime) / fadeDuration;
+      nextMs = kFadeStepMs;
+    }
+    else
+    {
+      // Fade completed: set brightness to dim value
+      targetBrightness = dimBrightness;
+    }
+  }
+
+  // Only update brightness if it changed (reduces flickering)
+  if (targetBrightness != currentBrightness) setBacklight(targetBrightness);
+  if (nextMs) timers.start(fadeTimer, nextMs, millis());
+  loopProfiler.mark(kSectionPower, micros());
+}
+
+// Repaint the status bar if anything on it moved (refreshStatusBar() is
+// change-detected, so the LCD bus stays idle when the bar is stable). Only
+// cached sensor values are used here; the MQTT and stall markers are why
+// this still runs on a period.
+static void onStatusTimer(void *)
+{
+  refreshStatusBar();
+  loopProfiler.mark(kSectionPower, micros());
+}
+
+// Read whichever sensors are due (or were invalidated by a Wi-Fi event) and
+// react to the ones that moved past their threshold.
+static void onSensorTimer(void *)
+{
+  uint32_t now = millis();
+  uint32_t changed = sensors.poll(now);
+  if (changed & (1UL << kSensorCharging))
+  {
+    isCharging = sensors.value(kSensorCharging);
+    timers.start(fadeTimer, 0, now);
+  }
+  if (changed) refreshStatusBar();
+  uint32_t next = sensors.msUntilNext(now);
+  if (next != SensorSampler::kNever) timers.start(sensorTimer, next, now);
+  loopProfiler.mark(kSectionPower, micros());
+}
+
+static void onWifiTimer(void *)
+{
+  serviceLink();
+  wifiConnect();
+  loopProfiler.mark(kSectionWifi, micros());
+}
+
+// Hands the connect to the link task; the result comes back via serviceLink().
+static void onMqttConnectTimer(void *)
+{
+  if (WiFi.status() != WL_CONNECTED || mqttBusy.load() || mqttClient.connected()) return;
+  boostCpu(CpuGovernor::kConnect); // TLS handshake is the heaviest thing we do
+  mqttBusy.store(true, std::memory_order_release);
+  wakeLinkTask();
+  loopProfiler.mark(kSectionMqttConn, micros());
+}
+
+// Read at most one packet, then run the outbound side. Also notices a dropped
+// connection: in-flight publishes are requeued and a reconnect is scheduled.
+static void serviceMqtt()
+{
+  static bool wasConnected = false;
+  if (mqttBusy.load()) return; // the link task is connecting
+  bool connected = mqttClient.connected();
+  if (connected)
+  {
+    streamIngest.begin(); // one loop() reads at most one packet
+    loopStartUs = micros();
+    mqttClient.loop();
+    loopProfiler.mark(kSectionMqttLoop, micros());
+    serviceOutbound();
+    loopProfiler.mark(kSectionOutbound, micros());
+    connected = mqttClient.connected();
+  }
+  if (wasConnected && !connected)
+  {
+    // Anything published but not yet settled is re-sent after a reconnect.
+    publishQueue.onDisconnect();
+    timers.start(mqttConnectTimer, 0, millis());
+  }
+  wasConnected = connected;
+}
+
+// Keepalive pings and the outbound timers (receipts, telemetry, stats) still
+// need mqttClient.loop() when nothing arrives.
+static void onLinkTimer(void *) { serviceMqtt(); }
+
+// The connect boost has to last until the link task hands the client back:
+// a TLS handshake takes seconds, far beyond one kHoldMs.
+static void onGovernorTimer(void *)
+{
+  if (mqttBusy.load())
+  {
+    timers.start(governorTimer, CpuGovernor::kHoldMs, millis());
+    return;
+  }
+  cpuGovernor.relax(millis());
+}
+
+// Feed the energy model the activity since the last tick, then check it
+// against the battery gauge.
+static void onEnergyTimer(void *)
+{
+  static PowerManager::Stats lastPower = {};
+  static uint64_t lastHighUs = 0, lastLowUs = 0, lastSpeakerUs = 0;
+  static uint32_t lastSocketWakes = 0, lastCanvasBytes = 0, lastBarBytes = 0;
+
+  const uint64_t now = esp_timer_get_time();
+  const PowerManager::Stats &ps = powerManager.stats();
+  const uint64_t highUs = cpuGovernor.residencyUs(CpuGovernor::kHigh);
+  const uint64_t lowUs = cpuGovernor.residencyUs(CpuGovernor::kLow);
+
+  // Awake time is split between the clocks in the governor's proportion.
+  const uint64_t awake = ps.awakeUs - lastPower.awakeUs;
+  const uint64_t dHigh = highUs - lastHighUs, dLow = lowUs - lastLowUs;
+  const uint64_t awakeHigh = dHigh + dLow ? awake * dHigh / (dHigh + dLow) : 0;
+  const uint64_t dark = ps.darkIdleUs - lastPower.darkIdleUs;
+  const uint64_t idle = ps.idleUs - lastPower.idleUs;
+  const uint64_t sleep = powerManager.lightSleepEnabled() ? dark : 0;
+
+  EnergyModel::Sample sample = {};
+  sample.elapsedUs = now - energyTickUs;
+  sample.backlightLevelUs = backlightEnergy.take(now);
+  sample.cpuHighUs = awakeHigh;
+  sample.cpuLowUs = awake - awakeHigh;
+  sample.idleUs = idle - sleep;
+  sample.sleepUs = sleep;
+  sample.radioUpUs = radioEnergy.take(now);
+  sample.radioDownUs = sample.elapsedUs > sample.radioUpUs ? sample.elapsedUs - sample.radioUpUs : 0;
+  sample.radioWakes = schedStats.socketWakeups - lastSocketWakes;
+  sample.panelAwakeUs = panelEnergy.take(now);
+  sample.spiBytes = (presentStats.canvasBytes - lastCanvasBytes) + (presentStats.barBytes - lastBarBytes);
+  sample.speakerUs = audio.audibleUs() - lastSpeakerUs;
+  energy.add(sample);
+  energy.calibrate(sensors.value(kSensorBattery), isCharging);
+
+  lastPower = ps;
+  lastHighUs = highUs;
+  lastLowUs = lowUs;
+  lastSpeakerUs = audio.audibleUs();
+  lastSocketWakes = schedStats.socketWakeups;
+  lastCanvasBytes = presentStats.canvasBytes;
+  lastBarBytes = presentStats.barBytes;
+  energyTickUs = now;
+  loopProfiler.mark(kSectionPower, micros());
+}
+
+// Replace the splash with whatever was printed while it was up.
+static void onSplashTimer(void *)
+{
+  splashUp = false;
+  canvas.redraw();
+  presentCanvas();
+}
+
+static void onBootTimer(void *)
+{
+  if (!bootReported) reportBoot();
+}
+
+static void onAudioTimer(void *)
+{
+  audio.service(esp_timer_get_time());
+  scheduleAudio();
+  loopProfiler.mark(kSectionAudio, micros());
+}
+
+static void onMirrorTimer(void *)
+{
+  presenter.service(millis());
+  scheduleMirror();
+  loopProfiler.mark(kSectionDisplay, micros());
+}
+
+#if SCREEN_SNAPSHOT
+// kSnapshotQuietMs after the last present: save what is on screen.
+static void onSnapshotTimer(void *)
+{
+  saveSnapshot();
+  loopProfiler.mark(kSectionStorage, micros());
+}
+#endif
+
+// Rewrites the KV log without superseded records, off the write path.
+static void onKvTimer(void *)
+{
+  if (kvStore.needsCompaction()) kvStore.compact();
+  loopProfiler.mark(kSectionStorage, micros());
+}
+
+static void onHeapTimer(void *)
+{
+  serviceHeapMonitor();
+  loopProfiler.mark(kSectionHeap, micros());
+}
+
+// Runs in the UART driver's event task.
+static void onSerialReceive() { pokeLoop(); }
+
+// Button interrupts and the wake fd. Without the fd, loop() can't be woken
+// early and input is polled every kInputPollMs instead; without interrupts,
+// button levels are sampled at that rate.
+static void startInput()
+{
+  esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+  esp_err_t err = esp_vfs_eventfd_register(&config);
+  if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) wakeFd = eventfd(0, EFD_SUPPORT_ISR);
+  if (wakeFd < 0) LOGW("eventfd unavailable, polling input every %u ms", (unsigned)kInputPollMs);
+  else Serial.onReceive(onSerialReceive);
+
+  buttonsPolled = !buttons.begin(kButtonPins, kButtonCount, wakeFd);
+  if (buttonsPolled) LOGW("button interrupts unavailable, polling");
+}
+
+static int32_t readCharging() { return M5.Power.isCharging() ? 1 : 0; }
+static int32_t readBattery() { return M5.Power.getBatteryLevel(); }
+static int32_t readRssi() { return WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : -200; }
+
+// Wi-Fi event task: RSSI is stale after (dis)association, so re-read it now
+// rather than at the next period. Poking wakeFd gets loop() to do that.
+static void onWifiEvent(arduino_event_id_t event)
+{
+  sensors.invalidate(kSensorRssi);
+  if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) wakeLinkTask(); // reassociate now
+  pokeLoop();
+}
+
+// Registers the channels and takes the first reading of each, so the
+// initial status bar paint has real values.
+void startSensors()
+{
+  sensors.add(readCharging, kChargePollMs);
+  sensors.add(readBattery, kBatteryPollMs, 2, 1); // 1/4-weight EMA, 1 % steps
+  sensors.add(readRssi, kRssiPollMs, 1, 3);       // 1/2-weight EMA, 3 dB steps
+  sensors.poll(millis());
+  isCharging = sensors.value(kSensorCharging);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+}
+
+// Register a scheduler timer. A full TimerWheel returns -1, and that timer
+// would silently never fire.
+static int8_t addTimer(TimerWheel::Callback cb, uint32_t periodMs = 0)
+{
+  const int8_t id = timers.add(cb, nullptr, periodMs);
+  if (id < 0) LOGE("Timer table full (%u), a timer will never fire", (unsigned)TimerWheel::kMaxTimers);
+  return id;
+}
+
+void startScheduler()
+{
+  startInput();
+  buttonTimer = addTimer(onButtonTimer);
+  fadeTimer = addTimer(onFadeTimer);
+  statusTimer = addTimer(onStatusTimer, kStatusPollMs);
+  sensorTimer = addTimer(onSensorTimer);
+  wifiTimer = addTimer(onWifiTimer, kWifiPollMs);
+  mqttConnectTimer = addTimer(onMqttConnectTimer);
+  linkTimer = addTimer(onLinkTimer, kLinkServiceMs);
+  heapTimer = addTimer(onHeapTimer, kHeapSampleMs);
+  energyTimer = addTimer(onEnergyTimer, kEnergyTickMs);
+  governorTimer = addTimer(onGovernorTimer);
+  kvTimer = addTimer(onKvTimer);
+  splashTimer = addTimer(onSplashTimer);
+  bootTimer = addTimer(onBootTimer);
+  audioTimer = addTimer(onAudioTimer);
+  if (mirrorPanel) mirrorTimer = addTimer(onMirrorTimer);
+#if SCREEN_SNAPSHOT
+  snapshotTimer = addTimer(onSnapshotTimer);
+#endif
+
+  uint32_t now = millis();
+  timers.start(buttonTimer, 0, now);
+  timers.start(statusTimer, 0, now);
+  timers.start(sensorTimer, sensors.msUntilNext(now), now);
+  timers.start(wifiTimer, 0, now);
+  timers.start(linkTimer, kLinkServiceMs, now);
+  timers.start(heapTimer, 0, now);
+  timers.start(energyTimer, kEnergyTickMs, now);
+  energyTickUs = esp_timer_get_time();
+  timers.start(governorTimer, CpuGovernor::kHoldMs, now);
+  // Writes during setup (migration, seeding) couldn't arm kvTimer yet.
+  if (kvStore.needsCompaction()) timers.start(kvTimer, kKvCompactDelayMs, now);
+  if (splashUp)
+  {
+    const uint32_t splashShown = now - splashStartMs;
+    timers.start(splashTimer, splashShown < kSplashMs ? kSplashMs - splashShown : 0, now);
+  }
+#if SCREEN_SNAPSHOT
+  timers.start(snapshotTimer, kSnapshotQuietMs, now);
+#endif
+  if (mirrorPanel) scheduleMirror();
+  timers.start(bootTimer, kBootReportMs, now);
+  wakeScreen();
+}
+
+enum WakeSource : uint8_t
+{
+  kWakeSocket = 1, // MQTT socket readable
+  kWakeInput = 2,  // button edge, serial RX or Wi-Fi event
+};
+
+// Sleep until the MQTT socket or the input wake fd is readable, or timeoutMs
+// passes; returns the WakeSource bits that fired. WiFiClientSecure doesn't
+// expose its socket, so TLS builds fall back to polling it every
+// kSocketPollMs while connected.
+static uint8_t waitForEvents(uint32_t timeoutMs)
+{
+  const bool connected = mqttUp();
+  if (connected && wifiClient.available()) return kWakeSocket; // already buffered
+  const int sock = connected ? wifiClient.fd() : -1;
+  if (sock < 0 && connected && timeoutMs > kSocketPollMs) timeoutMs = kSocketPollMs;
+  if (sock < 0 && wakeFd < 0)
+  {
+    if (timeoutMs) delay(timeoutMs);
+    return connected && wifiClient.available() ? kWakeSocket : 0;
+  }
+
+  fd_set readable;
+  FD_ZERO(&readable);
+  if (sock >= 0) FD_SET(sock, &readable);
+  if (wakeFd >= 0) FD_SET(wakeFd, &readable);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  int ready = select((sock > wakeFd ? sock : wakeFd) + 1, &readable, nullptr, nullptr, &tv);
+  if (ready < 0)
+  {
+    delay(timeoutMs); // socket went away under us; the link timer will notice
+    return 0;
+  }
+  uint8_t sources = 0;
+  if (wakeFd >= 0 && FD_ISSET(wakeFd, &readable))
+  {
+    uint64_t count;
+    read(wakeFd, &count, sizeof(count)); // reset the eventfd
+    sources |= kWakeInput;
+  }
+  if (sock >= 0 ? FD_ISSET(sock, &readable) : connected && wifiClient.available()) sources |= kWakeSocket;
+  return sources;
+}
+
+/******************************************************************************
+ *                                MAIN LOOP
+ ******************************************************************************/
+void loop()
+{
+  powerManager.idleBegin();
+  const uint8_t sources = waitForEvents(timers.msUntilNext(millis(), kMaxSleepMs));
+  powerManager.idleEnd();
+  schedStats.wakeups++;
+
+  loopProfiler.beginIteration(micros());
+  if (sources & kWakeInput)
+  {
+    schedStats.inputWakeups++;
+    serviceInput();
+    serviceLink();
+    if (sensors.pending()) timers.start(sensorTimer, 0, millis());
+  }
+  if (sources & kWakeSocket)
+  {
+    schedStats.socketWakeups++;
+    socketWakeUs = esp_timer_get_time();
+    boostCpu(CpuGovernor::kIngress);
+    serviceMqtt();
+  }
+  timers.advance(millis());
+
+  if (loopProfiler.endIteration(micros()))
+  {
+    // The status-bar timer picks up the marker.
+    lastStallMs = millis();
+    LOGW("loop stall: %lu us, %s took %lu us",
+         (unsigned long)loopProfiler.lastOverrunUs(),
+         loopProfiler.name(loopProfiler.lastCulprit()),
+         (unsigned long)loopProfiler.lastCulpritUs());
+  }
+}
@@ -0,0 +1,255 @@
+// Host test for AudioEngine against a fake player that models one M5
+// Speaker channel (one sound playing, one queued behind it) and records
+// every buffer handed to it with the time it starts sounding. Each scenario
+// drives the engine the way the firmware does: post() from the message
+// path, service() when msUntilNext() says, on a simulated clock.
+//
+// Checks, per scenario:
+//   - every note's pitch is exact (rate is a whole multiple of the period)
+//   - the player never holds more than two buffers
+//   - notes of one event follow each other with no gap
+//   - a burst of the same event plays it once
+//   - a higher-priority event cuts in at once and the rest of the lower one
+//     never sounds; lower/equal ones wait their turn
+// then prints the recorded stream and the cost of post().
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/AudioEngine -o audio_host
+//       tools/audio_host.cpp lib/AudioEngine/AudioEngine.cpp
+//   ./audio_host
+#include "AudioEngine.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+
+const uint32_t kRate = 192000;
+
+struct Entry {
+    uint64_t startUs;
+    uint64_t endUs;
+    uint32_t hz;
+    uint32_t samples;
+    bool stop;
+    bool rest;
+};
+
+// One Speaker channel: a buffer starts when the one before it ends.
+struct FakePlayer {
+    uint64_t nowUs = 0;
+    std::vector<Entry> stream;
+    uint32_t rejected = 0;
+    uint32_t rejectNext = 0; // simulate a full channel this many times
+    uint32_t failures = 0;
+
+    uint8_t pending() const {
+        uint8_t n = 0;
+        for (const Entry &e : stream) n += e.endUs > nowUs;
+        return n;
+    }
+
+    bool play(const int8_t *cycle, size_t len, uint32_t rate, uint32_t repeat, bool stop) {
+        if (rejectNext) {
+            rejectNext--;
+            rejected++;
+            return false;
+        }
+        if (!stop && pending() >= 2) {
+            failures++;
+            printf("  FAIL: third buffer queued at %.1f ms\n", nowUs / 1000.0);
+            return false;
+        }
+        if (rate % len) {
+            failures++;
+            printf("  FAIL: rate %u not a multiple of period %u\n", (unsigned)rate, (unsigned)len);
+        }
+        if (stop) {
+            for (Entry &e : stream) {
+                if (e.startUs > nowUs) e.startUs = nowUs; // dropped unplayed
+                if (e.endUs > nowUs) e.endUs = nowUs;
+            }
+        }
+        uint64_t start = nowUs;
+        if (!stop && !stream.empty() && stream.back().endUs > start) start = stream.back().endUs;
+        bool silent = true;
+        for (size_t i = 0; i < len; i++) silent = silent && cycle[i] == 0;
+        Entry e;
+        e.startUs = start;
+        e.endUs = start + (uint64_t)repeat * len * 1000000 / rate;
+        e.hz = silent ? 0 : rate / len;
+        e.samples = repeat * len;
+        e.stop = stop;
+        e.rest = silent;
+        stream.push_back(e);
+        return true;
+    }
+};
+
+bool fakePlay(void *ctx, const int8_t *cycle, size_t len, uint32_t rate, uint32_t repeat, bool stop) {
+    return ((FakePlayer *)ctx)->play(cycle, len, rate, repeat, stop);
+}
+
+void loadTheme(AudioEngine &a) {
+    const AudioEngine::Note success[] = {{8000, 100}, {10000, 100}, {12000, 200}};
+    const AudioEngine::Note failure[] = {{8000, 400}, {6000, 600}};
+    const AudioEngine::Note notify[] = {{5000, 150}, {0, 50}, {5000, 150}};
+    const AudioEngine::Note firing[] = {{4000, 80}, {0, 40}, {4000, 80}, {0, 40}, {4000, 80}};
+    a.addEvent("success", 1, AudioEngine::kSquare, 255, success, 3);
+    a.addEvent("failure", 3, AudioEngine::kSquare, 255, failure, 2);
+    a.addEvent("notify", 1, AudioEngine::kSine, 200, notify, 3);
+    a.addEvent("firing", 3, AudioEngine::kTriangle, 255, firing, 5);
+}
+
+struct Post {
+    uint32_t atMs;
+    const char *name;
+};
+
+// Runs posts in time order, servicing the engine when it asks, until idle.
+void run(AudioEngine &a, FakePlayer &p, const Post *posts, size_t count) {
+    size_t next = 0;
+    uint64_t now = 0;
+    for (;;) {
+        uint64_t due = UINT64_MAX;
+        const uint32_t wait = a.msUntilNext(now);
+        if (wait != AudioEngine::kIdle) due = now + wait * 1000ULL;
+        if (next < count && posts[next].atMs * 1000ULL <= due) {
+            now = posts[next].atMs * 1000ULL;
+            p.nowUs = now;
+            a.post(posts[next++].name, now);
+            continue;
+        }
+        if (due == UINT64_MAX) break;
+        now = due;
+        p.nowUs = now;
+        a.service(now);
+    }
+}
+
+int check(const char *name, bool ok) {
+    printf("  %-44s %s\n", name, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+bool gapless(const FakePlayer &p) {
+    for (size_t i = 1; i < p.stream.size(); i++) {
+        const Entry &a = p.stream[i - 1], &b = p.stream[i];
+        if (!b.stop && a.endUs > a.startUs && b.startUs != a.endUs && b.startUs < a.endUs) return false;
+    }
+    return true;
+}
+
+void dump(const FakePlayer &p) {
+    for (const Entry &e : p.stream) {
+        printf("    %7.1f - %7.1f ms  %5u Hz  %6u samples%s\n", e.startUs / 1000.0, e.endUs / 1000.0, (unsigned)e.hz,
+               (unsigned)e.samples, e.stop ? "  (cut in)" : "");
+    }
+}
+
+} // namespace
+
+int main() {
+    int failures = 0;
+
+    {
+        printf("burst: 20 x success, 15 ms apart\n");
+        FakePlayer p;
+        AudioEngine a(fakePlay, &p, kRate);
+        loadTheme(a);
+        Post posts[20];
+        for (int i = 0; i < 20; i++) posts[i] = {(uint32_t)i * 15, "success"};
+        run(a, p, posts, 20);
+        dump(p);
+        failures += check("played once, 3 notes", p.stream.size() == 3);
+        failures += check("19 folded into the one playing", a.coalesced() == 19);
+        failures += check("gapless", gapless(p));
+        failures += p.failures;
+    }
+    {
+        printf("preempt: failure 150 ms into success\n");
+        FakePlayer p;
+        AudioEngine a(fakePlay, &p, kRate);
+        loadTheme(a);
+        const Post posts[] = {{0, "success"}, {150, "failure"}};
+        run(a, p, posts, 2);
+        dump(p);
+        bool cut = false;
+        for (const Entry &e : p.stream) cut = cut || (e.stop && e.startUs == 150000 && e.hz == 8000);
+        failures += check("failure starts at 150 ms, cutting in", cut);
+        bool silenced = true;
+        for (const Entry &e : p.stream) silenced = silenced && (e.hz != 12000 || e.endUs == e.startUs);
+        failures += check("success's queued 12 kHz note never sounds", silenced);
+        failures += check("one preemption", a.preempted() == 1);
+        failures += p.failures;
+    }
+    {
+        printf("queue: notify, success, notify, success, firing, notify\n");
+        FakePlayer p;
+        AudioEngine a(fakePlay, &p, kRate);
+        loadTheme(a);
+        const Post posts[] = {{0, "notify"}, {10, "success"}, {20, "notify"},
+                              {30, "success"}, {40, "firing"}, {500, "notify"}};
+        run(a, p, posts, 6);
+        dump(p);
+        size_t firingAt = 0, successAt = 0;
+        for (size_t i = 0; i < p.stream.size(); i++) {
+            if (p.stream[i].hz == 4000 && !firingAt) firingAt = i;
+            if (p.stream[i].hz == 10000 && !successAt) successAt = i;
+        }
+        failures += check("firing cuts into notify at once", p.stream[firingAt].stop);
+        failures += check("queued success plays after firing", successAt > firingAt);
+        failures += check("repeats of queued events folded", a.coalesced() == 2);
+        failures += check("gapless", gapless(p));
+        failures += p.failures;
+    }
+    {
+        printf("full channel: player refuses twice\n");
+        FakePlayer p;
+        AudioEngine a(fakePlay, &p, kRate);
+        loadTheme(a);
+        p.rejectNext = 2;
+        const Post posts[] = {{0, "success"}};
+        run(a, p, posts, 1);
+        dump(p);
+        failures += check("retried, all 3 notes played", p.stream.size() == 3 && p.rejected == 2);
+        failures += p.failures;
+    }
+    {
+        printf("theme\n");
+        FakePlayer p;
+        AudioEngine a(fakePlay, &p, kRate);
+        loadTheme(a);
+        printf("  %u events, %u of %u pool bytes\n", (unsigned)a.events(), (unsigned)a.poolUsed(),
+               (unsigned)AudioEngine::kPoolBytes);
+        const AudioEngine::Note low[] = {{100, 100}};
+        const AudioEngine::Note bad[] = {{3000, 100}, {3500, 0}};
+        const size_t used = a.poolUsed();
+        failures += check("zero-length note rejected, pool untouched",
+                          !a.addEvent("bad", 1, AudioEngine::kSine, 77, bad, 2) && a.poolUsed() == used);
+        failures += check("unknown event not posted", !a.post("nope", 0));
+        failures += check("low note clamps its period, pitch exact", a.addEvent("low", 1, AudioEngine::kSine, 255, low, 1));
+        const Post posts[] = {{0, "low"}};
+        run(a, p, posts, 1);
+        failures += check("100 Hz played", p.stream.size() == 1 && p.stream[0].hz == 100);
+        failures += p.failures;
+    }
+    {
+        FakePlayer p;
+        AudioEngine a(fakePlay, &p, kRate);
+        loadTheme(a);
+        const int kPosts = 200000;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < kPosts; i++) {
+            p.nowUs = i;
+            a.post(i % 7 ? "success" : "notify", i);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        printf("post(): %.0f ns each during a burst\n",
+               std::chrono::duration<double, std::nano>(t1 - t0).count() / kPosts);
+    }
+
+    printf(failures ? "FAILED (%d)\n" : "all ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+// Runs the FSBench suite against a host directory standing in for LittleFS.
+// Capacity and used space are modelled on the partition: each file takes
+// whole blocks of --block bytes, out of --capacity. Output is the same JSON
+// lines the device prints for "fsbench", so runs can be diffed or loaded
+// side by side, e.g. device runs under different LittleFS block/cache sizes
+// against a host baseline.
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/FSBench -Ilib/StageProfiler -o fsbench_host
+//       tools/fsbench_host.cpp lib/FSBench/FSBench.cpp
+//       lib/StageProfiler/StageProfiler.cpp
+//   ./fsbench_host [--dir D] [--label L] [--capacity BYTES] [--block BYTES]
+//                  [--file-bytes BYTES] [--ops N] > host.jsonl
+#include "FSBench.h"
+
+#include <chrono>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char *gDir = nullptr;
+uint64_t gCapacity = 0x160000; // default 4 MB partition table's LittleFS
+uint64_t gBlock = 4096;
+
+void emitLine(const char *line) { puts(line); }
+
+uint64_t nowUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool usage(uint64_t &used, uint64_t &total) {
+    DIR *dir = opendir(gDir);
+    if (!dir) return false;
+    used = 2 * gBlock; // superblock pair
+    char full[512];
+    struct dirent *e;
+    while ((e = readdir(dir)) != nullptr) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(full, sizeof(full), "%s/%s", gDir, e->d_name);
+        struct stat st;
+        if (stat(full, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        uint64_t blocks = (st.st_size + gBlock - 1) / gBlock;
+        used += (blocks ? blocks : 1) * gBlock;
+    }
+    closedir(dir);
+    total = gCapacity;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *label = "host";
+    size_t fileBytes = 64 * 1024;
+    unsigned ops = 100;
+    char tmpl[] = "/tmp/fsbench.XXXXXX";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--dir") == 0) gDir = argv[i + 1];
+        else if (strcmp(argv[i], "--label") == 0) label = argv[i + 1];
+        else if (strcmp(argv[i], "--capacity") == 0) gCapacity = strtoull(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "--block") == 0) gBlock = strtoull(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "--file-bytes") == 0) fileBytes = strtoul(argv[i + 1], nullptr, 0);
+        else if (strcmp(argv[i], "--ops") == 0) ops = strtoul(argv[i + 1], nullptr, 0);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    bool ownDir = gDir == nullptr;
+    if (ownDir && (gDir = mkdtemp(tmpl)) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    FSBench bench(gDir, label, emitLine, nowUs, usage);
+    bench.setFileBytes(fileBytes);
+    bench.setOps(ops);
+    bool ok = bench.run();
+    if (ownDir) rmdir(gDir);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// Host benchmark for the SPIFFSManager read paths: allocation count, peak
+// heap and read time for a config file (/topics.json), the settings log
+// (/kv.log) and a scrollback-sized history file, read
+//   chunked  - the old readFile: 128-byte chunks appended to a String that
+//              grows to the exact new length on every append
+//   reserved - readFile now: one buffer sized from stat(), chunks appended
+//   span     - readInto: straight into a caller-supplied buffer
+//   stream   - FileJsonReader: 64-byte refills, the parser consumes bytes
+// The String here reallocates the way Arduino's WString does (reserve() to
+// the exact length, no geometric growth). Host stdio stands in for the VFS,
+// so times are only comparable with each other, not with flash.
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -o fsread_bench tools/fsread_bench.cpp
+//   ./fsread_bench
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace {
+
+uint32_t allocs = 0;
+size_t liveBytes = 0, peakBytes = 0;
+
+// Counting realloc with a size header, so frees can be accounted. The peak
+// assumes a realloc moves the block (old and new live at once), as it
+// usually must on a fragmented device heap.
+void *countedRealloc(void *p, size_t n) {
+    size_t old = 0;
+    if (p) {
+        p = (size_t *)p - 1;
+        old = *(size_t *)p;
+    }
+    size_t *q = (size_t *)realloc(p, n + sizeof(size_t));
+    *q = n;
+    allocs++;
+    if (liveBytes + n > peakBytes) peakBytes = liveBytes + n;
+    liveBytes += n - old;
+    return q + 1;
+}
+
+void countedFree(void *p) {
+    if (!p) return;
+    size_t *q = (size_t *)p - 1;
+    liveBytes -= *q;
+    free(q);
+}
+
+// Arduino String's growth policy, reduced to what readFile touches.
+class WString {
+public:
+    ~WString() { countedFree(buf_); }
+    bool reserve(size_t n) {
+        if (buf_ && cap_ >= n) return true;
+        buf_ = (char *)countedRealloc(buf_, n + 1);
+        cap_ = n;
+        return true;
+    }
+    void concat(const char *s, size_t n) {
+        reserve(len_ + n);
+        memcpy(buf_ + len_, s, n);
+        len_ += n;
+        buf_[len_] = '\0';
+    }
+    size_t length() const { return len_; }
+
+private:
+    char *buf_ = nullptr;
+    size_t cap_ = 0;
+    size_t len_ = 0;
+};
+
+size_t readChunked(const char *path) {
+    WString s;
+    FILE *f = fopen(path, "rb");
+    char buf[128];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.concat(buf, n);
+    fclose(f);
+    return s.length();
+}
+
+size_t readReserved(const char *path) {
+    struct stat st;
+    stat(path, &st);
+    WString s;
+    s.reserve(st.st_size);
+    FILE *f = fopen(path, "rb");
+    char buf[128];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.concat(buf, n);
+    fclose(f);
+    return s.length();
+}
+
+size_t readSpan(const char *path) {
+    static uint8_t span[8192];
+    struct stat st;
+    if (stat(path, &st) != 0 || (size_t)st.st_size > sizeof(span)) return 0;
+    FILE *f = fopen(path, "rb");
+    size_t n = fread(span, 1, st.st_size, f);
+    fclose(f);
+    return n;
+}
+
+// Byte-at-a-time consumer, as deserializeJson() drives the reader.
+size_t readStream(const char *path) {
+    FILE *f = fopen(path, "rb");
+    uint8_t buf[64];
+    size_t pos = 0, len = 0, total = 0;
+    for (;;) {
+        if (pos == len) {
+            len = fread(buf, 1, sizeof(buf), f);
+            pos = 0;
+            if (!len) break;
+        }
+        total += buf[pos++] != 0;
+    }
+    fclose(f);
+    return total;
+}
+
+void makeFile(const char *path, size_t bytes, const char *unit) {
+    FILE *f = fopen(path, "wb");
+    size_t unitLen = strlen(unit);
+    for (size_t i = 0; i < bytes; i += unitLen) fwrite(unit, 1, bytes - i < unitLen ? bytes - i : unitLen, f);
+    fclose(f);
+}
+
+typedef size_t (*Reader)(const char *path);
+
+void bench(const char *label, const char *path, Reader read) {
+    const int kRuns = 2000;
+    allocs = 0;
+    peakBytes = liveBytes = 0;
+    read(path);
+    uint32_t perRead = allocs;
+    size_t peak = peakBytes;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (int i = 0; i < kRuns; i++) bytes += read(path);
+    auto t1 = std::chrono::steady_clock::now();
+    double us = std::chrono::duration<double, std::micro>(t1 - t0).count() / kRuns;
+    printf("  %-9s %6lu B  %4u allocs  peak %5lu B  %7.2f us\n", label, (unsigned long)(bytes / kRuns),
+           perRead, (unsigned long)peak, us);
+}
+
+} // namespace
+
+int main() {
+    struct Case {
+        const char *name;
+        const char *path;
+        size_t bytes;
+        const char *unit;
+    } cases[] = {
+        {"config (/topics.json)", "/tmp/fsread_topics.json", 420,
+         "{\"filter\":\"notify/github/#\",\"handler\":\"github\",\"qos\":1},"},
+        {"settings (/kv.log)", "/tmp/fsread_kv.log", 1536, "\xA5" "crc!" "\x01\x0e\x0e" "wifi/homenet01" "secretpassword01"},
+        {"history (64 x 63)", "/tmp/fsread_history.txt", 64 * 64,
+         "[build] main #1234 passed in 3m12s on runner-7 for KhalilAwada/x\n"},
+    };
+    for (const Case &c : cases) {
+        makeFile(c.path, c.bytes, c.unit);
+        printf("%s\n", c.name);
+        bench("chunked", c.path, readChunked);
+        bench("reserved", c.path, readReserved);
+        bench("span", c.path, readSpan);
+        bench("stream", c.path, readStream);
+        remove(c.path);
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+// Host benchmark for image messages (lib/IconImage): payload size against
+// the raw RGB332 icon, row-by-row decode time and throughput, the content
+// hash, and a cache hit (one copy of the cached pixels) for
+//   identicon - 32x32, 5x5 blocks of 2 colours (repo avatar)
+//   avatar    - 32x32, 64 colours, noisy (photo avatar, close to worst case)
+//   sparkline - 120x24, 3 colours (Grafana panel)
+// Every decode is checked against the source pixels.
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/IconImage -Ilib/FrameSnapshot -o icon_bench
+//       tools/icon_bench.cpp lib/IconImage/IconImage.cpp lib/FrameSnapshot/FrameSnapshot.cpp
+//   ./icon_bench
+#include "IconImage.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+bool append(void *ctx, const uint8_t *data, size_t len) {
+    std::vector<uint8_t> *out = (std::vector<uint8_t> *)ctx;
+    out->insert(out->end(), data, data + len);
+    return true;
+}
+
+void put16(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back(v >> 8);
+}
+
+// What a producer sends: header, palette, coded indices, caption.
+std::vector<uint8_t> makePayload(uint16_t w, uint16_t h, const std::vector<uint8_t> &palette,
+                                 const std::vector<uint8_t> &indices, const char *caption) {
+    std::vector<uint8_t> data;
+    FrameSnapshot::encode(indices.data(), indices.size(), append, &data);
+    std::vector<uint8_t> out = {'M', '5', 'I', 'C'};
+    put16(out, w);
+    put16(out, h);
+    out.push_back((uint8_t)(palette.size() / 3 - 1));
+    out.push_back(0);
+    put16(out, (uint16_t)data.size());
+    out.insert(out.end(), palette.begin(), palette.end());
+    out.insert(out.end(), data.begin(), data.end());
+    out.insert(out.end(), caption, caption + strlen(caption));
+    return out;
+}
+
+struct Case {
+    const char *name;
+    uint16_t w, h;
+    std::vector<uint8_t> palette;
+    std::vector<uint8_t> indices;
+};
+
+Case identicon() {
+    Case c = {"identicon", 32, 32, {240, 240, 240, 40, 120, 200}, {}};
+    uint32_t bits = 0x1B5A3C7u;
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 32; x++) {
+            const int bx = x * 5 / 32, by = y * 5 / 32;
+            const int mx = bx < 3 ? bx : 4 - bx; // mirrored
+            c.indices.push_back((bits >> (by * 3 + mx)) & 1);
+        }
+    }
+    return c;
+}
+
+Case avatar() {
+    Case c = {"avatar", 32, 32, {}, {}};
+    for (int i = 0; i < 64; i++) {
+        c.palette.push_back((uint8_t)(i * 4));
+        c.palette.push_back((uint8_t)(255 - i * 3));
+        c.palette.push_back((uint8_t)(i * 37));
+    }
+    srand(7);
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 32; x++) {
+            const int base = ((x - 16) * (x - 16) + (y - 12) * (y - 12)) / 8;
+            c.indices.push_back((uint8_t)((base + rand() % 4) % 64));
+        }
+    }
+    return c;
+}
+
+Case sparkline() {
+    Case c = {"sparkline", 120, 24, {0, 0, 0, 0, 200, 80, 60, 60, 60}, {}};
+    c.indices.assign(120 * 24, 0);
+    for (int x = 0; x < 120; x++) {
+        c.indices[12 * 120 + x] = 2; // threshold line
+        const int v = 12 + (int)(9 * ((x * 7919 % 97) / 97.0 - 0.5) * (x % 20 < 10 ? 1 : 2) / 2);
+        c.indices[v * 120 + x] = 1;
+    }
+    return c;
+}
+
+double nowUs() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+int main() {
+    const int kRuns = 20000;
+    int failures = 0;
+    printf("%-10s %7s %7s %8s %9s %8s %8s\n", "icon", "raw B", "msg B", "dec us", "Mpix/s", "hash us", "hit us");
+    const Case cases[] = {identicon(), avatar(), sparkline()};
+    for (const Case &c : cases) {
+        const std::vector<uint8_t> msg = makePayload(c.w, c.h, c.palette, c.indices, "octocat pushed to main");
+        std::vector<uint8_t> canvas((size_t)c.w * c.h);
+        uint8_t row[IconImage::kMaxWidth];
+
+        // Correctness: every row matches the palette-mapped source.
+        IconImage img;
+        bool ok = img.begin(msg.data(), msg.size());
+        for (uint16_t y = 0; ok && y < c.h; y++) {
+            ok = img.nextRow(row);
+            for (uint16_t x = 0; ok && x < c.w; x++) {
+                const uint8_t *p = &c.palette[3 * c.indices[y * c.w + x]];
+                ok = row[x] == IconImage::rgb332(p[0], p[1], p[2]);
+            }
+        }
+        ok = ok && img.complete() && img.captionLen() == strlen("octocat pushed to main");
+        if (!ok) {
+            printf("%-10s decode mismatch\n", c.name);
+            failures++;
+            continue;
+        }
+
+        double t0 = nowUs();
+        for (int r = 0; r < kRuns; r++) {
+            IconImage d;
+            d.begin(msg.data(), msg.size());
+            for (uint16_t y = 0; y < c.h; y++) {
+                d.nextRow(row);
+                memcpy(&canvas[(size_t)y * c.w], row, c.w); // stands in for pushImage()
+            }
+        }
+        const double decodeUs = (nowUs() - t0) / kRuns;
+
+        t0 = nowUs();
+        volatile uint32_t sink = 0;
+        for (int r = 0; r < kRuns; r++) sink = sink + IconImage::fnv1a(msg.data() + 4, msg.size() - 4);
+        const double hashUs = (nowUs() - t0) / kRuns;
+
+        IconCache cache(16 * 1024);
+        uint8_t *slot = cache.insert(img.hash(), c.w, c.h);
+        memcpy(slot, canvas.data(), canvas.size());
+        t0 = nowUs();
+        for (int r = 0; r < kRuns; r++) {
+            uint16_t w, h;
+            const uint8_t *px = cache.find(img.hash(), w, h);
+            memcpy(canvas.data(), px, (size_t)w * h);
+        }
+        const double hitUs = (nowUs() - t0) / kRuns;
+
+        printf("%-10s %7u %7u %8.2f %9.1f %8.2f %8.2f\n", c.name, (unsigned)(c.w * c.h), (unsigned)msg.size(),
+               decodeUs, c.w * c.h / decodeUs, hashUs, hitUs);
+    }
+
+    // LRU: eight 1 KB icons in a 6 KB budget; the most recently used survive.
+    IconCache cache(6 * 1024);
+    for (uint32_t h = 1; h <= 8; h++) {
+        uint16_t w, hh;
+        cache.insert(h, 32, 32);
+        if (h == 6) cache.find(2, w, hh); // 2 was used again, 1 and 3 were not
+    }
+    uint16_t w, h;
+    const bool lru = cache.size() == 6 && cache.find(2, w, h) && !cache.find(1, w, h) && !cache.find(3, w, h) &&
+                     cache.find(8, w, h);
+    printf("LRU eviction %s (%u evictions)\n", lru ? "ok" : "FAIL", (unsigned)cache.evictions());
+    failures += !lru;
+    return failures ? 1 : 0;
+}
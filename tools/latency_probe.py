@@ -0,0 +1,100 @@
+"""
+End-to-end latency probe for the notification device.
+
+Runs against a (local) broker the device is connected to:
+  * answers the device's clock pings on <base>/ping with pongs on <base>/pong
+    so it can map its millis() onto our wall clock,
+  * publishes timestamped probe notifications ("ts" = epoch ms) to a topic
+    the device displays,
+  * prints the producer -> pixels percentiles the device reports on
+    <base>/stats.
+
+Usage:
+  pip install paho-mqtt
+  python tools/latency_probe.py --host 192.168.1.10 --base m5notify/m5stack-stickc \
+      --topic m5stack/stickcp2 --count 50 --interval 2
+
+The stats window is 60 s, so let it run for at least a minute after the
+last probe to see the final report.
+"""
+import argparse
+import json
+import sys
+import time
+
+try:
+    import paho.mqtt.client as mqtt
+except ImportError:
+    print("latency_probe: pip install paho-mqtt", file=sys.stderr)
+    sys.exit(1)
+
+
+def now_ms():
+    return int(time.time() * 1000)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--host", default="localhost")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--username")
+    ap.add_argument("--password")
+    ap.add_argument("--base", required=True, help="device MQTT_PUB_TOPIC, with {client} expanded")
+    ap.add_argument("--topic", required=True, help="topic the device displays notifications from")
+    ap.add_argument("--count", type=int, default=30)
+    ap.add_argument("--interval", type=float, default=2.0)
+    ap.add_argument("--linger", type=float, default=70.0, help="seconds to wait for stats after the last probe")
+    args = ap.parse_args()
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+
+    def on_connect(c, userdata, flags, reason, props):
+        c.subscribe(args.base + "/ping", qos=0)
+        c.subscribe(args.base + "/stats", qos=0)
+
+    def on_message(c, userdata, msg):
+        t1 = now_ms()
+        if msg.topic.endswith("/ping"):
+            ping = json.loads(msg.payload)
+            pong = {"seq": ping["seq"], "t0": ping["t0"], "t1": t1, "t2": now_ms()}
+            c.publish(args.base + "/pong", json.dumps(pong), qos=0)
+        elif msg.topic.endswith("/stats"):
+            stats = json.loads(msg.payload)
+            clock = stats.get("clock", {})
+            e2e = stats.get("e2e")
+            if e2e:
+                n, p50, p90, p99, mx = e2e
+                print(f"device: n={n} p50={p50} p90={p90} p99={p99} max={mx} ms "
+                      f"(offset {clock.get('offset')} ms, rtt {clock.get('rtt')} ms)")
+            else:
+                print("device: no stamped notifications in window yet "
+                      f"(clock {'synced' if clock else 'not synced'})")
+
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.host, args.port, keepalive=30)
+    client.loop_start()
+
+    # Give the device a couple of ping intervals to sync before probing.
+    print("waiting 35 s for clock sync...")
+    time.sleep(35)
+    for i in range(args.count):
+        probe = {
+            "messageType": "event",
+            "messageGroup": "grafana",
+            "id": f"probe-{i}",
+            "ts": now_ms(),
+            "lines": [f"latency probe {i + 1}/{args.count}"],
+        }
+        client.publish(args.topic, json.dumps(probe), qos=1)
+        time.sleep(args.interval)
+
+    time.sleep(args.linger)
+    client.loop_stop()
+    client.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+// Callback cost of logging, before and after AsyncLog.
+//
+//   before - the old callback echoed every payload with Serial.println()
+//            plus a "message supported" line. HardwareSerial has no TX
+//            buffer by default, so the call returns once all but the last
+//            128 bytes (the UART FIFO) are on the wire at 115200 baud.
+//            That wait is modelled here, since there is no UART on the host.
+//   info   - now, at the default ASYNC_LOG_LEVEL: the payload echo is LOGD
+//            and compiles away; nothing is logged per message.
+//   debug  - now, built with ASYNC_LOG_LEVEL=4: the echo is queued with
+//            LOGD (copied up to 96 bytes and redacted). Measured here.
+//   drain  - what the log task later spends formatting that record, off the
+//            loop. Measured here.
+// Host times are only a lower bound for the ESP32; the 'total' stage in
+// <base>/stats gives the device figure.
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/AsyncLog -o log_bench tools/log_bench.cpp lib/AsyncLog/AsyncLog.cpp
+//   ./log_bench
+#undef ASYNC_LOG_LEVEL
+#define ASYNC_LOG_LEVEL ASYNC_LOG_DEBUG
+#include "AsyncLog.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+
+namespace {
+
+const double kBaud = 115200.0;
+const size_t kUartFifo = 128;
+
+size_t sunk = 0;
+void countSink(const char *, size_t len) { sunk += len; }
+uint32_t zeroClock() { return 0; }
+
+// Time the old println() spent blocked: 10 bits per byte for everything
+// that doesn't fit the FIFO.
+double uartBlockUs(size_t bytes) {
+    return bytes > kUartFifo ? (bytes - kUartFifo) * 10.0 * 1e6 / kBaud : 0.0;
+}
+
+std::string payload(size_t n) {
+    static const char kUnit[] = "{\"repo\":\"KhalilAwada/x\",\"event\":\"push\",\"status\":\"passed\"},";
+    std::string s;
+    while (s.size() < n) s += kUnit;
+    s.resize(n);
+    return s;
+}
+
+} // namespace
+
+int main() {
+    AsyncLog &log = AsyncLog::instance();
+    log.begin(countSink, zeroClock);
+    const char *topic = "notify/github/push";
+    const int kRuns = 20000;
+
+    printf("payload   before us   info us   debug us   drain us\n");
+    for (size_t n : {200, 1000, 4000}) {
+        const std::string p = payload(n);
+        // println(message) + "\r\n", then println("message supported").
+        const double before = uartBlockUs(n + 2 + 19);
+
+        // Queue 16 at a time (well inside the ring), drain untimed between.
+        double debugUs = 0;
+        for (int i = 0; i < kRuns / 16; i++) {
+            auto t0 = std::chrono::steady_clock::now();
+            for (int k = 0; k < 16; k++) LOGD("MQTT %s: %s", topic, p.c_str());
+            debugUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+            log.drain();
+        }
+        // Drain alone, with the records queued in advance.
+        double drainUs = 0;
+        for (int i = 0; i < kRuns / 16; i++) {
+            for (int k = 0; k < 16; k++) LOGD("MQTT %s: %s", topic, p.c_str());
+            auto t0 = std::chrono::steady_clock::now();
+            log.drain();
+            drainUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        }
+        const int records = kRuns / 16 * 16;
+        printf("%7u %11.1f %9.1f %10.2f %10.2f\n", (unsigned)n, before, 0.0, debugUs / records, drainUs / records);
+    }
+    printf("dropped %u, %u bytes formatted\n", (unsigned)log.dropped(), (unsigned)sunk);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Wakeups and input-to-response delay of the main loop, old versus new,
+// over a simulated hour with a button press about once a minute and a
+// message about every two minutes (both Poisson).
+//
+//   polled - the old loop: every pass ran everything, then delay(50). It woke
+//            20 times a second, and a press or a packet waited for the next
+//            pass.
+//   wheel  - the loop now: the real TimerWheel with the timers
+//            startScheduler() registers, at their periods. loop() sleeps
+//            until the earliest deadline (at most kMaxSleepMs), or until the
+//            button interrupt or the socket wakes it.
+// The delay is scheduling only: from the event to the pass that handles it.
+// The interrupt/select wake path itself is on top and is measured on the
+// device (power.wake in telemetry).
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/TimerWheel -o loop_sim tools/loop_sim.cpp lib/TimerWheel/TimerWheel.cpp
+//   ./loop_sim
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace {
+
+const uint32_t kHourMs = 3600 * 1000;
+const uint32_t kOldPassMs = 50;
+const uint32_t kMaxSleepMs = 1000;
+
+// Periods from main.cpp. The sensor timer is one-shot, re-armed for the
+// next due channel; its shortest channel (charger, 4 s) sets the pace.
+struct Periodic {
+    const char *name;
+    uint32_t periodMs;
+};
+const Periodic kTimers[] = {
+    {"status", 2000}, {"wifi", 500}, {"link", 1000}, {"heap", 60000}, {"energy", 60000}, {"sensor", 4000},
+};
+
+void noop(void *) {}
+
+std::vector<uint32_t> poissonEvents(double meanMs, unsigned seed) {
+    srand(seed);
+    std::vector<uint32_t> at;
+    double t = 0;
+    for (;;) {
+        t += -meanMs * log(1.0 - (rand() + 0.5) / (RAND_MAX + 1.0));
+        if (t >= kHourMs) break;
+        at.push_back((uint32_t)t);
+    }
+    return at;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p / 100.0 * v.size()))];
+}
+
+void report(const char *name, uint32_t wakeups, const std::vector<double> &delays) {
+    double sum = 0;
+    for (double d : delays) sum += d;
+    printf("%-7s %8.2f %10.1f %9.1f %9.1f\n", name, wakeups * 1000.0 / kHourMs,
+           delays.empty() ? 0 : sum / delays.size(), percentile(delays, 50), percentile(delays, 99));
+}
+
+} // namespace
+
+int main() {
+    std::vector<uint32_t> events = poissonEvents(60000, 1);
+    std::vector<uint32_t> messages = poissonEvents(120000, 2);
+    events.insert(events.end(), messages.begin(), messages.end());
+    std::sort(events.begin(), events.end());
+    printf("%u events in an hour\n\n", (unsigned)events.size());
+    printf("loop    wakeups/s   mean ms    p50 ms    p99 ms\n");
+
+    // Old: a pass every 50 ms; an event waits for the next one.
+    std::vector<double> delays;
+    for (uint32_t t : events) delays.push_back((double)((kOldPassMs - t % kOldPassMs) % kOldPassMs));
+    report("polled", kHourMs / kOldPassMs, delays);
+
+    // New: sleep until the next deadline or event, whichever comes first.
+    TimerWheel wheel;
+    for (const Periodic &p : kTimers) wheel.start(wheel.add(noop, nullptr, p.periodMs), p.periodMs, 0);
+    uint32_t now = 0, wakeups = 0;
+    size_t next = 0;
+    delays.clear();
+    while (now < kHourMs) {
+        const uint32_t deadline = now + wheel.msUntilNext(now, kMaxSleepMs);
+        if (next < events.size() && events[next] < deadline) {
+            now = events[next++]; // the interrupt or the socket ends the sleep
+            delays.push_back(0);
+        } else {
+            now = deadline;
+        }
+        wakeups++;
+        wheel.advance(now);
+    }
+    report("wheel", wakeups, delays);
+    return 0;
+}
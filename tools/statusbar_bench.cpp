@@ -0,0 +1,88 @@
+// Host benchmark for the status-bar cell cache: replays a day of typical
+// status changes and reports the bytes sent to the panel per change, for
+// whole-bar pushes versus pushing only the cells that changed.
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/StatusCells -o statusbar_bench
+//       tools/statusbar_bench.cpp lib/StatusCells/StatusCells.cpp
+//   ./statusbar_bench
+#include "StatusCells.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+struct State {
+    bool wifi;
+    int bars;
+    bool mqtt;
+    int battery;
+    bool charging;
+    bool stall;
+};
+
+void keysFor(const State &s, uint32_t keys[StatusCells::kCount]) {
+    keys[StatusCells::kLabel] = StatusCells::labelKey(s.wifi ? "homenet" : "offline", s.wifi);
+    keys[StatusCells::kStall] = s.stall;
+    keys[StatusCells::kMqtt] = s.mqtt;
+    keys[StatusCells::kWifi] = StatusCells::wifiState(s.wifi, s.bars);
+    keys[StatusCells::kBattery] = StatusCells::batteryBucket(s.battery) * 2 + s.charging;
+}
+
+} // namespace
+
+int main() {
+    const int16_t kWidth = 240, kHeight = 24; // StickC Plus2, rotation 3
+    StatusCells cells;
+    cells.layout(kWidth, kHeight);
+    const char *names[StatusCells::kCount] = {"label", "stall", "mqtt", "wifi", "battery"};
+
+    printf("cell     x    y   w   h  bytes\n");
+    for (uint8_t i = 0; i < StatusCells::kCount; i++) {
+        const StatusCells::Rect &r = cells.rect(i);
+        printf("%-7s %3d  %3d %3d %3d  %5lu\n", names[i], r.x, r.y, r.w, r.h,
+               (unsigned long)cells.bytes(1 << i));
+    }
+    printf("full bar                 %5lu\n\n", (unsigned long)cells.fullBytes());
+
+    // One status-bar refresh every 2 s for 24 h. RSSI wobbles across a bar
+    // boundary, the battery drains 1 % every ~10 min until the charger goes
+    // on, MQTT drops now and then, a loop stall shows up occasionally.
+    srand(1);
+    State s = {true, 3, true, 100, false, false};
+    uint32_t keys[StatusCells::kCount];
+    uint32_t changes = 0, fullBytes = 0, cellBytes = 0, perCell[StatusCells::kCount] = {};
+    const uint32_t ticks = 24 * 3600 / 2;
+    for (uint32_t t = 0; t < ticks; t++) {
+        if (rand() % 60 == 0) s.bars = s.bars == 3 ? 4 : 3;
+        if (t % 300 == 0 && !s.charging) s.battery--;
+        if (s.battery <= 20) s.charging = true;
+        if (s.charging && t % 30 == 0 && s.battery < 100) s.battery++;
+        if (rand() % 7200 == 0) s.mqtt = false;
+        else if (!s.mqtt && rand() % 8 == 0) s.mqtt = true;
+        if (rand() % 10800 == 0) s.stall = true;
+        else if (s.stall && rand() % 15 == 0) s.stall = false;
+        if (rand() % 43200 == 0) s.wifi = false;
+        else if (!s.wifi && rand() % 10 == 0) s.wifi = true;
+
+        keysFor(s, keys);
+        uint8_t mask = cells.update(keys);
+        if (!mask || t == 0) continue; // t == 0 is the initial paint
+        changes++;
+        fullBytes += cells.fullBytes();
+        cellBytes += cells.bytes(mask);
+        for (uint8_t i = 0; i < StatusCells::kCount; i++) {
+            if (mask & (1 << i)) perCell[i]++;
+        }
+    }
+
+    printf("changes %lu over 24 h\n", (unsigned long)changes);
+    for (uint8_t i = 0; i < StatusCells::kCount; i++) {
+        printf("  %-7s %lu\n", names[i], (unsigned long)perCell[i]);
+    }
+    printf("bytes/change: full %lu, cells %lu (%.1f%%)\n", (unsigned long)(changes ? fullBytes / changes : 0),
+           (unsigned long)(changes ? cellBytes / changes : 0), fullBytes ? cellBytes * 100.0 / fullBytes : 0.0);
+    printf("bytes/day:    full %lu, cells %lu\n", (unsigned long)fullBytes, (unsigned long)cellBytes);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Pixels sent to the built-in panel and the Unit LCD mirror by
+// TilePresenter, against pushing the whole canvas on every present.
+//
+// Simulates an hour of scrolling text on the 240 x 110 message canvas
+// (Font0, 6 x 8): a message about every 20 s, a third of them as a burst of
+// five 100 ms apart, and the screen cleared (an acknowledge-and-clear) about
+// every five minutes. Each message is presented once, as mqttCallback()
+// does. Targets are set up as in setup(): the panel unlimited, the mirror
+// at most every 250 ms and 240 x 16 pixels per push. A mirror push holds
+// the loop for its I2C time (~90 ms per 240 x 16 strip), which advances the
+// clock. Each target copies what it is sent into its own buffer, and both
+// must end up equal to the canvas.
+//
+// Build and run from the repo root:
+//   g++ -std=c++11 -O2 -Ilib/TilePresenter -o tile_sim tools/tile_sim.cpp lib/TilePresenter/TilePresenter.cpp
+//   ./tile_sim
+#include "TilePresenter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const uint16_t kWidth = 240;
+const uint16_t kHeight = 110;
+const uint8_t kGlyphW = 6;
+const uint8_t kGlyphH = 8;
+const uint32_t kHourMs = 3600 * 1000;
+const uint32_t kMirrorIntervalMs = 250;
+const uint32_t kMirrorSlicePixels = 240 * TilePresenter::kTile;
+const double kI2cMsPerPixel = 90.0 / kMirrorSlicePixels;
+
+uint8_t frame[kWidth * kHeight];
+uint16_t cursorX = 0;
+uint16_t cursorY = 0;
+uint32_t now = 0;
+
+struct Display {
+    uint8_t shown[kWidth * kHeight];
+    bool slow; // I2C: pushes take time
+};
+Display panel = {{}, false};
+Display mirror = {{}, true};
+
+void push(void *ctx, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    Display *d = (Display *)ctx;
+    for (uint16_t row = y; row < y + h; row++) memcpy(d->shown + row * kWidth + x, frame + row * kWidth + x, w);
+    if (d->slow) now += (uint32_t)(w * h * kI2cMsPerPixel);
+}
+
+void newline() {
+    cursorX = 0;
+    cursorY += kGlyphH;
+    if (cursorY + kGlyphH <= kHeight) return;
+    // Scroll up one text row, as the canvas does.
+    memmove(frame, frame + kGlyphH * kWidth, (kHeight - kGlyphH) * kWidth);
+    memset(frame + (kHeight - kGlyphH) * kWidth, 0, kGlyphH * kWidth);
+    cursorY -= kGlyphH;
+}
+
+// A stand-in glyph: a few pixels in the text colour, different per char.
+void putChar(char c, uint8_t color) {
+    if (cursorX + kGlyphW > kWidth) newline();
+    for (uint8_t y = 0; y < kGlyphH - 1; y++) {
+        for (uint8_t x = 0; x < kGlyphW - 1; x++) {
+            if ((c * 31 + y * 7 + x * 13) % 5 < 2) frame[(cursorY + y) * kWidth + cursorX + x] = color;
+        }
+    }
+    cursorX += kGlyphW;
+}
+
+void printMessage() {
+    static const uint8_t kColors[] = {0xFF, 0x1C, 0xE0, 0x1F}; // white, green, red, cyan
+    const uint8_t color = kColors[rand() % 4];
+    const int len = 20 + rand() % 60;
+    for (int i = 0; i < len; i++) putChar((char)('!' + rand() % 90), color);
+    newline();
+}
+
+void clearScreen() {
+    memset(frame, 0, sizeof(frame));
+    cursorX = cursorY = 0;
+}
+
+double expMs(double meanMs) { return -meanMs * log(1.0 - (rand() + 0.5) / (RAND_MAX + 1.0)); }
+
+// Let the presenter catch up on rate-limited targets until 'until'.
+void serviceUntil(TilePresenter &p, uint32_t until) {
+    for (;;) {
+        const uint32_t wait = p.msUntilNext(now);
+        if (wait == TilePresenter::kIdle || now + wait > until) break;
+        now += wait;
+        p.service(now);
+    }
+    if (now < until) now = until;
+}
+
+void report(const char *name, const TilePresenter::Stats &s, uint32_t presents, const Display &d) {
+    const double whole = (double)presents * kWidth * kHeight;
+    printf("%-7s %7u %8u %7u %8.1f %9u  %s\n", name, (unsigned)s.frames, (unsigned)s.skipped, (unsigned)s.slices,
+           100.0 * s.pixels / whole, (unsigned)s.maxLagMs,
+           memcmp(d.shown, frame, sizeof(frame)) == 0 ? "in sync" : "OUT OF SYNC");
+}
+
+} // namespace
+
+int main() {
+    srand(1);
+    TilePresenter presenter;
+    presenter.begin(kWidth, kHeight);
+    presenter.addTarget(push, &panel, 0);
+    presenter.addTarget(push, &mirror, kMirrorIntervalMs, kMirrorSlicePixels);
+
+    uint32_t presents = 0;
+    double nextMessage = expMs(20000);
+    double nextClear = expMs(300000);
+    while (nextMessage < kHourMs) {
+        if (nextClear < nextMessage) {
+            serviceUntil(presenter, (uint32_t)nextClear);
+            clearScreen();
+            presenter.present(frame, now);
+            presents++;
+            nextClear += expMs(300000);
+            continue;
+        }
+        serviceUntil(presenter, (uint32_t)nextMessage);
+        const int burst = rand() % 3 == 0 ? 5 : 1;
+        for (int i = 0; i < burst; i++) {
+            if (i) serviceUntil(presenter, now + 100);
+            printMessage();
+            presenter.present(frame, now);
+            presents++;
+        }
+        nextMessage += expMs(20000);
+    }
+    serviceUntil(presenter, now + 10000);
+
+    printf("%u presents in an hour\n\n", (unsigned)presents);
+    printf("display  frames  skipped  slices  pixels %%  max lag ms\n");
+    report("panel", presenter.stats(0), presents, panel);
+    report("mirror", presenter.stats(1), presents, mirror);
+    return 0;
+}